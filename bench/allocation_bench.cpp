@@ -0,0 +1,110 @@
+/*
+* Filenme: allocation_bench.cpp
+* Purpose: Counts the heap allocations made for a ts3.messaging.send_private
+*          command on the interface thread, and for posting and reporting
+*          its request result
+*/
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "bench_support.h"
+#include "stub_functions.h"
+#include "telnet_if.h"
+
+/// Commands sent before counting, so buffers and pools have grown
+const size_t ALLOCATION_WARMUP = 200;
+
+/// Commands counted
+const size_t ALLOCATION_COMMANDS = 1000;
+
+/// Allocations made outside the ignored thread
+static std::atomic<unsigned long> allocation_count(0);
+
+/// Set on the thread driving the benchmark, whose allocations don't count
+static thread_local bool allocation_ignored = false;
+
+//-----------------------------------------------------------------------------
+/// Counts every allocation of the other threads: the interface thread and
+/// the stub functions it calls
+void* operator new(size_t size) {
+    if (!allocation_ignored) {
+        allocation_count++;
+    }
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+//-----------------------------------------------------------------------------
+/// Sends commands one after the other, optionally reporting the result of
+/// each request once its reply arrived, and returns the allocations per
+/// command
+static double count_allocations(SOCKET session, size_t count, bool with_results, bool count_results) {
+    const std::string command = "ts3.messaging.send_private 12 hello\n";
+    std::string buffer;
+    unsigned long allocations = 0;
+    for (size_t i = 0; i < count; i++) {
+        unsigned long before = allocation_count.load();
+        if (!bench_send(session, command) || !bench_read_until(session, buffer, "\r\n")) {
+            return -1;
+        }
+        if (!count_results) {
+            allocations += allocation_count.load() - before;
+        }
+
+        if (with_results) {
+            std::string return_code = stub_last_return_code();
+            before = allocation_count.load();
+
+            // The result is posted from the thread of the TeamSpeak callback
+            allocation_ignored = !count_results;
+            Telnet_interface::get_instance()->handle_request_result(STUB_SERVER_ID, return_code.c_str(), 0, nullptr);
+            allocation_ignored = true;
+            if (!bench_read_until(session, buffer, "\r\n")) {
+                return -1;
+            }
+            if (count_results) {
+                allocations += allocation_count.load() - before;
+            }
+        }
+    }
+    return (double)allocations / count;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    allocation_ignored = true;
+
+    Bench_interface telnet;
+    if (!telnet.start(make_stub_functions(10, 100))) {
+        return 1;
+    }
+    SOCKET session = bench_connect();
+    std::string buffer;
+    if (session == INVALID_SOCKET || !bench_send(session, "ts3.servers.select 1\n") || !bench_read_until(session, buffer, "\r\n")) {
+        return 1;
+    }
+
+    printf("Heap allocations per ts3.messaging.send_private 12 hello\n");
+
+    // Without a plugin ID no return code is created and nothing is tracked
+    count_allocations(session, ALLOCATION_WARMUP, false, false);
+    printf("  command, untracked                    %5.2f\n", count_allocations(session, ALLOCATION_COMMANDS, false, false));
+
+    telnet.get()->set_plugin_id("test_plugin");
+    count_allocations(session, ALLOCATION_WARMUP, true, false);
+    printf("  command, tracked request              %5.2f\n", count_allocations(session, ALLOCATION_COMMANDS, true, false));
+    printf("  request result, posted and reported   %5.2f\n", count_allocations(session, ALLOCATION_COMMANDS, true, true));
+
+    closesocket(session);
+    telnet.stop();
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+* Filenme: bench_support.cpp
+* Purpose: Implements the helpers shared by the benchmarks
+*/
+#include "bench_support.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <signal.h>
+
+#include "telnet_if.h"
+
+/// Port the interface listens on
+const unsigned short BENCH_TELNET_PORT = 23;
+
+//-----------------------------------------------------------------------------
+/// Constructor, the interface is not started yet
+Bench_interface::Bench_interface() {
+    _interface = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor, stops the interface if it runs
+Bench_interface::~Bench_interface() {
+    stop();
+}
+
+//-----------------------------------------------------------------------------
+/// Creates the interface and waits until it accepts connections
+bool Bench_interface::start(const struct TS3Functions& functions) {
+    // Clients that go away must show up as failed sends, not kill the run
+    signal(SIGPIPE, SIG_IGN);
+
+    _interface = Telnet_interface::create_instance(functions);
+    _interface->event_listen();
+    Telnet_interface* instance = _interface;
+    _thread = std::thread([instance]() {
+        while (!instance->execution_complete()) {
+            instance->execute();
+        }
+    });
+
+    // Listening is done on the interface thread, poll until it is
+    for (int attempt = 0; attempt < 200; attempt++) {
+        SOCKET probe = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(BENCH_TELNET_PORT);
+        bool connected = connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+        closesocket(probe);
+        if (connected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    fprintf(stderr, "The interface does not listen on port %u. Binding it needs root or CAP_NET_BIND_SERVICE, and the port must not be in TIME_WAIT\n", BENCH_TELNET_PORT);
+    stop();
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Shuts the interface down and destroys it
+void Bench_interface::stop() {
+    if (_interface == nullptr) {
+        return;
+    }
+    _interface->event_shutdown();
+    _thread.join();
+    Telnet_interface::destroy_instance();
+    _interface = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the running interface
+Telnet_interface* Bench_interface::get() {
+    return _interface;
+}
+
+//-----------------------------------------------------------------------------
+/// Opens a blocking connection to the interface and reads the welcome line
+SOCKET bench_connect() {
+    SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
+    if (client == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(BENCH_TELNET_PORT);
+    if (connect(client, (sockaddr*)&address, sizeof(address)) != 0) {
+        closesocket(client);
+        return INVALID_SOCKET;
+    }
+
+    int no_delay = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+    std::string welcome;
+    if (!bench_read_until(client, welcome, "\r\n")) {
+        closesocket(client);
+        return INVALID_SOCKET;
+    }
+    return client;
+}
+
+//-----------------------------------------------------------------------------
+/// Sends all bytes of a string
+bool bench_send(SOCKET socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return false;
+        }
+        sent += (size_t)result;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads into a buffer until it contains a marker, keeping the bytes after
+/// the marker in the buffer
+bool bench_read_until(SOCKET socket, std::string& buffer, const char* marker) {
+    size_t marker_length = strlen(marker);
+    size_t searched = 0;
+    while (true) {
+        size_t found = buffer.find(marker, searched);
+        if (found != std::string::npos) {
+            buffer.erase(0, found + marker_length);
+            return true;
+        }
+        searched = buffer.size() >= marker_length ? buffer.size() - marker_length + 1 : 0;
+
+        char data[16384];
+        ssize_t received = recv(socket, data, sizeof(data), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(data, (size_t)received);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a monotonic time in nanoseconds
+unsigned long long bench_now() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)counter.QuadPart;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a percentile of sorted samples
+unsigned long long bench_percentile(const std::vector<unsigned long long>& sorted, double percentile) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile / 100.0 * (double)sorted.size());
+    return sorted[index < sorted.size() ? index : sorted.size() - 1];
+}
+
+//-----------------------------------------------------------------------------
+/// Prints the count, median, 99th percentile and maximum of a set of
+/// durations, in microseconds
+void bench_report(const char* name, std::vector<unsigned long long>& samples) {
+    std::sort(samples.begin(), samples.end());
+    printf("%-32s n=%-7zu p50=%8.1f us  p99=%8.1f us  max=%8.1f us\n", name, samples.size(),
+        bench_percentile(samples, 50) / 1000.0, bench_percentile(samples, 99) / 1000.0,
+        samples.empty() ? 0.0 : samples.back() / 1000.0);
+}
@@ -0,0 +1,75 @@
+/*
+* Filenme: bench_support.h
+* Purpose: Declares helpers shared by the benchmarks: running the telnet
+*          interface on its own thread, loopback clients and timing
+*/
+#ifndef _BENCH_SUPPORT_H_
+#define _BENCH_SUPPORT_H_
+
+#include <WinSock2.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ts3_functions.h"
+
+class Telnet_interface;
+
+/// Runs the telnet interface the way the plugin does, executing it on a
+/// thread of its own until it is shut down
+class Bench_interface {
+public:
+    /// Constructor, the interface is not started yet
+    Bench_interface();
+
+    /// Destructor, stops the interface if it runs
+    ~Bench_interface();
+
+    /// Creates the interface, starts its thread and waits until it accepts
+    /// connections. Returns false if it doesn't listen in time
+    bool start(const struct TS3Functions& functions);
+
+    /// Shuts the interface down and destroys it. Close the client sockets
+    /// first, so the server side doesn't keep the port in TIME_WAIT
+    void stop();
+
+    /// Returns the running interface
+    Telnet_interface* get();
+
+private:
+    // The runner owns a thread and is not copied
+    Bench_interface(const Bench_interface&);
+    Bench_interface& operator=(const Bench_interface&);
+
+private: // Private members
+
+    /// The interface, nullptr while not started
+    Telnet_interface* _interface;
+
+    /// Thread executing the interface
+    std::thread _thread;
+};
+
+/// Opens a blocking connection to the interface and reads the welcome
+/// line. Returns INVALID_SOCKET on failure
+SOCKET bench_connect();
+
+/// Sends all bytes of a string. Returns false if the connection failed
+bool bench_send(SOCKET socket, const std::string& data);
+
+/// Reads into a buffer until it contains a marker, keeping the bytes
+/// after the marker in the buffer. Returns false if the connection closed
+bool bench_read_until(SOCKET socket, std::string& buffer, const char* marker);
+
+/// Returns a monotonic time in nanoseconds, on the clock the shimmed
+/// QueryPerformanceCounter of the interface uses
+unsigned long long bench_now();
+
+/// Prints the count, median, 99th percentile and maximum of a set of
+/// durations in nanoseconds, in microseconds. Sorts the samples
+void bench_report(const char* name, std::vector<unsigned long long>& samples);
+
+/// Returns a percentile of sorted samples
+unsigned long long bench_percentile(const std::vector<unsigned long long>& sorted, double percentile);
+
+#endif // _BENCH_SUPPORT_H_
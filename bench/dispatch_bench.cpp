@@ -0,0 +1,122 @@
+/*
+* Filenme: dispatch_bench.cpp
+* Purpose: Measures the command lookup of Command_table against a linear
+*          scan of the command names, and commands dispatched end to end
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "bench_support.h"
+#include "stub_functions.h"
+#include "command_table.h"
+
+/// The commands of telnet_commands.cpp, in the order of its command list
+static const char* const DISPATCH_COMMANDS[] = {
+    "ts3.identifier.add", "ts3.identifier.remove", "ts3.servers.connect", "ts3.servers.disconnect",
+    "ts3.servers.list", "ts3.servers.select", "ts3.channels.list", "ts3.channels.select",
+    "ts3.channels.tree", "ts3.users.list", "ts3.users.find", "ts3.users.resolve",
+    "ts3.users.move", "ts3.users.kick", "ts3.messaging.send_private", "ts3.messaging.send_channel",
+    "ts3.messaging.send_poke", "ts3.events.subscribe", "ts3.events.unsubscribe", "ts3.events.resume",
+    "ts3.events.coalesce", "ts3.session.format", "ts3.session.binary"
+};
+
+/// Number of commands
+const size_t DISPATCH_COMMAND_COUNT = sizeof(DISPATCH_COMMANDS) / sizeof(DISPATCH_COMMANDS[0]);
+
+/// Lookups timed per method
+const size_t DISPATCH_LOOKUPS = 20000000;
+
+/// Commands sent end to end, in batches
+const size_t DISPATCH_COMMANDS_SENT = 200000;
+const size_t DISPATCH_BATCH = 500;
+
+/// Keeps the compiler from dropping lookups whose result is unused
+static volatile int dispatch_sink;
+
+//-----------------------------------------------------------------------------
+/// Finds a command by comparing it with every name in turn, the way the
+/// category and action comparisons did before the table
+static int find_linear(const char* name, size_t length) {
+    for (size_t i = 0; i < DISPATCH_COMMAND_COUNT; i++) {
+        if (strlen(DISPATCH_COMMANDS[i]) == length && memcmp(DISPATCH_COMMANDS[i], name, length) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+/// Times lookups of all commands and of a miss, in nanoseconds per lookup
+template <typename Lookup>
+static double time_lookups(const std::vector<std::string>& queries, Lookup lookup) {
+    size_t rounds = DISPATCH_LOOKUPS / queries.size();
+    unsigned long long start = bench_now();
+    int found = 0;
+    for (size_t round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < queries.size(); i++) {
+            found += lookup(queries[i].data(), queries[i].length());
+        }
+    }
+    dispatch_sink = found;
+    return (double)(bench_now() - start) / (rounds * queries.size());
+}
+
+//-----------------------------------------------------------------------------
+/// Sends a command in batches and times until all replies arrived, in
+/// nanoseconds per command
+static double time_dispatch(SOCKET session, const char* command, const char* reply_end) {
+    std::string batch;
+    for (size_t i = 0; i < DISPATCH_BATCH; i++) {
+        batch.append(command);
+    }
+
+    std::string buffer;
+    unsigned long long start = bench_now();
+    for (size_t sent = 0; sent < DISPATCH_COMMANDS_SENT; sent += DISPATCH_BATCH) {
+        if (!bench_send(session, batch)) {
+            return -1;
+        }
+        for (size_t i = 0; i < DISPATCH_BATCH; i++) {
+            if (!bench_read_until(session, buffer, reply_end)) {
+                return -1;
+            }
+        }
+    }
+    return (double)(bench_now() - start) / DISPATCH_COMMANDS_SENT;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    Command_table table;
+    table.build(DISPATCH_COMMANDS, DISPATCH_COMMAND_COUNT);
+
+    std::vector<std::string> hits(DISPATCH_COMMANDS, DISPATCH_COMMANDS + DISPATCH_COMMAND_COUNT);
+    std::vector<std::string> misses;
+    misses.push_back("ts3.servers.lists");
+    misses.push_back("ts3.users.remove");
+    misses.push_back("ts3.messaging.send_privat");
+
+    printf("Lookup of %zu commands, ns per lookup\n", DISPATCH_COMMAND_COUNT);
+    printf("  hits    table %6.1f   linear %6.1f\n",
+        time_lookups(hits, [&table](const char* name, size_t length) { return table.find(name, length); }),
+        time_lookups(hits, find_linear));
+    printf("  misses  table %6.1f   linear %6.1f\n",
+        time_lookups(misses, [&table](const char* name, size_t length) { return table.find(name, length); }),
+        time_lookups(misses, find_linear));
+
+    Bench_interface telnet;
+    if (!telnet.start(make_stub_functions(10, 100))) {
+        return 1;
+    }
+    SOCKET session = bench_connect();
+    if (session == INVALID_SOCKET) {
+        return 1;
+    }
+
+    printf("Commands dispatched end to end over loopback in batches of %zu, ns per command\n", DISPATCH_BATCH);
+    printf("  ts3.servers.select 1     %8.0f\n", time_dispatch(session, "ts3.servers.select 1\n", "ok\r\n"));
+
+    closesocket(session);
+    telnet.stop();
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+* Filenme: encode_bench.cpp
+* Purpose: Compares the bytes and the encode time of responses and
+*          notifications in the text, binary and JSON formats
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "bench_support.h"
+#include "response_encoder.h"
+
+/// Times each output is encoded per format
+const size_t ENCODE_REPETITIONS = 1000000;
+
+/// Encodes between clearing the output, so it stays in the cache
+const size_t ENCODE_BATCH = 100;
+
+/// Names of the formats, in Session_format order
+static const char* const ENCODE_FORMAT_NAMES[SESSION_FORMAT_COUNT] = { "text", "binary", "JSON" };
+
+/// Keeps the compiler from dropping encodes whose output is unused
+static volatile size_t encode_sink;
+
+//-----------------------------------------------------------------------------
+/// Outputs encoded, each writing what a command handler or a notification
+/// writes for one response
+static void encode_reply(Response_encoder& encoder, Output_buffer& output) {
+    encoder.reply(output, "", "ts3.servers.select", 18, "ok");
+}
+
+static void encode_tagged_request(Response_encoder& encoder, Output_buffer& output) {
+    static const std::string tag = "#17";
+    encoder.request_status(output, tag, "ts3.messaging.send_private", 26, "done", 4711, nullptr);
+}
+
+static void encode_list_entry(Response_encoder& encoder, Output_buffer& output) {
+    encoder.list_entry(output, LIST_MARK_UNSELECTED, 1234, "Lobby", 5);
+}
+
+static void encode_list_record(Response_encoder& encoder, Output_buffer& output) {
+    encoder.begin_record(output, LIST_MARK_NONE, 1234);
+    encoder.record_string(output, "nickname", 8, "Guest 1234", 10);
+    encoder.record_number(output, "channel", 7, 17);
+    encoder.record_string(output, "uid", 3, "00000000000009771846AbCdEfGh=", 29);
+    encoder.record_number(output, "talking", 7, 0);
+    encoder.end_record(output);
+}
+
+static void encode_server_event(Response_encoder& encoder, Output_buffer& output) {
+    encoder.server_event(output, 1042, 1, "connected");
+}
+
+static void encode_message_event(Response_encoder& encoder, Output_buffer& output) {
+    static const std::string from_name = "User1234";
+    static const std::string message = "Are you coming to the \"raid\" tonight?";
+    encoder.message_event(output, 1043, "ts3.messaging.receive_private", 1, 1234, from_name, message);
+}
+
+static void encode_talk_event(Response_encoder& encoder, Output_buffer& output) {
+    encoder.talk_event(output, 0, 1, 1234, true, false, 86400123456ULL);
+}
+
+static void encode_update_event(Response_encoder& encoder, Output_buffer& output) {
+    static const std::string name = "Guest 1234";
+    encoder.update_event(output, 0, 1, true, 1234, false, 17, name, 3);
+}
+
+/// An output and its name
+struct Encode_case {
+    const char* name;
+    void (*encode)(Response_encoder& encoder, Output_buffer& output);
+};
+
+/// The outputs compared
+static const Encode_case ENCODE_CASES[] = {
+    { "reply",                  encode_reply },
+    { "tagged request status",  encode_tagged_request },
+    { "list entry",             encode_list_entry },
+    { "list record, 4 fields",  encode_list_record },
+    { "server event",           encode_server_event },
+    { "message event",          encode_message_event },
+    { "talk event",             encode_talk_event },
+    { "update event",           encode_update_event }
+};
+
+//-----------------------------------------------------------------------------
+/// Encodes an output repeatedly in a format. Returns the bytes of one
+/// encoding and sets the nanoseconds per encoding
+static size_t time_encode(Session_format format, const Encode_case& test, double& nanoseconds) {
+    Response_encoder* encoder = Response_encoder::create(format);
+    Slab_pool pool;
+    Output_buffer output(pool);
+    std::string bytes;
+    bytes.reserve(ENCODE_BATCH * 256);
+    output.redirect(&bytes);
+
+    test.encode(*encoder, output);
+    size_t length = bytes.length();
+
+    unsigned long long start = bench_now();
+    for (size_t done = 0; done < ENCODE_REPETITIONS; done += ENCODE_BATCH) {
+        bytes.clear();
+        for (size_t i = 0; i < ENCODE_BATCH; i++) {
+            test.encode(*encoder, output);
+        }
+        encode_sink = bytes.length();
+    }
+    nanoseconds = (double)(bench_now() - start) / ENCODE_REPETITIONS;
+
+    output.redirect(nullptr);
+    delete encoder;
+    return length;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    printf("Bytes and ns per encoding, %zu encodings per output and format\n", ENCODE_REPETITIONS);
+    printf("  %-24s", "");
+    for (size_t format = 0; format < SESSION_FORMAT_COUNT; format++) {
+        printf("  %-16s", ENCODE_FORMAT_NAMES[format]);
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < sizeof(ENCODE_CASES) / sizeof(ENCODE_CASES[0]); i++) {
+        printf("  %-24s", ENCODE_CASES[i].name);
+        for (size_t format = 0; format < SESSION_FORMAT_COUNT; format++) {
+            double nanoseconds = 0;
+            size_t length = time_encode((Session_format)format, ENCODE_CASES[i], nanoseconds);
+            printf("  %4zu B %6.1f ns", length, nanoseconds);
+        }
+        printf("\n");
+    }
+    return 0;
+}
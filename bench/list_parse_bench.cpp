@@ -0,0 +1,265 @@
+/*
+* Filenme: list_parse_bench.cpp
+* Purpose: Compares the CPU time a client spends parsing a ts3.users.list
+*          answer in the text format with the time it spends on the same
+*          list in the binary format
+*/
+#include <cstdio>
+#include <cstring>
+
+#include "bench_support.h"
+#include "response_encoder.h"
+
+/// Users in the list
+const size_t PARSE_USERS = 10000;
+
+/// Times each list is parsed, the fastest round counts
+const size_t PARSE_ROUNDS = 200;
+
+/// Parse time the binary format is meant to beat the text format by
+const double PARSE_TARGET_RATIO = 5.0;
+
+/// A user as a client keeps it after parsing the list
+struct Parsed_user {
+    uint64 id;
+    std::string nickname;
+    std::string uid;
+    uint64 channel;
+    uint64 talking;
+};
+
+/// Keeps the compiler from dropping parses whose result is unused
+static volatile size_t parse_sink;
+
+//-----------------------------------------------------------------------------
+/// Writes the list the way _serve_list_stream does, either as plain
+/// entries or as records of the nickname, channel, uid and talking fields
+static std::string encode_users(Session_format format, bool records) {
+    Response_encoder* encoder = Response_encoder::create(format);
+    Slab_pool pool;
+    Output_buffer output(pool);
+    std::string bytes;
+    output.redirect(&bytes);
+
+    encoder->begin_list(output, "", "ts3.users.list", 14, "Users follow below");
+    char nickname[32];
+    char uid[32];
+    for (size_t i = 1; i <= PARSE_USERS; i++) {
+        // Every tenth nickname has a space and is quoted in the text format
+        snprintf(nickname, sizeof(nickname), i % 10 == 0 ? "Guest %zu" : "User%zu", i);
+        snprintf(uid, sizeof(uid), "%020zuAbCdEfGh=", i * 7919);
+        if (!records) {
+            encoder->list_entry(output, LIST_MARK_NONE, i, nickname, strlen(nickname));
+            continue;
+        }
+        encoder->begin_record(output, LIST_MARK_NONE, i);
+        encoder->record_string(output, "nickname", 8, nickname, strlen(nickname));
+        encoder->record_number(output, "channel", 7, 1 + i % 50);
+        encoder->record_string(output, "uid", 3, uid, strlen(uid));
+        encoder->record_number(output, "talking", 7, i % 7 == 0 ? 1 : 0);
+        encoder->end_record(output);
+    }
+    encoder->end_list(output, 0, 42);
+
+    output.redirect(nullptr);
+    delete encoder;
+    return bytes;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads a decimal number, advancing the position past it
+static uint64 parse_decimal(const char*& position, const char* end) {
+    uint64 value = 0;
+    while (position < end && *position >= '0' && *position <= '9') {
+        value = value * 10 + (uint64)(*position++ - '0');
+    }
+    return value;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads a text value written by append_text_value, unquoting it if quoted
+static void parse_text_value(const char*& position, const char* end, std::string& value) {
+    if (position < end && *position == '"') {
+        value.clear();
+        position++;
+        while (position < end && *position != '"') {
+            if (*position == '\\' && position + 1 < end) {
+                position++;
+            }
+            value.push_back(*position++);
+        }
+        position++;
+        return;
+    }
+    const char* start = position;
+    while (position < end && *position != ' ') {
+        position++;
+    }
+    value.assign(start, position - start);
+}
+
+//-----------------------------------------------------------------------------
+/// Parses a list in the text format line by line, returning the number of
+/// users read. Whether entries are records follows from the command sent,
+/// a nickname may look like fields
+static size_t parse_text(const std::string& bytes, std::vector<Parsed_user>& users, bool records) {
+    size_t count = 0;
+    const char* position = bytes.data();
+    const char* end = position + bytes.length();
+    while (position < end) {
+        const char* line_end = (const char*)memchr(position, '\r', end - position);
+        if (line_end == nullptr) {
+            break;
+        }
+        if (*position >= '0' && *position <= '9') {
+            Parsed_user& user = users[count++];
+            user.id = parse_decimal(position, line_end);
+            if (!records) {
+                // The nickname fills the rest of the line
+                user.nickname.assign(position + 2, line_end - position - 2);
+            } else {
+                position++;
+                while (position < line_end) {
+                    position++;
+                    const char* key = position;
+                    while (position < line_end && *position != '=') {
+                        position++;
+                    }
+                    size_t key_length = position - key;
+                    position++;
+                    if (key_length == 8 && memcmp(key, "nickname", 8) == 0) {
+                        parse_text_value(position, line_end, user.nickname);
+                    } else if (key_length == 3 && memcmp(key, "uid", 3) == 0) {
+                        parse_text_value(position, line_end, user.uid);
+                    } else if (key_length == 7 && memcmp(key, "channel", 7) == 0) {
+                        user.channel = parse_decimal(position, line_end);
+                    } else if (key_length == 7 && memcmp(key, "talking", 7) == 0) {
+                        user.talking = parse_decimal(position, line_end);
+                    }
+                }
+            }
+        }
+        position = line_end + 2;
+    }
+    return count;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads a varint, advancing the position past it
+static uint64 parse_varint(const unsigned char*& position) {
+    uint64 value = 0;
+    int shift = 0;
+    while (*position & 0x80) {
+        value |= (uint64)(*position++ & 0x7F) << shift;
+        shift += 7;
+    }
+    return value | ((uint64)*position++ << shift);
+}
+
+//-----------------------------------------------------------------------------
+/// Parses a list in the binary format frame by frame, returning the number
+/// of users read
+static size_t parse_binary(const std::string& bytes, std::vector<Parsed_user>& users, bool /* records */) {
+    size_t count = 0;
+    const unsigned char* position = (const unsigned char*)bytes.data();
+    const unsigned char* end = position + bytes.length();
+    while (position < end) {
+        size_t length = (size_t)parse_varint(position);
+        const unsigned char* frame_end = position + length;
+        uint64 type = parse_varint(position) >> 1;
+        if (type == BINARY_FRAME_LIST_ENTRY || type == BINARY_FRAME_LIST_RECORD) {
+            Parsed_user& user = users[count++];
+            parse_varint(position);
+            user.id = parse_varint(position) >> 1;
+            if (type == BINARY_FRAME_LIST_ENTRY) {
+                size_t name_length = (size_t)(parse_varint(position) >> 1);
+                user.nickname.assign((const char*)position, name_length);
+            }
+            while (type == BINARY_FRAME_LIST_RECORD && position < frame_end) {
+                size_t key_length = (size_t)(parse_varint(position) >> 1);
+                const char* key = (const char*)position;
+                position += key_length;
+                uint64 value = parse_varint(position);
+                std::string* text = nullptr;
+                if (key_length == 8 && memcmp(key, "nickname", 8) == 0) {
+                    text = &user.nickname;
+                } else if (key_length == 3 && memcmp(key, "uid", 3) == 0) {
+                    text = &user.uid;
+                } else if (key_length == 7 && memcmp(key, "channel", 7) == 0) {
+                    user.channel = value >> 1;
+                } else if (key_length == 7 && memcmp(key, "talking", 7) == 0) {
+                    user.talking = value >> 1;
+                }
+                if (value & 1) {
+                    if (text != nullptr) {
+                        text->assign((const char*)position, (size_t)(value >> 1));
+                    }
+                    position += value >> 1;
+                }
+            }
+        }
+        position = frame_end;
+    }
+    return count;
+}
+
+//-----------------------------------------------------------------------------
+/// Parses a list repeatedly and returns the fastest round in nanoseconds,
+/// leaving the users of the last round
+template <typename Parser>
+static unsigned long long time_parse(const std::string& bytes, bool records, Parser parser, std::vector<Parsed_user>& users) {
+    users.assign(PARSE_USERS, Parsed_user());
+    unsigned long long fastest = ~0ULL;
+    for (size_t round = 0; round < PARSE_ROUNDS; round++) {
+        unsigned long long start = bench_now();
+        size_t count = parser(bytes, users, records);
+        unsigned long long duration = bench_now() - start;
+        if (count != PARSE_USERS) {
+            fprintf(stderr, "Parsed %zu of %zu users\n", count, PARSE_USERS);
+            return 0;
+        }
+        parse_sink = count + users[PARSE_USERS - 1].nickname.length();
+        if (duration < fastest) {
+            fastest = duration;
+        }
+    }
+    return fastest;
+}
+
+//-----------------------------------------------------------------------------
+/// Times both formats of a list and prints the comparison. Returns whether
+/// the binary format met the target
+static bool compare_formats(const char* name, bool records) {
+    std::string text = encode_users(SESSION_FORMAT_TEXT, records);
+    std::string binary = encode_users(SESSION_FORMAT_BINARY, records);
+    std::vector<Parsed_user> text_users;
+    std::vector<Parsed_user> binary_users;
+    unsigned long long text_time = time_parse(text, records, parse_text, text_users);
+    unsigned long long binary_time = time_parse(binary, records, parse_binary, binary_users);
+    if (text_time == 0 || binary_time == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < PARSE_USERS; i++) {
+        const Parsed_user& a = text_users[i];
+        const Parsed_user& b = binary_users[i];
+        if (a.id != b.id || a.nickname != b.nickname || a.uid != b.uid || a.channel != b.channel || a.talking != b.talking) {
+            fprintf(stderr, "The formats disagree on user %zu\n", i + 1);
+            return false;
+        }
+    }
+
+    double ratio = (double)text_time / binary_time;
+    printf("  %-28s text %7zu bytes %7.1f us   binary %7zu bytes %7.1f us   text/binary %4.2fx\n",
+        name, text.length(), text_time / 1000.0, binary.length(), binary_time / 1000.0, ratio);
+    return ratio >= PARSE_TARGET_RATIO;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    printf("Client parse time of ts3.users.list with %zu users, fastest of %zu rounds\n", PARSE_USERS, PARSE_ROUNDS);
+    bool entries_met = compare_formats("entries", false);
+    bool records_met = compare_formats("nickname,channel,uid,talking", true);
+    printf("Target of %.0fx: %s for entries, %s for records\n", PARSE_TARGET_RATIO,
+        entries_met ? "met" : "not met", records_met ? "met" : "not met");
+    return 0;
+}
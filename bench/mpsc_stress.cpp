@@ -0,0 +1,213 @@
+/*
+* Filenme: mpsc_stress.cpp
+* Purpose: Stress test of Mpsc_ring with many producer threads, built with
+*          ThreadSanitizer. Pushes records straight into a ring, then calls
+*          the callbacks of the interface from many threads while it runs
+*/
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
+
+#include "bench_support.h"
+#include "stub_functions.h"
+#include "mpsc_ring.h"
+#include "telnet_if.h"
+
+/// Threads producing concurrently
+const unsigned int STRESS_PRODUCERS = 8;
+
+/// Records pushed by each producer into the bare ring
+const unsigned long STRESS_RECORDS = 20000;
+
+/// Capacity of the bare ring, small so producers keep finding it full
+const size_t STRESS_RING_CAPACITY = 64;
+
+/// Rounds of callbacks made by each producer against the interface
+const unsigned long STRESS_CALLBACK_ROUNDS = 2000;
+
+/// A record of the bare ring. The string is longer than a string's inline
+/// storage, so its buffer is handed between the threads as well
+struct Stress_record {
+    unsigned int producer;
+    unsigned long sequence;
+    std::string payload;
+};
+
+//-----------------------------------------------------------------------------
+/// Returns the payload a producer writes for a sequence number
+static std::string stress_payload(unsigned int producer, unsigned long sequence) {
+    char payload[64];
+    snprintf(payload, sizeof(payload), "producer %u record %lu of the stress test", producer, sequence);
+    return payload;
+}
+
+//-----------------------------------------------------------------------------
+/// Pushes records from all producers into one ring, retrying while it is
+/// full, and checks on the consumer side that every record arrives once,
+/// intact and in the order its producer pushed it
+static bool stress_ring() {
+    Mpsc_ring<Stress_record> ring(STRESS_RING_CAPACITY);
+    std::atomic<unsigned long> full(0);
+    std::vector<std::thread> producers;
+    for (unsigned int producer = 0; producer < STRESS_PRODUCERS; producer++) {
+        producers.push_back(std::thread([&ring, &full, producer]() {
+            Stress_record record;
+            record.producer = producer;
+            for (unsigned long sequence = 0; sequence < STRESS_RECORDS; sequence++) {
+                record.sequence = sequence;
+                record.payload = stress_payload(producer, sequence);
+                while (!ring.try_push(record)) {
+                    full++;
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    std::vector<unsigned long> expected(STRESS_PRODUCERS, 0);
+    unsigned long received = 0;
+    unsigned long errors = 0;
+    while (received < STRESS_PRODUCERS * STRESS_RECORDS) {
+        Stress_record* record = ring.front();
+        if (record == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (record->producer >= STRESS_PRODUCERS || record->sequence != expected[record->producer] ||
+            record->payload != stress_payload(record->producer, record->sequence)) {
+            if (errors++ < 10) {
+                fprintf(stderr, "Unexpected record %u/%lu\n", record->producer, record->sequence);
+            }
+        } else {
+            expected[record->producer]++;
+        }
+        ring.pop();
+        received++;
+    }
+    for (size_t i = 0; i < producers.size(); i++) {
+        producers[i].join();
+    }
+
+    bool empty = ring.front() == nullptr;
+    printf("Ring of %zu cells, %u producers: %lu records received, %lu out of order or damaged, push found the ring full %lu times\n",
+        STRESS_RING_CAPACITY, STRESS_PRODUCERS, received, errors, full.load());
+    return errors == 0 && empty;
+}
+
+//-----------------------------------------------------------------------------
+/// Counts the message notifications a session received
+struct Stress_session_counts {
+    Stress_session_counts() : messages(0), errors(0), dropped(0) {}
+
+    /// Messages of the stress test received
+    unsigned long messages;
+
+    /// Messages received twice or out of their producer's order
+    unsigned long errors;
+
+    /// Events the interface reported dropped from its full queue
+    unsigned long dropped;
+};
+
+//-----------------------------------------------------------------------------
+/// Reads notifications until none arrived for a second, checking that the
+/// messages of each producer arrive in order and at most once
+static void stress_read_session(SOCKET session, Stress_session_counts& counts) {
+    struct timeval timeout = { 1, 0 };
+    setsockopt(session, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    std::vector<long> last(STRESS_PRODUCERS * 2, -1);
+    std::string buffer;
+    while (bench_read_until(session, buffer, "\r\n")) {
+        size_t end;
+        while ((end = buffer.find("\r\n")) != std::string::npos) {
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 2);
+
+            char kind[16];
+            unsigned int producer;
+            long sequence;
+            unsigned long dropped;
+            const char* dropped_text = strstr(line.c_str(), "ts3.error: ");
+            if (dropped_text != nullptr && sscanf(dropped_text, "ts3.error: %lu events dropped", &dropped) == 1) {
+                counts.dropped += dropped;
+            } else if (sscanf(line.c_str(), "stress %15s %u %ld", kind, &producer, &sequence) == 3 && producer < STRESS_PRODUCERS) {
+                long& previous = last[producer * 2 + (strcmp(kind, "poke") == 0 ? 1 : 0)];
+                if (sequence <= previous) {
+                    counts.errors++;
+                }
+                previous = sequence;
+                counts.messages++;
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Calls the callbacks of the interface from many threads while a session
+/// subscribed to everything reads the notifications. Private messages and
+/// pokes go through the event queue together with talk notifications and
+/// client moves, request results through the control queue
+static bool stress_interface() {
+    Bench_interface telnet;
+    if (!telnet.start(make_stub_functions(10, 100))) {
+        return false;
+    }
+    Telnet_interface* telnet_if = telnet.get();
+    telnet_if->handle_server_connected(STUB_SERVER_ID);
+
+    SOCKET session = bench_connect();
+    std::string buffer;
+    if (session == INVALID_SOCKET || !bench_send(session, "ts3.events.subscribe all,talk\n") || !bench_read_until(session, buffer, "\r\n")) {
+        return false;
+    }
+
+    Stress_session_counts counts;
+    std::thread reader([session, &counts]() {
+        stress_read_session(session, counts);
+    });
+
+    std::vector<std::thread> producers;
+    for (unsigned int producer = 0; producer < STRESS_PRODUCERS; producer++) {
+        producers.push_back(std::thread([telnet_if, producer]() {
+            char message[64];
+            for (unsigned long round = 0; round < STRESS_CALLBACK_ROUNDS; round++) {
+                anyID client_id = (anyID)(1 + (producer * STRESS_CALLBACK_ROUNDS + round) % 100);
+                snprintf(message, sizeof(message), "stress private %u %lu", producer, round);
+                telnet_if->handle_private_text_message(STUB_SERVER_ID, client_id, "Stress", message);
+                snprintf(message, sizeof(message), "stress poke %u %lu", producer, round);
+                telnet_if->handle_poke(STUB_SERVER_ID, client_id, "Stress", message);
+                telnet_if->handle_talk_status(STUB_SERVER_ID, client_id, round % 2 == 0, false);
+                telnet_if->handle_client_moved(STUB_SERVER_ID, client_id, 1 + round % 10);
+                telnet_if->handle_request_result(STUB_SERVER_ID, "PR:stress:0", 0, nullptr);
+
+                // Let the interface thread in now and then, so not nearly
+                // all events find the queue full
+                std::this_thread::yield();
+            }
+        }));
+    }
+    for (size_t i = 0; i < producers.size(); i++) {
+        producers[i].join();
+    }
+    reader.join();
+
+    unsigned long sent = STRESS_PRODUCERS * STRESS_CALLBACK_ROUNDS * 2;
+    printf("Interface, %u producers: %lu messages sent, %lu received, %lu out of order or repeated, %lu events reported dropped\n",
+        STRESS_PRODUCERS, sent, counts.messages, counts.errors, counts.dropped);
+
+    closesocket(session);
+    telnet.stop();
+
+    // Dropped events are counted over all kinds, so only bound the loss
+    return counts.errors == 0 && counts.messages <= sent && counts.messages + counts.dropped >= sent;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    bool passed = stress_ring();
+    passed = stress_interface() && passed;
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
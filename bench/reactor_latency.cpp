@@ -0,0 +1,152 @@
+/*
+* Filenme: reactor_latency.cpp
+* Purpose: Measures the command round trip of busy sessions while hundreds
+*          of idle sessions are connected to the reactor
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+
+#include "bench_support.h"
+#include "stub_functions.h"
+
+/// Sessions which only stay connected
+const size_t REACTOR_IDLE_SESSIONS = 500;
+
+/// Sessions sending one command after the other
+const size_t REACTOR_BUSY_SESSIONS = 50;
+
+/// Round trips measured per busy session and run
+const size_t REACTOR_ROUND_TRIPS = 2000;
+
+//-----------------------------------------------------------------------------
+/// Runs the busy sessions until each completed its round trips, collecting
+/// the duration of every round trip
+static bool run_busy_sessions(std::vector<SOCKET>& busy, std::vector<unsigned long long>& samples) {
+    std::vector<std::vector<unsigned long long> > durations(busy.size());
+    std::vector<bool> failed(busy.size(), false);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < busy.size(); i++) {
+        threads.push_back(std::thread([&busy, &durations, &failed, i]() {
+            std::string buffer;
+            durations[i].reserve(REACTOR_ROUND_TRIPS);
+            for (size_t j = 0; j < REACTOR_ROUND_TRIPS; j++) {
+                unsigned long long start = bench_now();
+                if (!bench_send(busy[i], "ts3.servers.select 1\n") || !bench_read_until(busy[i], buffer, "ok\r\n")) {
+                    failed[i] = true;
+                    return;
+                }
+                durations[i].push_back(bench_now() - start);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    samples.clear();
+    for (size_t i = 0; i < busy.size(); i++) {
+        if (failed[i]) {
+            return false;
+        }
+        samples.insert(samples.end(), durations[i].begin(), durations[i].end());
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Client side, run in a process of its own: all sockets of both sides in
+/// one process would exceed the descriptor numbers select can handle
+static int run_clients() {
+    std::vector<SOCKET> busy;
+    for (size_t i = 0; i < REACTOR_BUSY_SESSIONS; i++) {
+        SOCKET session = INVALID_SOCKET;
+        for (int attempt = 0; attempt < 200 && session == INVALID_SOCKET; attempt++) {
+            session = bench_connect();
+            if (session == INVALID_SOCKET) {
+                usleep(10000);
+            }
+        }
+        if (session == INVALID_SOCKET) {
+            fprintf(stderr, "Could not connect a busy session\n");
+            return 1;
+        }
+        busy.push_back(session);
+    }
+
+    std::vector<unsigned long long> samples;
+    std::vector<SOCKET> single(1, busy[0]);
+    char name[64];
+    if (!run_busy_sessions(single, samples)) {
+        fprintf(stderr, "A busy session failed\n");
+        return 1;
+    }
+    snprintf(name, sizeof(name), "1 busy, %zu idle", busy.size() - 1);
+    bench_report(name, samples);
+
+    if (!run_busy_sessions(busy, samples)) {
+        fprintf(stderr, "A busy session failed\n");
+        return 1;
+    }
+    snprintf(name, sizeof(name), "%zu busy, 0 idle", busy.size());
+    bench_report(name, samples);
+
+    std::vector<SOCKET> idle;
+    for (size_t i = 0; i < REACTOR_IDLE_SESSIONS; i++) {
+        SOCKET session = bench_connect();
+        if (session == INVALID_SOCKET) {
+            fprintf(stderr, "Could not connect idle session %zu\n", i);
+            return 1;
+        }
+        idle.push_back(session);
+    }
+
+    if (!run_busy_sessions(busy, samples)) {
+        fprintf(stderr, "A busy session failed\n");
+        return 1;
+    }
+    snprintf(name, sizeof(name), "%zu busy, %zu idle", busy.size(), idle.size());
+    bench_report(name, samples);
+
+    // A single busy session shows the cost of a reactor round over all
+    // sessions, without waiting behind the other busy ones
+    if (!run_busy_sessions(single, samples)) {
+        fprintf(stderr, "A busy session failed\n");
+        return 1;
+    }
+    snprintf(name, sizeof(name), "1 busy, %zu idle", busy.size() - 1 + idle.size());
+    bench_report(name, samples);
+
+    // Close from this side, so the port isn't left in TIME_WAIT
+    for (size_t i = 0; i < busy.size(); i++) {
+        closesocket(busy[i]);
+    }
+    for (size_t i = 0; i < idle.size(); i++) {
+        closesocket(idle[i]);
+    }
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    printf("Round trips of ts3.servers.select, %zu per busy session\n", REACTOR_ROUND_TRIPS);
+    fflush(stdout);
+
+    // Fork before any thread is started
+    pid_t clients = fork();
+    if (clients == 0) {
+        return run_clients();
+    }
+
+    Bench_interface telnet;
+    if (!telnet.start(make_stub_functions(10, 100))) {
+        kill(clients, SIGKILL);
+        return 1;
+    }
+
+    int status = 0;
+    waitpid(clients, &status, 0);
+    usleep(100000);
+    telnet.stop();
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
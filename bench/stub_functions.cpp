@@ -0,0 +1,274 @@
+/*
+* Filenme: stub_functions.cpp
+* Purpose: Implements the stub TeamSpeak client functions the benchmarks run
+*          the telnet interface against
+*/
+#include "stub_functions.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_definitions.h"
+
+/// Size of the fake server
+static size_t stub_channel_count = 1;
+static size_t stub_client_count = 1;
+
+/// Requests sent to the server
+static std::atomic<unsigned long> stub_requests(0);
+
+/// Return code of the most recent request
+static std::mutex stub_return_code_mutex;
+static std::string stub_return_code;
+static unsigned long stub_next_return_code = 1;
+
+//-----------------------------------------------------------------------------
+/// Copies a string into memory the interface frees with freeMemory
+static char* stub_strdup(const char* text) {
+    size_t length = strlen(text) + 1;
+    char* copy = (char*)malloc(length);
+    memcpy(copy, text, length);
+    return copy;
+}
+
+//-----------------------------------------------------------------------------
+static unsigned int stub_log_message(const char*, enum LogLevel, const char*, uint64) {
+    return ERROR_ok;
+}
+
+static unsigned int stub_free_memory(void* pointer) {
+    free(pointer);
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_error_message(unsigned int, char** error) {
+    *error = stub_strdup("error");
+    return ERROR_ok;
+}
+
+//-----------------------------------------------------------------------------
+static unsigned int stub_get_server_list(uint64** result) {
+    *result = (uint64*)calloc(2, sizeof(uint64));
+    (*result)[0] = STUB_SERVER_ID;
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_server_string(uint64, size_t, char** result) {
+    *result = stub_strdup("Stub server");
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_connection_status(uint64, int* result) {
+    *result = STATUS_CONNECTION_ESTABLISHED;
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_client_id(uint64, anyID* result) {
+    *result = 1;
+    return ERROR_ok;
+}
+
+//-----------------------------------------------------------------------------
+static unsigned int stub_get_channel_list(uint64, uint64** result) {
+    *result = (uint64*)calloc(stub_channel_count + 1, sizeof(uint64));
+    for (size_t i = 0; i < stub_channel_count; i++) {
+        (*result)[i] = i + 1;
+    }
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_parent_channel(uint64, uint64 channel_id, uint64* result) {
+    if (channel_id == 0 || channel_id > stub_channel_count) {
+        return ERROR_channel_invalid_id;
+    }
+    *result = channel_id > 1 ? 1 : 0;
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_channel_string(uint64, uint64 channel_id, size_t, char** result) {
+    char name[32];
+    snprintf(name, sizeof(name), "Channel %llu", (unsigned long long)channel_id);
+    *result = stub_strdup(name);
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_channel_int(uint64, uint64, size_t, int* result) {
+    *result = 0;
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_channel_uint64(uint64, uint64 channel_id, size_t, uint64* result) {
+    *result = channel_id > 1 ? channel_id - 1 : 0;
+    return ERROR_ok;
+}
+
+//-----------------------------------------------------------------------------
+static unsigned int stub_get_client_list(uint64, anyID** result) {
+    *result = (anyID*)calloc(stub_client_count + 1, sizeof(anyID));
+    for (size_t i = 0; i < stub_client_count; i++) {
+        (*result)[i] = (anyID)(i + 1);
+    }
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_channel_of_client(uint64, anyID client_id, uint64* result) {
+    if (client_id == 0 || client_id > stub_client_count) {
+        return ERROR_client_invalid_id;
+    }
+    *result = 1 + client_id % stub_channel_count;
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_client_string(uint64, anyID client_id, size_t flag, char** result) {
+    char text[32];
+    if (flag == CLIENT_UNIQUE_IDENTIFIER) {
+        snprintf(text, sizeof(text), "uid%u=", (unsigned int)client_id);
+    } else {
+        snprintf(text, sizeof(text), "User%u", (unsigned int)client_id);
+    }
+    *result = stub_strdup(text);
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_client_int(uint64, anyID, size_t, int* result) {
+    *result = 0;
+    return ERROR_ok;
+}
+
+static unsigned int stub_get_client_uint64(uint64, anyID client_id, size_t, uint64* result) {
+    *result = 1000 + client_id;
+    return ERROR_ok;
+}
+
+static unsigned int stub_client_property_to_flag(const char* property, size_t* flag) {
+    if (strcmp(property, "client_nickname") == 0) {
+        *flag = CLIENT_NICKNAME;
+    } else if (strcmp(property, "client_unique_identifier") == 0) {
+        *flag = CLIENT_UNIQUE_IDENTIFIER;
+    } else if (strcmp(property, "client_flag_talking") == 0) {
+        *flag = CLIENT_FLAG_TALKING;
+    } else {
+        return ERROR_parameter_invalid;
+    }
+    return ERROR_ok;
+}
+
+static unsigned int stub_channel_property_to_flag(const char* property, size_t* flag) {
+    if (strcmp(property, "channel_name") == 0) {
+        *flag = CHANNEL_NAME;
+    } else if (strcmp(property, "channel_topic") == 0) {
+        *flag = CHANNEL_TOPIC;
+    } else {
+        return ERROR_parameter_invalid;
+    }
+    return ERROR_ok;
+}
+
+//-----------------------------------------------------------------------------
+/// Counts a request to the server
+static unsigned int stub_request() {
+    stub_requests++;
+    return ERROR_ok;
+}
+
+static unsigned int stub_stop_connection(uint64, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_request_move(uint64, anyID, uint64, const char*, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_request_kick(uint64, anyID, const char*, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_request_private_message(uint64, const char*, anyID, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_request_channel_message(uint64, const char*, uint64, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_request_poke(uint64, anyID, const char*, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_request_database_id(uint64, const char*, const char*) {
+    return stub_request();
+}
+
+static unsigned int stub_gui_connect(enum PluginConnectTab, const char*, const char*, const char*, const char*, const char*, const char*, const char*, const char*, const char*, const char*, const char*, const char*, const char*, uint64* result) {
+    *result = STUB_SERVER_ID + 1;
+    return stub_request();
+}
+
+//-----------------------------------------------------------------------------
+/// Creates unique return codes without allocating. They are made as long
+/// as the client's, which don't fit a string's inline storage
+static void stub_create_return_code(const char* plugin_id, char* return_code, size_t max_length) {
+    std::lock_guard<std::mutex> lock(stub_return_code_mutex);
+    snprintf(return_code, max_length, "PR:%s:%lu", plugin_id, stub_next_return_code++);
+    stub_return_code.assign(return_code);
+}
+
+//-----------------------------------------------------------------------------
+/// Returns functions answering for a single connected server
+struct TS3Functions make_stub_functions(size_t channel_count, size_t client_count) {
+    stub_channel_count = channel_count > 0 ? channel_count : 1;
+    stub_client_count = client_count;
+
+    // Keep the return code's storage, so creating codes doesn't allocate
+    stub_return_code.reserve(64);
+
+    struct TS3Functions functions;
+    memset(&functions, 0, sizeof(functions));
+    functions.logMessage = stub_log_message;
+    functions.freeMemory = stub_free_memory;
+    functions.getErrorMessage = stub_get_error_message;
+    functions.getServerConnectionHandlerList = stub_get_server_list;
+    functions.getServerVariableAsString = stub_get_server_string;
+    functions.getConnectionStatus = stub_get_connection_status;
+    functions.getClientID = stub_get_client_id;
+    functions.getChannelList = stub_get_channel_list;
+    functions.getParentChannelOfChannel = stub_get_parent_channel;
+    functions.getChannelVariableAsString = stub_get_channel_string;
+    functions.getChannelVariableAsInt = stub_get_channel_int;
+    functions.getChannelVariableAsUInt64 = stub_get_channel_uint64;
+    functions.getClientList = stub_get_client_list;
+    functions.getChannelOfClient = stub_get_channel_of_client;
+    functions.getClientVariableAsString = stub_get_client_string;
+    functions.getClientVariableAsInt = stub_get_client_int;
+    functions.getClientVariableAsUInt64 = stub_get_client_uint64;
+    functions.clientPropertyStringToFlag = stub_client_property_to_flag;
+    functions.channelPropertyStringToFlag = stub_channel_property_to_flag;
+    functions.stopConnection = stub_stop_connection;
+    functions.requestClientMove = stub_request_move;
+    functions.requestClientKickFromChannel = stub_request_kick;
+    functions.requestClientKickFromServer = stub_request_kick;
+    functions.requestSendPrivateTextMsg = stub_request_private_message;
+    functions.requestSendChannelTextMsg = stub_request_channel_message;
+    functions.requestClientPoke = stub_request_poke;
+    functions.requestClientDBIDfromUID = stub_request_database_id;
+    functions.guiConnect = stub_gui_connect;
+    functions.createReturnCode = stub_create_return_code;
+    return functions;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the return code created for the most recent request
+std::string stub_last_return_code() {
+    std::lock_guard<std::mutex> lock(stub_return_code_mutex);
+    return stub_return_code;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the number of requests sent to the server
+unsigned long stub_request_count() {
+    return stub_requests.load();
+}
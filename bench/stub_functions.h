@@ -0,0 +1,31 @@
+/*
+* Filenme: stub_functions.h
+* Purpose: Declares the stub TeamSpeak client functions the benchmarks run
+*          the telnet interface against
+*/
+#ifndef _STUB_FUNCTIONS_H_
+#define _STUB_FUNCTIONS_H_
+
+#include <cstddef>
+#include <string>
+
+#include "ts3_functions.h"
+
+/// Server connection the stub client is connected to
+const uint64 STUB_SERVER_ID = 1;
+
+/// Returns functions answering for a single connected server with the given
+/// number of channels and clients. Channels are numbered from 1, channel 1
+/// is the root of the others. Clients are numbered from 1, named
+/// "User<id>" and spread over the channels. Requests to the server succeed
+/// without doing anything
+struct TS3Functions make_stub_functions(size_t channel_count, size_t client_count);
+
+/// Returns the return code created for the most recent request
+std::string stub_last_return_code();
+
+/// Returns the number of requests sent to the server, such as messages,
+/// pokes and moves
+unsigned long stub_request_count();
+
+#endif // _STUB_FUNCTIONS_H_
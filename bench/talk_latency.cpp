@@ -0,0 +1,107 @@
+/*
+* Filenme: talk_latency.cpp
+* Purpose: Measures the time from a talk status callback to the talk
+*          notification arriving at a subscribed session over loopback
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "bench_support.h"
+#include "stub_functions.h"
+#include "telnet_if.h"
+
+/// Talk changes injected per rate
+const size_t TALK_EVENTS = 5000;
+
+/// Rates the changes are injected at, per second
+static const unsigned int TALK_RATES[] = { 100, 1000, 5000 };
+
+/// Latency the 99th percentile is meant to stay below, in microseconds
+const unsigned long long TALK_TARGET_P99 = 1000;
+
+//-----------------------------------------------------------------------------
+/// Reads talk notifications until the given number arrived, collecting the
+/// time from the callback to the arrival of each. The notification carries
+/// the monotonic time of the callback in microseconds
+static bool read_talk_events(SOCKET session, size_t count, std::vector<unsigned long long>& samples) {
+    char data[65536];
+    std::string buffer;
+    samples.clear();
+    while (samples.size() < count) {
+        int received = recv(session, data, sizeof(data), 0);
+        if (received <= 0) {
+            return false;
+        }
+        unsigned long long now = bench_now() / 1000;
+        buffer.append(data, received);
+
+        size_t end;
+        while ((end = buffer.find("\r\n")) != std::string::npos) {
+            unsigned long long timestamp;
+            if (sscanf(buffer.c_str(), ">ts3.talk %*u %*u %*u %*u %llu", &timestamp) == 1) {
+                samples.push_back((now - timestamp) * 1000);
+            }
+            buffer.erase(0, end + 2);
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Injects talk changes at a rate from this thread, the way the TeamSpeak
+/// callbacks arrive, while a thread reads them from the session. Returns
+/// whether the 99th percentile met the target
+static bool measure_rate(Telnet_interface* telnet_if, SOCKET session, unsigned int rate, bool& failed) {
+    std::vector<unsigned long long> samples;
+    std::thread reader([session, &samples, &failed]() {
+        failed = !read_talk_events(session, TALK_EVENTS, samples);
+    });
+
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds interval(1000000000 / rate);
+    for (size_t i = 0; i < TALK_EVENTS; i++) {
+        next += interval;
+        std::this_thread::sleep_until(next);
+        telnet_if->handle_talk_status(STUB_SERVER_ID, (anyID)(1 + i % 100), i % 2 == 0, false);
+    }
+    reader.join();
+    if (failed) {
+        return false;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%u per second", rate);
+    bench_report(name, samples);
+    return bench_percentile(samples, 99) < TALK_TARGET_P99 * 1000;
+}
+
+//-----------------------------------------------------------------------------
+int main() {
+    Bench_interface telnet;
+    if (!telnet.start(make_stub_functions(10, 100))) {
+        return 1;
+    }
+    Telnet_interface* telnet_if = telnet.get();
+    telnet_if->handle_server_connected(STUB_SERVER_ID);
+
+    SOCKET session = bench_connect();
+    std::string buffer;
+    if (session == INVALID_SOCKET || !bench_send(session, "ts3.events.subscribe talk\n") || !bench_read_until(session, buffer, "\r\n")) {
+        return 1;
+    }
+
+    printf("Talk callback to notification received over loopback, %zu changes per rate\n", TALK_EVENTS);
+    bool met = true;
+    bool failed = false;
+    for (size_t i = 0; i < sizeof(TALK_RATES) / sizeof(TALK_RATES[0]) && !failed; i++) {
+        met = measure_rate(telnet_if, session, TALK_RATES[i], failed) && met;
+    }
+    if (!failed) {
+        printf("Target of p99 below %llu us: %s\n", TALK_TARGET_P99, met ? "met" : "not met");
+    }
+
+    closesocket(session);
+    telnet.stop();
+    return failed ? 1 : 0;
+}
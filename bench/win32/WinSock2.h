@@ -0,0 +1,87 @@
+/*
+* Filenme: WinSock2.h
+* Purpose: Linux stand-ins for the parts of Winsock used by the telnet
+*          interface, so its sources build for the benchmarks. Not used by
+*          the plugin build
+*/
+#ifndef _BENCH_WINSOCK2_H_
+#define _BENCH_WINSOCK2_H_
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+typedef int SOCKET;
+typedef unsigned long DWORD;
+typedef unsigned long ULONG;
+typedef unsigned short WORD;
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define MAKEWORD(low, high) ((WORD)(((low) & 0xff) | (((high) & 0xff) << 8)))
+#define ZeroMemory(destination, length) memset((destination), 0, (length))
+
+struct WSADATA {
+    int unused;
+};
+
+struct WSABUF {
+    ULONG len;
+    char* buf;
+};
+
+inline int WSAStartup(WORD, WSADATA*) {
+    return 0;
+}
+
+inline int WSACleanup() {
+    return 0;
+}
+
+inline int WSAGetLastError() {
+    return errno;
+}
+
+inline int closesocket(SOCKET socket) {
+    return close(socket);
+}
+
+inline int ioctlsocket(SOCKET socket, long command, u_long* argument) {
+    int value = (int)*argument;
+    return ioctl(socket, command, &value);
+}
+
+/// Gathering send, without overlapped I/O. Closed peers report an error
+/// rather than raising SIGPIPE
+inline int WSASend(SOCKET socket, WSABUF* buffers, DWORD count, DWORD* sent, DWORD, void*, void*) {
+    iovec vectors[64];
+    if (count > 64) {
+        count = 64;
+    }
+    for (DWORD i = 0; i < count; i++) {
+        vectors[i].iov_base = buffers[i].buf;
+        vectors[i].iov_len = buffers[i].len;
+    }
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+    ssize_t result = sendmsg(socket, &message, MSG_NOSIGNAL);
+    if (result < 0) {
+        return SOCKET_ERROR;
+    }
+    *sent = (DWORD)result;
+    return 0;
+}
+
+#endif // _BENCH_WINSOCK2_H_
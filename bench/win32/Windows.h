@@ -0,0 +1,33 @@
+/*
+* Filenme: Windows.h
+* Purpose: Linux stand-ins for the parts of the Windows API used by the
+*          telnet interface, for the benchmarks. Not used by the plugin
+*          build
+*/
+#ifndef _BENCH_WINDOWS_H_
+#define _BENCH_WINDOWS_H_
+
+#include <time.h>
+#include "WinSock2.h"
+
+union LARGE_INTEGER {
+    long long QuadPart;
+};
+
+inline int QueryPerformanceCounter(LARGE_INTEGER* counter) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    counter->QuadPart = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+    return 1;
+}
+
+inline int QueryPerformanceFrequency(LARGE_INTEGER* frequency) {
+    frequency->QuadPart = 1000000000LL;
+    return 1;
+}
+
+inline void Sleep(DWORD milliseconds) {
+    usleep(milliseconds * 1000);
+}
+
+#endif // _BENCH_WINDOWS_H_
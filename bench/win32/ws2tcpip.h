@@ -0,0 +1,5 @@
+/*
+* Filenme: ws2tcpip.h
+* Purpose: Linux stand-in for the Winsock TCP/IP header, for the benchmarks
+*/
+#include "WinSock2.h"
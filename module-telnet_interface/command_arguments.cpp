@@ -0,0 +1,167 @@
+/*
+* Filenme: command_arguments.cpp
+* Purpose: Implements the Command_arguments class functions and members
+*/
+#include "command_arguments.h"
+#include "varint.h"
+
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+/// Determines if a character separates tokens
+static bool is_separator(char c) {
+    return c == ' ' || c == '\t';
+}
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Command_arguments::Command_arguments(char* line, size_t length, Argument_syntax syntax) {
+    _syntax = syntax;
+    _position = line;
+    _write = line;
+    _end = line + length;
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next token
+Argument_result Command_arguments::next(Token& token) {
+    if (_syntax == ARGUMENT_SYNTAX_BINARY) {
+        return _next_binary(token);
+    }
+
+    while (_position < _end && is_separator(*_position)) {
+        _position++;
+    }
+    if (_position == _end) {
+        return ARGUMENT_MISSING;
+    }
+
+    // The token is unescaped in place. The unescaped text is never longer
+    // than the escaped one, so it can be written behind the read position
+    char* write = _position;
+    token.data = _position;
+    bool quoted = false;
+    while (_position < _end && (quoted || !is_separator(*_position))) {
+        if (*_position == '"') {
+            quoted = !quoted;
+            _position++;
+            continue;
+        }
+        if (quoted && *_position == '\\' && _position + 1 < _end && (_position[1] == '"' || _position[1] == '\\')) {
+            _position++;
+        }
+        *write++ = *_position++;
+    }
+    if (quoted) {
+        // Unterminated quote
+        return ARGUMENT_INVALID;
+    }
+    token.length = write - token.data;
+
+    // Skip the separator, then terminate the token. The line itself is
+    // already NUL terminated
+    if (_position < _end) {
+        _position++;
+    }
+    *write = '\0';
+    return ARGUMENT_OK;
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next token as an unsigned number
+Argument_result Command_arguments::next_number(uint64& value, uint64 max_value) {
+    if (_syntax == ARGUMENT_SYNTAX_BINARY && _position < _end && (*_position & 1) == 0) {
+        // Number values have an even header, and take no further bytes
+        uint64 header;
+        if (!_next_value(header) || (header >> 1) > max_value) {
+            return ARGUMENT_INVALID;
+        }
+        value = header >> 1;
+        return ARGUMENT_OK;
+    }
+
+    Token token;
+    Argument_result result = next(token);
+    if (result != ARGUMENT_OK) {
+        return result;
+    }
+    return parse_number(token, max_value, value) ? ARGUMENT_OK : ARGUMENT_INVALID;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the unparsed remainder of the line
+Token Command_arguments::rest() {
+    Token token;
+    if (_syntax == ARGUMENT_SYNTAX_BINARY) {
+        if (next(token) != ARGUMENT_OK) {
+            token.data = "";
+            token.length = 0;
+        }
+        return token;
+    }
+
+    token.data = _position;
+    token.length = _end - _position;
+    _position = _end;
+    return token;
+}
+
+//-----------------------------------------------------------------------------
+/// Decodes the header of the next value of a binary frame
+bool Command_arguments::_next_value(uint64& header) {
+    size_t header_length;
+    if (decode_varint(_position, _end - _position, header, header_length) != VARINT_OK) {
+        return false;
+    }
+    _position += header_length;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next text value of a binary frame. The text moves back over
+/// the headers of the values before it, which take at least one byte each,
+/// so there is always room for the terminating NUL
+Argument_result Command_arguments::_next_binary(Token& token) {
+    if (_position == _end) {
+        return ARGUMENT_MISSING;
+    }
+
+    uint64 header;
+    if (!_next_value(header) || (header & 1) == 0 || (header >> 1) > (uint64)(_end - _position)) {
+        // Malformed, a number, or longer than the frame
+        _position = _end;
+        return ARGUMENT_INVALID;
+    }
+
+    size_t length = (size_t)(header >> 1);
+    memmove(_write, _position, length);
+    token.data = _write;
+    token.length = length;
+    _position += length;
+    _write += length;
+    *_write++ = '\0';
+    return ARGUMENT_OK;
+}
+
+//-----------------------------------------------------------------------------
+/// Parses a decimal unsigned number no larger than max_value
+bool parse_number(const Token& token, uint64 max_value, uint64& value) {
+    if (token.length == 0) {
+        return false;
+    }
+
+    uint64 result = 0;
+    for (size_t i = 0; i < token.length; i++) {
+        unsigned int digit = (unsigned char)token.data[i] - '0';
+        if (digit > 9) {
+            return false;
+        }
+        // Reject values that would exceed the maximum before multiplying
+        if (digit > max_value || result > (max_value - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+}
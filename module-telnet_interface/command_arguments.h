@@ -0,0 +1,91 @@
+/*
+* Filenme: command_arguments.h
+* Purpose: Defines the Command_arguments class, which splits a command line
+*          into tokens in place without copying them
+*/
+#ifndef _COMMAND_ARGUMENTS_H_
+#define _COMMAND_ARGUMENTS_H_
+
+#include <cstddef>
+
+#include "teamspeak/public_definitions.h"
+
+/// A token of a command line. The data is NUL terminated, so it can be
+/// passed to the TeamSpeak API as is
+struct Token {
+    /// First character of the token
+    const char* data;
+
+    /// Length of the token
+    size_t length;
+};
+
+/// Largest value of a server or channel ID
+const uint64 ARGUMENT_MAX_UINT64 = (uint64)-1;
+
+/// Largest value of a client ID
+const uint64 ARGUMENT_MAX_ANY_ID = (anyID)-1;
+
+/// Ways commands are written by the client
+enum Argument_syntax {
+    ARGUMENT_SYNTAX_TEXT,   // A line of whitespace separated tokens
+    ARGUMENT_SYNTAX_BINARY  // The values of a binary frame, see Binary_encoder
+};
+
+/// Results of extracting an argument
+enum Argument_result {
+    ARGUMENT_OK,        // The argument was extracted
+    ARGUMENT_MISSING,   // The line has no more arguments
+    ARGUMENT_INVALID    // The argument is malformed or out of range
+};
+
+class Command_arguments {
+public:
+    /// Constructor, tokenizes the line of the given length. Text lines must
+    /// be NUL terminated. The line is modified in place and must outlive the
+    /// tokens
+    Command_arguments(char* line, size_t length, Argument_syntax syntax = ARGUMENT_SYNTAX_TEXT);
+
+    /// Extracts the next token. Tokens are separated by whitespace. Text in
+    /// double quotes, which may start anywhere in a token, may contain
+    /// whitespace, and \" or \\ inside quotes stand for a literal quote or
+    /// backslash. In binary frames, each text value is a token
+    Argument_result next(Token& token);
+
+    /// Extracts the next token as an unsigned number no larger than
+    /// max_value. Binary frames may give the number as a number value
+    Argument_result next_number(uint64& value, uint64 max_value);
+
+    /// Returns the unparsed remainder of the line, without the separator
+    /// following the previous token. Binary frames have no separators, so
+    /// their remainder is the next token
+    Token rest();
+
+private:
+    /// Decodes the header of the next value of a binary frame. Returns false
+    /// if the header is malformed
+    bool _next_value(uint64& header);
+
+    /// Extracts the next text value of a binary frame, NUL terminating it
+    /// behind the values already extracted
+    Argument_result _next_binary(Token& token);
+
+private: // Private members
+
+    /// Syntax of the line
+    Argument_syntax _syntax;
+
+    /// Position behind the last token extracted from a binary frame
+    char* _write;
+
+    /// Position of the next unparsed character
+    char* _position;
+
+    /// End of the line
+    char* _end;
+};
+
+/// Parses a decimal unsigned number no larger than max_value
+bool parse_number(const Token& token, uint64 max_value, uint64& value);
+
+#endif // _COMMAND_ARGUMENTS_H_
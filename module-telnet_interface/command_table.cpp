@@ -0,0 +1,84 @@
+/*
+* Filenme: command_table.cpp
+* Purpose: Implements the Command_table class functions and members
+*/
+#include "command_table.h"
+
+#include <cstring>
+
+/// Number of seeds tried before the table size is doubled
+const unsigned int COMMAND_TABLE_SEED_ATTEMPTS = 1000;
+
+//-----------------------------------------------------------------------------
+/// Constructor, creates an empty table
+Command_table::Command_table() {
+    _seed = 0;
+    _mask = 0;
+}
+
+//-----------------------------------------------------------------------------
+/// Builds the table for a list of command names
+void Command_table::build(const char* const* names, size_t count) {
+    _names.assign(names, names + count);
+    _lengths.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        _lengths[i] = strlen(names[i]);
+    }
+
+    // Start with at least twice as many slots as names, which makes a
+    // collision free seed quick to find
+    size_t size = 1;
+    while (size < count * 2) {
+        size <<= 1;
+    }
+
+    while (true) {
+        for (unsigned int seed = 1; seed <= COMMAND_TABLE_SEED_ATTEMPTS; seed++) {
+            if (_try_build(seed, size)) {
+                return;
+            }
+        }
+        size <<= 1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the index of the command, or -1 if it is not in the table
+int Command_table::find(const char* name, size_t length) const {
+    if (_slots.empty()) {
+        return -1;
+    }
+
+    int index = _slots[_hash(_seed, name, length) & _mask];
+    if (index >= 0 && _lengths[index] == length && memcmp(_names[index], name, length) == 0) {
+        return index;
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+/// Hashes a command name (FNV-1a, mixed with the seed)
+unsigned int Command_table::_hash(unsigned int seed, const char* data, size_t length) {
+    unsigned int hash = 2166136261u ^ (seed * 16777619u);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+//-----------------------------------------------------------------------------
+/// Attempts to place all names using the given seed and table size
+bool Command_table::_try_build(unsigned int seed, size_t size) {
+    _slots.assign(size, -1);
+    for (size_t i = 0; i < _names.size(); i++) {
+        int& slot = _slots[_hash(seed, _names[i], _lengths[i]) & (size - 1)];
+        if (slot >= 0) {
+            return false;
+        }
+        slot = (int)i;
+    }
+    _seed = seed;
+    _mask = size - 1;
+    return true;
+}
@@ -0,0 +1,50 @@
+/*
+* Filenme: command_table.h
+* Purpose: Defines the Command_table class, a perfect hash table mapping
+*          command tokens to their index in a static command list
+*/
+#ifndef _COMMAND_TABLE_H_
+#define _COMMAND_TABLE_H_
+
+#include <cstddef>
+#include <vector>
+
+class Command_table {
+public:
+    /// Constructor, creates an empty table
+    Command_table();
+
+    /// Builds the table for a list of command names. A hash seed is searched
+    /// for which no two names share a slot, so every lookup is a single
+    /// probe followed by a single comparison
+    void build(const char* const* names, size_t count);
+
+    /// Returns the index of the command, or -1 if it is not in the table
+    int find(const char* name, size_t length) const;
+
+private:
+    /// Hashes a command name
+    static unsigned int _hash(unsigned int seed, const char* data, size_t length);
+
+    /// Attempts to place all names using the given seed and table size
+    bool _try_build(unsigned int seed, size_t size);
+
+private: // Private members
+
+    /// Command names, indexed like the command list
+    std::vector<const char*> _names;
+
+    /// Lengths of the command names
+    std::vector<size_t> _lengths;
+
+    /// Slots holding a command index, or -1 for unused slots
+    std::vector<int> _slots;
+
+    /// Hash seed for which no names collide
+    unsigned int _seed;
+
+    /// Mask reducing a hash to a slot, the table size is a power of two
+    size_t _mask;
+};
+
+#endif // _COMMAND_TABLE_H_
@@ -0,0 +1,75 @@
+/*
+* Filenme: event_log.cpp
+* Purpose: Implements the Event_log class functions and members
+*/
+#include "event_log.h"
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Event_log::Event_log(size_t capacity) {
+    _events = new Logged_event[capacity];
+    _capacity = capacity;
+    _last_seq = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        _events[i].seq = 0;
+        for (size_t j = 0; j < SESSION_FORMAT_COUNT; j++) {
+            _events[i].encoded[j] = nullptr;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor
+Event_log::~Event_log() {
+    for (size_t i = 0; i < _capacity; i++) {
+        release_encodings(_events[i]);
+    }
+    delete[] _events;
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a new event with the next sequence number
+Logged_event& Event_log::append() {
+    _last_seq++;
+    Logged_event& event = _events[_last_seq % _capacity];
+    event.seq = _last_seq;
+    release_encodings(event);
+    return event;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the event with a sequence number, nullptr if it is not kept
+Logged_event* Event_log::find(uint64 seq) {
+    if (seq == 0) {
+        return nullptr;
+    }
+    Logged_event& event = _events[seq % _capacity];
+    return event.seq == seq ? &event : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the sequence number of the oldest event kept
+uint64 Event_log::get_first_seq() const {
+    if (_last_seq == 0) {
+        return 0;
+    }
+    return _last_seq < _capacity ? 1 : _last_seq - _capacity + 1;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the sequence number of the newest event
+uint64 Event_log::get_last_seq() const {
+    return _last_seq;
+}
+
+//-----------------------------------------------------------------------------
+/// Drops the references to the encodings of an event. Sessions still
+/// sending them keep their own references
+void Event_log::release_encodings(Logged_event& event) {
+    for (size_t i = 0; i < SESSION_FORMAT_COUNT; i++) {
+        if (event.encoded[i] != nullptr) {
+            event.encoded[i]->release();
+            event.encoded[i] = nullptr;
+        }
+    }
+}
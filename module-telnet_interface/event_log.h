@@ -0,0 +1,107 @@
+/*
+* Filenme: event_log.h
+* Purpose: Defines the Event_log class, a ring of the most recent
+*          notifications kept so reconnecting clients can replay the ones
+*          they missed
+*/
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+
+#include <string>
+
+#include "teamspeak/public_definitions.h"
+#include "response_encoder.h"
+#include "subscription_table.h"
+
+/// A notification kept by the log
+struct Logged_event {
+    /// Sequence number, 0 for a slot which was never used
+    uint64 seq;
+
+    /// Kind of notification
+    Notification_type type;
+
+    /// Server connection, channel of the sender and sender, 0 where not
+    /// applicable
+    uint64 server_connection_id;
+    uint64 channel_id;
+    uint64 from_id;
+
+    /// Name of the sender
+    std::string from_name;
+
+    /// Message or server state
+    std::string text;
+
+    /// Talk status and time, for talk notifications
+    bool talking;
+    bool whisper;
+    uint64 timestamp;
+
+    /// Changed entity, for update notifications: whether it is a client
+    /// or a channel, whether it is gone, the channel of the client or the
+    /// parent of the channel, and the number of changes merged into this
+    /// one. The ID is in from_id, the name in text
+    bool is_client;
+    bool removed;
+    uint64 parent_id;
+    unsigned int absorbed;
+
+    /// The notification encoded in each Session_format, nullptr until a
+    /// session using the format needs it. Sessions queue references to
+    /// these buffers, for live delivery and replays alike
+    Shared_buffer* encoded[SESSION_FORMAT_COUNT];
+};
+
+/// Fixed-size ring of notifications numbered by a sequence starting at 1.
+/// The slot of an event is its sequence number modulo the capacity, so
+/// finding an event is a single index and appending overwrites the oldest
+/// one. Slots are reused, so their strings only allocate while the ring
+/// warms up
+class Event_log {
+public:
+    /// Constructor, the log keeps the given number of events
+    explicit Event_log(size_t capacity);
+
+    /// Destructor
+    ~Event_log();
+
+    /// Starts a new event with the next sequence number, overwriting the
+    /// oldest event once the log is full and releasing its encodings. The
+    /// caller fills in the fields, the encodings are left empty
+    Logged_event& append();
+
+    /// Returns the event with a sequence number, nullptr if it was never
+    /// logged or has been overwritten
+    Logged_event* find(uint64 seq);
+
+    /// Returns the sequence number of the oldest event kept, 0 if the log
+    /// is empty
+    uint64 get_first_seq() const;
+
+    /// Returns the sequence number of the newest event, 0 if the log is
+    /// empty
+    uint64 get_last_seq() const;
+
+    /// Drops the references to the encodings of an event, for events kept
+    /// by the log or outside it
+    static void release_encodings(Logged_event& event);
+
+private:
+    // The log owns its slots and is not copied
+    Event_log(const Event_log&);
+    Event_log& operator=(const Event_log&);
+
+private: // Private members
+
+    /// Slots of the ring
+    Logged_event* _events;
+
+    /// Number of slots
+    size_t _capacity;
+
+    /// Sequence number of the newest event, 0 before the first one
+    uint64 _last_seq;
+};
+
+#endif // _EVENT_LOG_H_
@@ -0,0 +1,147 @@
+/*
+* Filenme: line_framer.cpp
+* Purpose: Implements the Line_framer class functions and members
+*/
+#include "line_framer.h"
+#include "varint.h"
+
+#include <cstring>
+
+/// Initial size of the receive buffer
+const size_t LINE_FRAMER_INITIAL_SIZE = 4096;
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Line_framer::Line_framer(size_t max_line_length) : _buffer(LINE_FRAMER_INITIAL_SIZE) {
+    _begin = 0;
+    _end = 0;
+    _scanned = 0;
+    _max_line_length = max_line_length;
+    _discarding = false;
+    _frame_skip = 0;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a pointer where at least min_space bytes can be written
+char* Line_framer::prepare(size_t min_space) {
+    if (_buffer.size() - _end < min_space) {
+        // Move the partial line to the front only when the free space at
+        // the back runs out, then grow if that is still not enough
+        if (_begin > 0) {
+            memmove(&_buffer[0], &_buffer[_begin], _end - _begin);
+            _scanned -= _begin;
+            _end -= _begin;
+            _begin = 0;
+        }
+        if (_buffer.size() - _end < min_space) {
+            _buffer.resize(_end + min_space);
+        }
+    }
+    return &_buffer[_end];
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the number of bytes that can be written at the prepared pointer
+size_t Line_framer::available() const {
+    return _buffer.size() - _end;
+}
+
+//-----------------------------------------------------------------------------
+/// Marks bytes written to the prepared space as received
+void Line_framer::commit(size_t length) {
+    _end += length;
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next complete line
+Line_framer_result Line_framer::next_line(char*& line, size_t& length) {
+    while (true) {
+        // memchr is vectorised by the C runtime, and data already searched
+        // is never scanned twice
+        char* data = &_buffer[0];
+        char* newline = (char*)memchr(data + _scanned, '\n', _end - _scanned);
+
+        if (newline == nullptr) {
+            _scanned = _end;
+            if (_end - _begin > _max_line_length) {
+                // Drop the overlong line, and everything up to its end
+                bool report = !_discarding;
+                _discarding = true;
+                _begin = _end = _scanned = 0;
+                if (report) {
+                    return LINE_FRAMER_OVERFLOW;
+                }
+            } else if (_begin == _end) {
+                // Everything was consumed, restart at the front for free
+                _begin = _end = _scanned = 0;
+            }
+            return LINE_FRAMER_NONE;
+        }
+
+        size_t line_begin = _begin;
+        size_t line_end = newline - data;
+        _begin = _scanned = line_end + 1;
+
+        if (_discarding) {
+            // This newline terminates a line that was already reported
+            _discarding = false;
+            continue;
+        }
+        if (line_end - line_begin > _max_line_length) {
+            return LINE_FRAMER_OVERFLOW;
+        }
+
+        if (line_end > line_begin && data[line_end - 1] == '\r') {
+            line_end--;
+        }
+        data[line_end] = '\0';
+
+        line = data + line_begin;
+        length = line_end - line_begin;
+        return LINE_FRAMER_LINE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next complete frame
+Line_framer_result Line_framer::next_frame(char*& frame, size_t& length) {
+    if (_frame_skip > 0) {
+        // Drop what has arrived of an overlong frame
+        size_t skipped = _end - _begin < _frame_skip ? _end - _begin : _frame_skip;
+        _begin += skipped;
+        _scanned = _begin;
+        _frame_skip -= skipped;
+    }
+
+    if (_frame_skip == 0) {
+        uint64 frame_length;
+        size_t header_length;
+        switch (decode_varint(&_buffer[0] + _begin, _end - _begin, frame_length, header_length)) {
+        case VARINT_INVALID:
+            return LINE_FRAMER_INVALID;
+        case VARINT_OK:
+            if (frame_length > _max_line_length) {
+                _begin += header_length;
+                _scanned = _begin;
+                _frame_skip = (size_t)frame_length;
+                return LINE_FRAMER_OVERFLOW;
+            }
+            if (_end - _begin - header_length >= frame_length) {
+                frame = &_buffer[0] + _begin + header_length;
+                length = (size_t)frame_length;
+                _begin += header_length + length;
+                _scanned = _begin;
+                return LINE_FRAMER_LINE;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (_begin == _end) {
+        // Everything was consumed, restart at the front for free
+        _begin = _end = _scanned = 0;
+    }
+    return LINE_FRAMER_NONE;
+}
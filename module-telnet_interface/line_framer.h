@@ -0,0 +1,72 @@
+/*
+* Filenme: line_framer.h
+* Purpose: Defines the Line_framer class, which buffers received data and
+*          splits it into complete command lines or frames
+*/
+#ifndef _LINE_FRAMER_H_
+#define _LINE_FRAMER_H_
+
+#include <cstddef>
+#include <vector>
+
+/// Results of extracting a line from the framer
+enum Line_framer_result {
+    LINE_FRAMER_NONE,       // No complete line is buffered
+    LINE_FRAMER_LINE,       // A complete line was extracted
+    LINE_FRAMER_OVERFLOW,   // A line exceeding the maximum length was dropped
+    LINE_FRAMER_INVALID     // The length of a frame is malformed, the data
+                            // cannot be split any further
+};
+
+class Line_framer {
+public:
+    /// Constructor, lines longer than max_line_length are dropped
+    Line_framer(size_t max_line_length);
+
+    /// Returns a pointer where at least min_space bytes of received data can
+    /// be written
+    char* prepare(size_t min_space);
+
+    /// Returns the number of bytes that can be written at the pointer
+    /// returned by prepare
+    size_t available() const;
+
+    /// Marks bytes written to the prepared space as received
+    void commit(size_t length);
+
+    /// Extracts the next complete line. Both "\r\n" and "\n" terminate a
+    /// line. The line is NUL terminated in place and stays valid until the
+    /// next call to prepare
+    Line_framer_result next_line(char*& line, size_t& length);
+
+    /// Extracts the next complete frame: a varint holding the length of the
+    /// frame, followed by that many bytes. Frames longer than the maximum
+    /// line length are dropped. The frame stays valid until the next call
+    /// to prepare
+    Line_framer_result next_frame(char*& frame, size_t& length);
+
+private: // Private members
+
+    /// Received data, pending bytes are in [_begin, _end)
+    std::vector<char> _buffer;
+
+    /// Start of the first unprocessed line
+    size_t _begin;
+
+    /// End of the received data
+    size_t _end;
+
+    /// Position up to which the data has been searched for a newline
+    size_t _scanned;
+
+    /// Maximum length of a line
+    size_t _max_line_length;
+
+    /// Set while the remainder of an overlong line is being dropped
+    bool _discarding;
+
+    /// Number of bytes of an overlong frame still to be dropped
+    size_t _frame_skip;
+};
+
+#endif // _LINE_FRAMER_H_
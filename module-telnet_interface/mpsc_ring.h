@@ -0,0 +1,124 @@
+/*
+* Filenme: mpsc_ring.h
+* Purpose: Defines the Mpsc_ring class template, a bounded lock-free queue
+*          with many producer threads and a single consumer thread
+*/
+#ifndef _MPSC_RING_H_
+#define _MPSC_RING_H_
+
+#include <cstddef>
+#include <atomic>
+
+/// Bounded queue after Dmitry Vyukov's array based design. Every cell
+/// carries a sequence number telling producers and the consumer whose turn
+/// it is, so producers only contend on a single atomic position and never
+/// wait for each other or for the consumer. Records are copied into cells
+/// which are reused, so their buffers are only allocated while the ring
+/// warms up
+template <typename T>
+class Mpsc_ring {
+public:
+    /// Constructor, the capacity is rounded up to a power of two
+    explicit Mpsc_ring(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _cells = new Cell[size];
+        _mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _enqueue_position.store(0, std::memory_order_relaxed);
+        _dequeue_position = 0;
+    }
+
+    /// Destructor
+    ~Mpsc_ring() {
+        delete[] _cells;
+    }
+
+    /// Copies a record into the ring. May be called from any thread. Returns
+    /// false without blocking if the ring is full
+    bool try_push(const T& item) {
+        Cell* cell;
+        size_t position = _enqueue_position.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &_cells[position & _mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+            if (difference == 0) {
+                // The cell is free, claim it
+                if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // The consumer has not released the cell yet, the ring is full
+                return false;
+            } else {
+                // Another producer claimed the cell first
+                position = _enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->item = item;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns the oldest record, or nullptr if the ring is empty. Must only
+    /// be called from the consumer thread. The record stays in the ring
+    /// until pop is called
+    T* front() {
+        Cell& cell = _cells[_dequeue_position & _mask];
+        if (cell.sequence.load(std::memory_order_acquire) != _dequeue_position + 1) {
+            return nullptr;
+        }
+        return &cell.item;
+    }
+
+    /// Releases the record returned by front to the producers
+    void pop() {
+        Cell& cell = _cells[_dequeue_position & _mask];
+        cell.sequence.store(_dequeue_position + _mask + 1, std::memory_order_release);
+        _dequeue_position++;
+    }
+
+private:
+    /// A slot of the ring
+    struct Cell {
+        /// Equals the position for a free cell, and the position plus one
+        /// for a cell holding a record
+        std::atomic<size_t> sequence;
+
+        /// Record stored in the cell
+        T item;
+    };
+
+    // Rings own their cells and are not copied
+    Mpsc_ring(const Mpsc_ring&);
+    Mpsc_ring& operator=(const Mpsc_ring&);
+
+private: // Private members
+
+    /// Cells of the ring
+    Cell* _cells;
+
+    /// Mask reducing a position to a cell index
+    size_t _mask;
+
+    /// Keeps the fields above off the producers' cache line
+    char _padding_before[64];
+
+    /// Position of the next record written by a producer
+    std::atomic<size_t> _enqueue_position;
+
+    /// Keeps the consumer's position off the producers' cache line
+    char _padding_after[64];
+
+    /// Position of the next record read by the consumer
+    size_t _dequeue_position;
+};
+
+#endif // _MPSC_RING_H_
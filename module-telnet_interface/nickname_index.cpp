@@ -0,0 +1,157 @@
+/*
+* Filenme: nickname_index.cpp
+* Purpose: Implements the Nickname_index class functions and members
+*/
+#include "nickname_index.h"
+
+#include <algorithm>
+
+/// Number of bytes in a trigram
+static const size_t TRIGRAM_LENGTH = 3;
+
+//-----------------------------------------------------------------------------
+/// Constructor, creates an empty index
+Nickname_index::Nickname_index() {
+}
+
+//-----------------------------------------------------------------------------
+/// Adds a client
+void Nickname_index::add(anyID client_id, const std::string& nickname) {
+    const std::string& key = _keys[client_id] = _fold(nickname);
+
+    Entry entry = { &key, client_id };
+    _sorted.insert(std::upper_bound(_sorted.begin(), _sorted.end(), entry, _entry_less), entry);
+
+    _collect_trigrams(key, _trigrams);
+    for (size_t i = 0; i < _trigrams.size(); i++) {
+        std::vector<anyID>& posting = _postings[_trigrams[i]];
+        posting.insert(std::upper_bound(posting.begin(), posting.end(), client_id), client_id);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Removes a client
+void Nickname_index::remove(anyID client_id) {
+    std::unordered_map<anyID, std::string>::iterator it = _keys.find(client_id);
+    if (it == _keys.end()) {
+        return;
+    }
+
+    Entry entry = { &it->second, client_id };
+    std::vector<Entry>::iterator position = std::lower_bound(_sorted.begin(), _sorted.end(), entry, _entry_less);
+    if (position != _sorted.end() && position->client_id == client_id) {
+        _sorted.erase(position);
+    }
+
+    _collect_trigrams(it->second, _trigrams);
+    for (size_t i = 0; i < _trigrams.size(); i++) {
+        std::unordered_map<unsigned int, std::vector<anyID> >::iterator posting = _postings.find(_trigrams[i]);
+        if (posting == _postings.end()) {
+            continue;
+        }
+        std::vector<anyID>::iterator found = std::lower_bound(posting->second.begin(), posting->second.end(), client_id);
+        if (found != posting->second.end() && *found == client_id) {
+            posting->second.erase(found);
+        }
+        if (posting->second.empty()) {
+            _postings.erase(posting);
+        }
+    }
+
+    _keys.erase(it);
+}
+
+//-----------------------------------------------------------------------------
+/// Removes all clients
+void Nickname_index::clear() {
+    _sorted.clear();
+    _postings.clear();
+    _keys.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Appends the clients whose nickname starts with the prefix
+void Nickname_index::find_prefix(const std::string& prefix, std::vector<anyID>& clients) const {
+    std::string key = _fold(prefix);
+    std::vector<Entry>::const_iterator it = std::lower_bound(_sorted.begin(), _sorted.end(), key, _key_less);
+    for (; it != _sorted.end() && it->key->compare(0, key.length(), key) == 0; ++it) {
+        clients.push_back(it->client_id);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Appends the clients whose nickname contains the text. Texts shorter
+/// than a trigram are looked for in every nickname
+void Nickname_index::find_substring(const std::string& text, std::vector<anyID>& clients) const {
+    std::string key = _fold(text);
+    if (key.length() < TRIGRAM_LENGTH) {
+        size_t first = clients.size();
+        for (size_t i = 0; i < _sorted.size(); i++) {
+            if (_sorted[i].key->find(key) != std::string::npos) {
+                clients.push_back(_sorted[i].client_id);
+            }
+        }
+        std::sort(clients.begin() + first, clients.end());
+        return;
+    }
+
+    // Every match contains all trigrams of the text, so the shortest list
+    // holds all matches
+    std::vector<unsigned int> trigrams;
+    _collect_trigrams(key, trigrams);
+    const std::vector<anyID>* shortest = nullptr;
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        std::unordered_map<unsigned int, std::vector<anyID> >::const_iterator posting = _postings.find(trigrams[i]);
+        if (posting == _postings.end()) {
+            return;
+        }
+        if (shortest == nullptr || posting->second.size() < shortest->size()) {
+            shortest = &posting->second;
+        }
+    }
+
+    for (size_t i = 0; i < shortest->size(); i++) {
+        anyID client_id = (*shortest)[i];
+        if (_keys.find(client_id)->second.find(key) != std::string::npos) {
+            clients.push_back(client_id);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Orders entries by nickname, then by client ID
+bool Nickname_index::_entry_less(const Entry& a, const Entry& b) {
+    int order = a.key->compare(*b.key);
+    return order < 0 || (order == 0 && a.client_id < b.client_id);
+}
+
+//-----------------------------------------------------------------------------
+/// Orders entries by nickname only
+bool Nickname_index::_key_less(const Entry& entry, const std::string& key) {
+    return *entry.key < key;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the text with ASCII letters in lower case
+std::string Nickname_index::_fold(const std::string& text) {
+    std::string folded(text);
+    for (size_t i = 0; i < folded.length(); i++) {
+        if (folded[i] >= 'A' && folded[i] <= 'Z') {
+            folded[i] = folded[i] - 'A' + 'a';
+        }
+    }
+    return folded;
+}
+
+//-----------------------------------------------------------------------------
+/// Collects the distinct trigrams of a folded text, sorted
+void Nickname_index::_collect_trigrams(const std::string& key, std::vector<unsigned int>& trigrams) {
+    trigrams.clear();
+    for (size_t i = 0; i + TRIGRAM_LENGTH <= key.length(); i++) {
+        trigrams.push_back(((unsigned int)(unsigned char)key[i] << 16) |
+                           ((unsigned int)(unsigned char)key[i + 1] << 8) |
+                           (unsigned int)(unsigned char)key[i + 2]);
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
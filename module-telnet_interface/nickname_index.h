@@ -0,0 +1,83 @@
+/*
+* Filenme: nickname_index.h
+* Purpose: Defines the Nickname_index class, which finds the clients of a
+*          server connection by the start or a part of their nickname
+*/
+#ifndef _NICKNAME_INDEX_H_
+#define _NICKNAME_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "teamspeak/public_definitions.h"
+
+/// Indexes nicknames for case insensitive lookups. A sorted array of the
+/// nicknames answers prefix lookups with a binary search. Substring lookups
+/// use posting lists of the clients whose nickname contains each trigram,
+/// verifying only the clients on the shortest list of the pattern's
+/// trigrams. ASCII letters are compared without case, other bytes as they
+/// are
+class Nickname_index {
+public:
+    /// Constructor, creates an empty index
+    Nickname_index();
+
+    /// Adds a client. A client already in the index must be removed first
+    void add(anyID client_id, const std::string& nickname);
+
+    /// Removes a client, if it is in the index
+    void remove(anyID client_id);
+
+    /// Removes all clients
+    void clear();
+
+    /// Appends the clients whose nickname starts with the prefix, in order
+    /// of their nickname
+    void find_prefix(const std::string& prefix, std::vector<anyID>& clients) const;
+
+    /// Appends the clients whose nickname contains the text, in order of
+    /// their ID
+    void find_substring(const std::string& text, std::vector<anyID>& clients) const;
+
+private:
+    /// A client in the sorted array
+    struct Entry {
+        /// Folded nickname, owned by _keys
+        const std::string* key;
+
+        /// ID of the client
+        anyID client_id;
+    };
+
+    /// Orders entries by nickname, then by client ID
+    static bool _entry_less(const Entry& a, const Entry& b);
+
+    /// Orders entries by nickname only, for prefix searches
+    static bool _key_less(const Entry& entry, const std::string& key);
+
+    /// Returns the text with ASCII letters in lower case
+    static std::string _fold(const std::string& text);
+
+    /// Collects the distinct trigrams of a folded text, sorted
+    static void _collect_trigrams(const std::string& key, std::vector<unsigned int>& trigrams);
+
+private: // Private members
+
+    /// Folded nickname of each client. Map nodes never move, so the sorted
+    /// array points into them
+    std::unordered_map<anyID, std::string> _keys;
+
+    /// Clients sorted by folded nickname
+    std::vector<Entry> _sorted;
+
+    /// Clients whose folded nickname contains a trigram, by trigram. Each
+    /// list is sorted by ID. Only trigrams in use have an entry
+    std::unordered_map<unsigned int, std::vector<anyID> > _postings;
+
+    /// Trigrams of the nickname being added or removed. Kept to reuse its
+    /// storage
+    std::vector<unsigned int> _trigrams;
+};
+
+#endif // _NICKNAME_INDEX_H_
@@ -0,0 +1,303 @@
+/*
+* Filenme: output_buffer.cpp
+* Purpose: Implements the Output_buffer, Slab_pool and Shared_buffer classes
+*/
+#include "output_buffer.h"
+
+#include <cstring>
+
+/// Maximum number of idle slabs, and of idle chunks for shared buffers,
+/// kept by a pool
+const size_t SLAB_POOL_MAX_FREE = 256;
+
+/// Maximum number of chunks handed to a single send call
+const size_t OUTPUT_MAX_SEND_CHUNKS = 16;
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Shared_buffer::Shared_buffer() {
+    _references = 1;
+}
+
+//-----------------------------------------------------------------------------
+/// Creates an empty buffer with a single reference and room for the given
+/// number of bytes
+Shared_buffer* Shared_buffer::create(size_t capacity) {
+    Shared_buffer* buffer = new Shared_buffer();
+    buffer->_data.reserve(capacity);
+    return buffer;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the string holding the bytes, to fill a buffer just created
+std::string& Shared_buffer::get_bytes() {
+    return _data;
+}
+
+//-----------------------------------------------------------------------------
+/// Adds a reference
+void Shared_buffer::add_reference() {
+    _references++;
+}
+
+//-----------------------------------------------------------------------------
+/// Drops a reference, freeing the buffer with the last one
+void Shared_buffer::release() {
+    if (--_references == 0) {
+        delete this;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the bytes of the buffer
+const char* Shared_buffer::data() const {
+    return _data.data();
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the number of bytes
+size_t Shared_buffer::size() const {
+    return _data.size();
+}
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Slab_pool::Slab_pool() {
+    _free_list = nullptr;
+    _free_count = 0;
+    _free_shared = nullptr;
+    _free_shared_count = 0;
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor, frees all cached chunks
+Slab_pool::~Slab_pool() {
+    while (_free_list != nullptr) {
+        Output_slab* slab = static_cast<Output_slab*>(_free_list);
+        _free_list = slab->next;
+        delete slab;
+    }
+    while (_free_shared != nullptr) {
+        Output_chunk* chunk = _free_shared;
+        _free_shared = chunk->next;
+        delete chunk;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns an empty slab, reusing a cached one when available
+Output_slab* Slab_pool::acquire() {
+    Output_slab* slab = static_cast<Output_slab*>(_free_list);
+    if (slab != nullptr) {
+        _free_list = slab->next;
+        _free_count--;
+    } else {
+        slab = new Output_slab;
+        slab->bytes = slab->data;
+        slab->shared = nullptr;
+    }
+    slab->next = nullptr;
+    slab->begin = 0;
+    slab->end = 0;
+    return slab;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a chunk referencing all bytes of a shared buffer
+Output_chunk* Slab_pool::acquire_shared(Shared_buffer* buffer) {
+    Output_chunk* chunk = _free_shared;
+    if (chunk != nullptr) {
+        _free_shared = chunk->next;
+        _free_shared_count--;
+    } else {
+        chunk = new Output_chunk;
+    }
+    buffer->add_reference();
+    chunk->next = nullptr;
+    chunk->begin = 0;
+    chunk->end = buffer->size();
+    chunk->bytes = buffer->data();
+    chunk->shared = buffer;
+    return chunk;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a chunk to the pool. The caches are bounded, so a burst towards
+/// a slow client does not pin its peak memory forever
+void Slab_pool::release(Output_chunk* chunk) {
+    if (chunk->shared != nullptr) {
+        chunk->shared->release();
+        chunk->shared = nullptr;
+        if (_free_shared_count < SLAB_POOL_MAX_FREE) {
+            chunk->next = _free_shared;
+            _free_shared = chunk;
+            _free_shared_count++;
+        } else {
+            delete chunk;
+        }
+    } else if (_free_count < SLAB_POOL_MAX_FREE) {
+        chunk->next = _free_list;
+        _free_list = chunk;
+        _free_count++;
+    } else {
+        delete static_cast<Output_slab*>(chunk);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Output_buffer::Output_buffer(Slab_pool& pool) : _pool(pool) {
+    _head = nullptr;
+    _tail = nullptr;
+    _size = 0;
+    _target = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor, returns all chunks to the pool
+Output_buffer::~Output_buffer() {
+    while (_head != nullptr) {
+        Output_chunk* chunk = _head;
+        _head = chunk->next;
+        _pool.release(chunk);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Appends data to the end of the buffer
+void Output_buffer::append(const char* data, size_t length) {
+    if (_target != nullptr) {
+        _target->append(data, length);
+        return;
+    }
+
+    _size += length;
+    while (length > 0) {
+        if (_tail == nullptr || _tail->shared != nullptr || _tail->end == OUTPUT_SLAB_SIZE) {
+            _link(_pool.acquire());
+        }
+
+        Output_slab* slab = static_cast<Output_slab*>(_tail);
+        size_t chunk = OUTPUT_SLAB_SIZE - slab->end;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(slab->data + slab->end, data, chunk);
+        slab->end += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Appends the bytes of a shared buffer by reference
+void Output_buffer::append_shared(Shared_buffer* buffer) {
+    if (buffer->size() == 0) {
+        return;
+    }
+    _link(_pool.acquire_shared(buffer));
+    _size += buffer->size();
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if the buffer holds no data
+bool Output_buffer::empty() const {
+    return _size == 0;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the number of pending bytes
+size_t Output_buffer::size() const {
+    return _size;
+}
+
+//-----------------------------------------------------------------------------
+/// Sends as much pending data as the socket accepts
+bool Output_buffer::send_to(SOCKET socket) {
+    while (_size > 0) {
+        // Gather the pending chunks into a single send call
+        WSABUF buffers[OUTPUT_MAX_SEND_CHUNKS];
+        DWORD buffer_count = 0;
+        size_t gathered = 0;
+        for (Output_chunk* chunk = _head; chunk != nullptr && buffer_count < OUTPUT_MAX_SEND_CHUNKS; chunk = chunk->next) {
+            buffers[buffer_count].buf = const_cast<char*>(chunk->bytes + chunk->begin);
+            buffers[buffer_count].len = (ULONG)(chunk->end - chunk->begin);
+            gathered += chunk->end - chunk->begin;
+            buffer_count++;
+        }
+
+        DWORD bytes_written = 0;
+        if (WSASend(socket, buffers, buffer_count, &bytes_written, 0, NULL, NULL) == SOCKET_ERROR) {
+            // A full socket buffer is not an error, the rest is sent once
+            // the socket becomes writable again
+            return WSAGetLastError() == WSAEWOULDBLOCK;
+        }
+
+        // Only advance over what the socket actually accepted
+        consume(bytes_written);
+        if (bytes_written < gathered) {
+            return true;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Drops the first bytes of the buffer, after they have been sent
+void Output_buffer::consume(size_t length) {
+    _size -= length;
+    while (length > 0) {
+        size_t available = _head->end - _head->begin;
+        if (length < available) {
+            _head->begin += length;
+            return;
+        }
+        length -= available;
+
+        Output_chunk* chunk = _head;
+        _head = chunk->next;
+        if (_head == nullptr) {
+            _tail = nullptr;
+        }
+        _pool.release(chunk);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Moves all data of another buffer to the end of this one. Both buffers
+/// take their chunks from the same pool
+void Output_buffer::splice(Output_buffer& other) {
+    if (other._head == nullptr) {
+        return;
+    }
+
+    if (_tail == nullptr) {
+        _head = other._head;
+    } else {
+        _tail->next = other._head;
+    }
+    _tail = other._tail;
+    _size += other._size;
+
+    other._head = nullptr;
+    other._tail = nullptr;
+    other._size = 0;
+}
+
+//-----------------------------------------------------------------------------
+/// Appends all further data to a string instead of queueing it, until
+/// called with nullptr
+void Output_buffer::redirect(std::string* target) {
+    _target = target;
+}
+
+//-----------------------------------------------------------------------------
+/// Adds a chunk at the end of the buffer
+void Output_buffer::_link(Output_chunk* chunk) {
+    if (_tail == nullptr) {
+        _head = chunk;
+    } else {
+        _tail->next = chunk;
+    }
+    _tail = chunk;
+}
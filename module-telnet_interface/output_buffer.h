@@ -0,0 +1,183 @@
+/*
+* Filenme: output_buffer.h
+* Purpose: Defines the Output_buffer class, a chunked queue of data waiting
+*          to be sent to a client, the Slab_pool recycling its chunks and
+*          the Shared_buffer holding data queued for several clients
+*/
+#ifndef _OUTPUT_BUFFER_H_
+#define _OUTPUT_BUFFER_H_
+
+#include <WinSock2.h>
+#include <cstddef>
+#include <string>
+
+/// Size of a single output slab
+const size_t OUTPUT_SLAB_SIZE = 4096;
+
+/// Immutable bytes shared by the output of several sessions, such as a
+/// notification encoded once for all its subscribers. Freed when the last
+/// reference is released. References are only taken and released on the
+/// interface thread, so the count is not atomic
+class Shared_buffer {
+public:
+    /// Creates an empty buffer with a single reference and room for the
+    /// given number of bytes
+    static Shared_buffer* create(size_t capacity);
+
+    /// Returns the string holding the bytes, to fill a buffer just created.
+    /// The bytes must not change once the buffer is shared
+    std::string& get_bytes();
+
+    /// Adds a reference
+    void add_reference();
+
+    /// Drops a reference, freeing the buffer with the last one
+    void release();
+
+    /// Returns the bytes of the buffer
+    const char* data() const;
+
+    /// Returns the number of bytes
+    size_t size() const;
+
+private:
+    /// Constructor, use create
+    Shared_buffer();
+
+    // Buffers are shared by reference and never copied
+    Shared_buffer(const Shared_buffer&);
+    Shared_buffer& operator=(const Shared_buffer&);
+
+private: // Private members
+
+    /// Number of references
+    unsigned int _references;
+
+    /// The bytes
+    std::string _data;
+};
+
+/// A piece of queued output. Bytes in [begin, end) of bytes are pending.
+/// A chunk either is an Output_slab holding its own bytes or references a
+/// Shared_buffer
+struct Output_chunk {
+    Output_chunk* next;
+    size_t begin;
+    size_t end;
+
+    /// Start of the chunk's bytes
+    const char* bytes;
+
+    /// Buffer referenced by the chunk, nullptr for slabs
+    Shared_buffer* shared;
+};
+
+/// A fixed-size block of output data
+struct Output_slab : Output_chunk {
+    char data[OUTPUT_SLAB_SIZE];
+};
+
+class Slab_pool {
+public:
+    /// Constructor
+    Slab_pool();
+
+    /// Destructor, frees all cached chunks
+    ~Slab_pool();
+
+    /// Returns an empty slab, reusing a cached one when available
+    Output_slab* acquire();
+
+    /// Returns a chunk referencing all bytes of a shared buffer, taking a
+    /// reference to it
+    Output_chunk* acquire_shared(Shared_buffer* buffer);
+
+    /// Returns a chunk to the pool, releasing its shared buffer if any
+    void release(Output_chunk* chunk);
+
+private:
+    // The pool owns its chunks and is not copied
+    Slab_pool(const Slab_pool&);
+    Slab_pool& operator=(const Slab_pool&);
+
+private: // Private members
+
+    /// Singly linked list of cached slabs
+    Output_chunk* _free_list;
+
+    /// Number of cached slabs
+    size_t _free_count;
+
+    /// Singly linked list of cached chunks for shared buffers
+    Output_chunk* _free_shared;
+
+    /// Number of cached chunks for shared buffers
+    size_t _free_shared_count;
+};
+
+class Output_buffer {
+public:
+    /// Constructor, slabs are taken from and returned to the given pool
+    Output_buffer(Slab_pool& pool);
+
+    /// Destructor, returns all slabs to the pool
+    ~Output_buffer();
+
+    /// Appends data to the end of the buffer
+    void append(const char* data, size_t length);
+
+    /// Appends the bytes of a shared buffer by reference, without copying
+    /// them. The buffer is released once its bytes have been sent
+    void append_shared(Shared_buffer* buffer);
+
+    /// Determines if the buffer holds no data
+    bool empty() const;
+
+    /// Returns the number of pending bytes
+    size_t size() const;
+
+    /// Sends as much pending data as the socket accepts, straight from the
+    /// slabs and shared buffers. Returns false if the connection failed
+    bool send_to(SOCKET socket);
+
+    /// Drops the first bytes of the buffer, after they have been sent
+    void consume(size_t length);
+
+    /// Moves all data of another buffer to the end of this one, handing
+    /// over its chunks without copying them. The other buffer is left empty
+    void splice(Output_buffer& other);
+
+    /// Appends all further data to the end of a string instead of queueing
+    /// it, until called with nullptr. Lets responses be encoded straight
+    /// into a Shared_buffer
+    void redirect(std::string* target);
+
+private:
+    /// Adds a chunk at the end of the buffer
+    void _link(Output_chunk* chunk);
+
+private:
+    // The buffer owns its chunks and is not copied
+    Output_buffer(const Output_buffer&);
+    Output_buffer& operator=(const Output_buffer&);
+
+private: // Private members
+
+    /// Pool providing the chunks
+    Slab_pool& _pool;
+
+    /// First chunk, holding the oldest data
+    Output_chunk* _head;
+
+    /// Last chunk. Appended data is copied into it if it is a slab with
+    /// room left
+    Output_chunk* _tail;
+
+    /// Number of pending bytes
+    size_t _size;
+
+    /// String receiving appended data, nullptr to queue it
+    std::string* _target;
+};
+
+#endif // _OUTPUT_BUFFER_H_
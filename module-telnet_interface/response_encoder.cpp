@@ -0,0 +1,708 @@
+/*
+* Filenme: response_encoder.cpp
+* Purpose: Implements the Response_encoder classes functions and members
+*/
+#include "response_encoder.h"
+#include "varint.h"
+
+#include <cstring>
+
+//-----------------------------------------------------------------------------
+/// Appends a NUL terminated string to the output
+static void append_string(Output_buffer& output, const char* text) {
+    output.append(text, strlen(text));
+}
+
+//-----------------------------------------------------------------------------
+/// Appends a number in decimal to the output
+static void append_number(Output_buffer& output, uint64 value) {
+    char digits[20];
+    size_t length = 0;
+    do {
+        digits[sizeof(digits) - ++length] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    output.append(digits + sizeof(digits) - length, length);
+}
+
+//-----------------------------------------------------------------------------
+/// Appends a text value the way command arguments are written: as is if it
+/// has no whitespace or quotes, otherwise in double quotes with quotes and
+/// backslashes escaped
+static void append_text_value(Output_buffer& output, const char* data, size_t length) {
+    bool quote = length == 0;
+    for (size_t i = 0; i < length && !quote; i++) {
+        unsigned char c = (unsigned char)data[i];
+        quote = c <= ' ' || c == '"' || c == '\\';
+    }
+    if (!quote) {
+        output.append(data, length);
+        return;
+    }
+
+    output.append("\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == '"' || data[i] == '\\') {
+            output.append(data + run, i - run);
+            output.append("\\", 1);
+            run = i;
+        }
+    }
+    output.append(data + run, length - run);
+    output.append("\"", 1);
+}
+
+//-----------------------------------------------------------------------------
+/// Appends text as a quoted JSON string. Runs of characters which need no
+/// escaping are appended at once
+static void append_json_string(Output_buffer& output, const char* data, size_t length) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+
+    output.append("\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        output.append(data + run, i - run);
+        run = i + 1;
+        switch (c) {
+        case '"':  output.append("\\\"", 2); break;
+        case '\\': output.append("\\\\", 2); break;
+        case '\n': output.append("\\n", 2); break;
+        case '\r': output.append("\\r", 2); break;
+        case '\t': output.append("\\t", 2); break;
+        default: {
+            char escaped[6] = { '\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf] };
+            output.append(escaped, sizeof(escaped));
+            break;
+        }
+        }
+    }
+    output.append(data + run, length - run);
+    output.append("\"", 1);
+}
+
+//-----------------------------------------------------------------------------
+/// Creates the encoder for a format
+Response_encoder* Response_encoder::create(Session_format format) {
+    switch (format) {
+    case SESSION_FORMAT_BINARY: return new Binary_encoder();
+    case SESSION_FORMAT_JSON:   return new Json_encoder();
+    default:                    return new Text_encoder();
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor
+Response_encoder::~Response_encoder() {
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a "<command> <status>" reply
+void Text_encoder::reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status) {
+    _begin_line(output, tag);
+    output.append(command, command_length);
+    output.append(" ", 1);
+    append_string(output, status);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the state of a tracked request as "<command> <status> <id>",
+/// followed by the reason if there is one
+void Text_encoder::request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason) {
+    _begin_line(output, tag);
+    output.append(command, command_length);
+    output.append(" ", 1);
+    append_string(output, status);
+    output.append(" ", 1);
+    append_number(output, request_id);
+    if (reason != nullptr) {
+        output.append(" ", 1);
+        append_string(output, reason);
+    }
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a line of informational or error text
+void Text_encoder::text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length) {
+    _begin_line(output, tag);
+    output.append(text, text_length);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a list with a "<command> <header>" line
+void Text_encoder::begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* header) {
+    _begin_line(output, tag);
+    output.append(command, command_length);
+    output.append(" ", 1);
+    append_string(output, header);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes an entry as "[*] <id>: <name>", without the mark for lists which
+/// have no selection
+void Text_encoder::list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length) {
+    if (mark == LIST_MARK_SELECTED) {
+        output.append("[*] ", 4);
+    } else if (mark == LIST_MARK_UNSELECTED) {
+        output.append("[ ] ", 4);
+    }
+    append_number(output, id);
+    output.append(": ", 2);
+    output.append(name, name_length);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a record as "[*] <id>:", followed by its fields
+void Text_encoder::begin_record(Output_buffer& output, List_mark mark, uint64 id) {
+    if (mark == LIST_MARK_SELECTED) {
+        output.append("[*] ", 4);
+    } else if (mark == LIST_MARK_UNSELECTED) {
+        output.append("[ ] ", 4);
+    }
+    append_number(output, id);
+    output.append(":", 1);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a text field as " <key>=<value>"
+void Text_encoder::record_string(Output_buffer& output, const char* key, size_t key_length, const char* value, size_t value_length) {
+    output.append(" ", 1);
+    output.append(key, key_length);
+    output.append("=", 1);
+    append_text_value(output, value, value_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a numeric field as " <key>=<value>"
+void Text_encoder::record_number(Output_buffer& output, const char* key, size_t key_length, uint64 value) {
+    output.append(" ", 1);
+    output.append(key, key_length);
+    output.append("=", 1);
+    append_number(output, value);
+}
+
+//-----------------------------------------------------------------------------
+/// Ends the line of a record
+void Text_encoder::end_record(Output_buffer& output) {
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Ends a list with an empty line, preceded by "cursor=<id>" if the list
+/// was cut short and "version=<n>" if it has a version, ready to be passed
+/// to the next command
+void Text_encoder::end_list(Output_buffer& output, uint64 cursor, uint64 version) {
+    if (cursor != 0) {
+        output.append("cursor=", 7);
+        append_number(output, cursor);
+        output.append("\r\n", 2);
+    }
+    if (version != 0) {
+        output.append("version=", 8);
+        append_number(output, version);
+        output.append("\r\n", 2);
+    }
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a change of the state of a server connection, a single line
+/// ending in the sequence number
+void Text_encoder::server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state) {
+    output.append(">ts3.info Server ", 17);
+    append_number(output, server_connection_id);
+    output.append(" ", 1);
+    append_string(output, state);
+    output.append(" seq=", 5);
+    append_number(output, seq);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a received message, the headers on indented lines followed by
+/// the message itself
+void Text_encoder::message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message) {
+    output.append(">", 1);
+    append_string(output, event);
+    output.append("\r\n\tSeq: ", 8);
+    append_number(output, seq);
+    output.append("\r\n\tServer: ", 11);
+    append_number(output, server_connection_id);
+    output.append("\r\n\tFrom: ", 9);
+    output.append(from_name.c_str(), from_name.length());
+    output.append(" [", 2);
+    append_number(output, from_id);
+    output.append("]\r\n", 3);
+    output.append(message.c_str(), message.length());
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a client starting or stopping to talk, kept to a single line
+/// ending in the sequence number as these are frequent
+void Text_encoder::talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp) {
+    output.append(">ts3.talk ", 10);
+    append_number(output, server_connection_id);
+    output.append(" ", 1);
+    append_number(output, client_id);
+    output.append(talking ? " 1 " : " 0 ", 3);
+    output.append(whisper ? "1 " : "0 ", 2);
+    append_number(output, timestamp);
+    output.append(" seq=", 5);
+    append_number(output, seq);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the state of a client or channel after a window of changes, as a
+/// single line of fields like a list record
+void Text_encoder::update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed) {
+    output.append(">ts3.update ", 12);
+    append_number(output, server_connection_id);
+    output.append(is_client ? " client " : " channel ", is_client ? 8 : 9);
+    append_number(output, id);
+    if (removed) {
+        output.append(" removed", 8);
+    } else {
+        output.append(" changed ", 9);
+        output.append(is_client ? "channel=" : "parent=", is_client ? 8 : 7);
+        append_number(output, parent_id);
+        output.append(" name=", 6);
+        append_text_value(output, name.c_str(), name.length());
+    }
+    output.append(" absorbed=", 10);
+    append_number(output, absorbed);
+    output.append(" seq=", 5);
+    append_number(output, seq);
+    output.append("\r\n", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a response line, writing the prompt and the tag
+void Text_encoder::_begin_line(Output_buffer& output, const std::string& tag) {
+    output.append(">", 1);
+    if (!tag.empty()) {
+        output.append(tag.c_str(), tag.length());
+        output.append(" ", 1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a reply frame
+void Binary_encoder::reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status) {
+    _begin_frame(BINARY_FRAME_REPLY);
+    _put_string(tag.c_str(), tag.length());
+    _put_string(command, command_length);
+    _put_string(status, strlen(status));
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a request status frame, with an empty reason if there is none
+void Binary_encoder::request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason) {
+    _begin_frame(BINARY_FRAME_REQUEST_STATUS);
+    _put_string(tag.c_str(), tag.length());
+    _put_string(command, command_length);
+    _put_string(status, strlen(status));
+    _put_number(request_id);
+    _put_string(reason, reason != nullptr ? strlen(reason) : 0);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a text frame
+void Binary_encoder::text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length) {
+    _begin_frame(BINARY_FRAME_TEXT);
+    _put_string(tag.c_str(), tag.length());
+    _put_string(text, text_length);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a list start frame. The header is meant for human readers and is
+/// left out
+void Binary_encoder::begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* /* header */) {
+    _begin_frame(BINARY_FRAME_LIST_BEGIN);
+    _put_string(tag.c_str(), tag.length());
+    _put_string(command, command_length);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a list entry frame
+void Binary_encoder::list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length) {
+    _begin_frame(BINARY_FRAME_LIST_ENTRY);
+    _put_number(mark);
+    _put_number(id);
+    _put_string(name, name_length);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a list record frame, which is written once the record ends
+void Binary_encoder::begin_record(Output_buffer& /* output */, List_mark mark, uint64 id) {
+    _begin_frame(BINARY_FRAME_LIST_RECORD);
+    _put_number(mark);
+    _put_number(id);
+}
+
+//-----------------------------------------------------------------------------
+/// Adds the key and text value of a field to the record frame
+void Binary_encoder::record_string(Output_buffer& /* output */, const char* key, size_t key_length, const char* value, size_t value_length) {
+    _put_string(key, key_length);
+    _put_string(value, value_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Adds the key and numeric value of a field to the record frame
+void Binary_encoder::record_number(Output_buffer& /* output */, const char* key, size_t key_length, uint64 value) {
+    _put_string(key, key_length);
+    _put_number(value);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the record frame
+void Binary_encoder::end_record(Output_buffer& output) {
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a list end frame
+void Binary_encoder::end_list(Output_buffer& output, uint64 cursor, uint64 version) {
+    _begin_frame(BINARY_FRAME_LIST_END);
+    _put_number(cursor);
+    _put_number(version);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a server event frame
+void Binary_encoder::server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state) {
+    _begin_frame(BINARY_FRAME_SERVER_EVENT);
+    _put_number(server_connection_id);
+    _put_string(state, strlen(state));
+    _put_number(seq);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a message event frame
+void Binary_encoder::message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message) {
+    _begin_frame(BINARY_FRAME_MESSAGE_EVENT);
+    _put_string(event, strlen(event));
+    _put_number(server_connection_id);
+    _put_number(from_id);
+    _put_string(from_name.c_str(), from_name.length());
+    _put_string(message.c_str(), message.length());
+    _put_number(seq);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a talk event frame
+void Binary_encoder::talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp) {
+    _begin_frame(BINARY_FRAME_TALK_EVENT);
+    _put_number(server_connection_id);
+    _put_number(client_id);
+    _put_number(talking ? 1 : 0);
+    _put_number(whisper ? 1 : 0);
+    _put_number(timestamp);
+    _put_number(seq);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes an update event frame
+void Binary_encoder::update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed) {
+    _begin_frame(BINARY_FRAME_UPDATE_EVENT);
+    _put_number(server_connection_id);
+    _put_string(is_client ? "client" : "channel", is_client ? 6 : 7);
+    _put_number(id);
+    _put_number(removed ? 1 : 0);
+    _put_number(parent_id);
+    _put_string(name.c_str(), name.length());
+    _put_number(absorbed);
+    _put_number(seq);
+    _end_frame(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a frame of the given type
+void Binary_encoder::_begin_frame(Binary_frame_type type) {
+    _frame.clear();
+    _put_number(type);
+}
+
+//-----------------------------------------------------------------------------
+/// Adds a number to the current frame
+void Binary_encoder::_put_number(uint64 value) {
+    char buffer[VARINT_MAX_LENGTH];
+    _frame.append(buffer, encode_varint(value << 1, buffer));
+}
+
+//-----------------------------------------------------------------------------
+/// Adds text to the current frame
+void Binary_encoder::_put_string(const char* data, size_t length) {
+    char buffer[VARINT_MAX_LENGTH];
+    _frame.append(buffer, encode_varint(((uint64)length << 1) | 1, buffer));
+    _frame.append(data, length);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the current frame, prefixed with its length
+void Binary_encoder::_end_frame(Output_buffer& output) {
+    char buffer[VARINT_MAX_LENGTH];
+    output.append(buffer, encode_varint(_frame.length(), buffer));
+    output.append(_frame.data(), _frame.length());
+}
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Json_encoder::Json_encoder() {
+    _first_member = true;
+    _first_entry = true;
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a reply object. Statuses like "fail. <reason>" are split into the
+/// status and the reason
+void Json_encoder::reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status) {
+    _begin_object(output, tag);
+    _put_string(output, "command", command, command_length);
+    const char* reason = strstr(status, ". ");
+    if (reason != nullptr) {
+        _put_string(output, "status", status, reason - status);
+        _put_string(output, "reason", reason + 2, strlen(reason + 2));
+    } else {
+        _put_string(output, "status", status, strlen(status));
+    }
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a request status object
+void Json_encoder::request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason) {
+    _begin_object(output, tag);
+    _put_string(output, "command", command, command_length);
+    _put_string(output, "status", status, strlen(status));
+    _put_number(output, "request", request_id);
+    if (reason != nullptr) {
+        _put_string(output, "reason", reason, strlen(reason));
+    }
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a text object
+void Json_encoder::text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length) {
+    _begin_object(output, tag);
+    _put_string(output, "text", text, text_length);
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Opens a list object. The header is meant for human readers and is left
+/// out
+void Json_encoder::begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* /* header */) {
+    _begin_object(output, tag);
+    _put_string(output, "command", command, command_length);
+    _put_string(output, "status", "ok", 2);
+    _put_key(output, "entries");
+    output.append("[", 1);
+    _first_entry = true;
+}
+
+//-----------------------------------------------------------------------------
+/// Writes an entry object into the entries array. Lists without selection
+/// leave out the "selected" member
+void Json_encoder::list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length) {
+    if (!_first_entry) {
+        output.append(",", 1);
+    }
+    _first_entry = false;
+
+    output.append("{", 1);
+    _first_member = true;
+    _put_number(output, "id", id);
+    _put_string(output, "name", name, name_length);
+    if (mark != LIST_MARK_NONE) {
+        _put_key(output, "selected");
+        if (mark == LIST_MARK_SELECTED) {
+            output.append("true", 4);
+        } else {
+            output.append("false", 5);
+        }
+    }
+    output.append("}", 1);
+}
+
+//-----------------------------------------------------------------------------
+/// Opens a record object in the entries array, holding the ID and the
+/// selection like plain entries
+void Json_encoder::begin_record(Output_buffer& output, List_mark mark, uint64 id) {
+    if (!_first_entry) {
+        output.append(",", 1);
+    }
+    _first_entry = false;
+
+    output.append("{", 1);
+    _first_member = true;
+    _put_number(output, "id", id);
+    if (mark != LIST_MARK_NONE) {
+        _put_key(output, "selected");
+        if (mark == LIST_MARK_SELECTED) {
+            output.append("true", 4);
+        } else {
+            output.append("false", 5);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a text field as a member of the record object
+void Json_encoder::record_string(Output_buffer& output, const char* key, size_t key_length, const char* value, size_t value_length) {
+    _put_key(output, key, key_length);
+    append_json_string(output, value, value_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a numeric field as a member of the record object
+void Json_encoder::record_number(Output_buffer& output, const char* key, size_t key_length, uint64 value) {
+    _put_key(output, key, key_length);
+    append_number(output, value);
+}
+
+//-----------------------------------------------------------------------------
+/// Closes the record object
+void Json_encoder::end_record(Output_buffer& output) {
+    output.append("}", 1);
+}
+
+//-----------------------------------------------------------------------------
+/// Closes the entries array and the list object, adding the cursor and
+/// the version if there are
+void Json_encoder::end_list(Output_buffer& output, uint64 cursor, uint64 version) {
+    output.append("]", 1);
+    if (cursor != 0) {
+        _put_number(output, "cursor", cursor);
+    }
+    if (version != 0) {
+        _put_number(output, "version", version);
+    }
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a server event object
+void Json_encoder::server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state) {
+    _begin_object(output, std::string());
+    _put_string(output, "event", "ts3.info", 8);
+    _put_number(output, "seq", seq);
+    _put_number(output, "server", server_connection_id);
+    _put_string(output, "state", state, strlen(state));
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a message event object
+void Json_encoder::message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message) {
+    _begin_object(output, std::string());
+    _put_string(output, "event", event, strlen(event));
+    _put_number(output, "seq", seq);
+    _put_number(output, "server", server_connection_id);
+    _put_number(output, "from", from_id);
+    _put_string(output, "from_name", from_name.c_str(), from_name.length());
+    _put_string(output, "message", message.c_str(), message.length());
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a talk event object
+void Json_encoder::talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp) {
+    _begin_object(output, std::string());
+    _put_string(output, "event", "ts3.talk", 8);
+    _put_number(output, "seq", seq);
+    _put_number(output, "server", server_connection_id);
+    _put_number(output, "client", client_id);
+    _put_number(output, "talking", talking ? 1 : 0);
+    _put_number(output, "whisper", whisper ? 1 : 0);
+    _put_number(output, "time", timestamp);
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes an update event object. Removed entities have no parent and name
+void Json_encoder::update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed) {
+    _begin_object(output, std::string());
+    _put_string(output, "event", "ts3.update", 10);
+    _put_number(output, "seq", seq);
+    _put_number(output, "server", server_connection_id);
+    _put_string(output, "entity", is_client ? "client" : "channel", is_client ? 6 : 7);
+    _put_number(output, "id", id);
+    _put_string(output, "state", removed ? "removed" : "changed", 7);
+    if (!removed) {
+        _put_number(output, is_client ? "channel" : "parent", parent_id);
+        _put_string(output, "name", name.c_str(), name.length());
+    }
+    _put_number(output, "absorbed", absorbed);
+    _end_object(output);
+}
+
+//-----------------------------------------------------------------------------
+/// Opens an object, with the tag member if there is a tag
+void Json_encoder::_begin_object(Output_buffer& output, const std::string& tag) {
+    output.append("{", 1);
+    _first_member = true;
+    if (!tag.empty()) {
+        _put_string(output, "tag", tag.c_str(), tag.length());
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a member holding a string
+void Json_encoder::_put_string(Output_buffer& output, const char* key, const char* value, size_t value_length) {
+    _put_key(output, key);
+    append_json_string(output, value, value_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a member holding a number
+void Json_encoder::_put_number(Output_buffer& output, const char* key, uint64 value) {
+    _put_key(output, key);
+    append_number(output, value);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the name of a member. Keys are plain identifiers and need no
+/// escaping
+void Json_encoder::_put_key(Output_buffer& output, const char* key) {
+    _put_key(output, key, strlen(key));
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the name of a member given with its length
+void Json_encoder::_put_key(Output_buffer& output, const char* key, size_t key_length) {
+    if (!_first_member) {
+        output.append(",", 1);
+    }
+    _first_member = false;
+    output.append("\"", 1);
+    output.append(key, key_length);
+    output.append("\":", 2);
+}
+
+//-----------------------------------------------------------------------------
+/// Closes an object and ends the line
+void Json_encoder::_end_object(Output_buffer& output) {
+    output.append("}\r\n", 3);
+}
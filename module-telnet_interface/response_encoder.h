@@ -0,0 +1,248 @@
+/*
+* Filenme: response_encoder.h
+* Purpose: Defines the Response_encoder class and its implementations, which
+*          write responses and notifications in the format of a session
+*/
+#ifndef _RESPONSE_ENCODER_H_
+#define _RESPONSE_ENCODER_H_
+
+#include <string>
+
+#include "teamspeak/public_definitions.h"
+#include "output_buffer.h"
+
+/// Formats a session can exchange data in
+enum Session_format {
+    SESSION_FORMAT_TEXT,    // Human readable lines, the default
+    SESSION_FORMAT_BINARY,  // Length prefixed frames, see Binary_encoder
+    SESSION_FORMAT_JSON     // A JSON object per line, see Json_encoder
+};
+
+/// Number of Session_format values
+const size_t SESSION_FORMAT_COUNT = 3;
+
+/// Marks written in front of list entries
+enum List_mark {
+    LIST_MARK_NONE,         // The list has no selected entry
+    LIST_MARK_UNSELECTED,   // The entry is not selected
+    LIST_MARK_SELECTED      // The entry is selected by the session
+};
+
+/// Writes the responses of the command handlers and the notifications in
+/// the format of a session, so handlers don't depend on the format. Every
+/// response starts with the tag of the command it answers, which is empty
+/// if the command had none
+class Response_encoder {
+public:
+    /// Creates the encoder for a format
+    static Response_encoder* create(Session_format format);
+
+    /// Destructor
+    virtual ~Response_encoder();
+
+    /// Writes a "<command> <status>" reply
+    virtual void reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status) = 0;
+
+    /// Writes the state of a tracked request: "ok" when it was sent, "done"
+    /// or "failed" once the server answered. The reason is only given for
+    /// failed requests, and may be nullptr otherwise
+    virtual void request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason) = 0;
+
+    /// Writes a line of informational or error text
+    virtual void text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length) = 0;
+
+    /// Starts a list answering a command. The header describes the list to
+    /// human readers
+    virtual void begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* header) = 0;
+
+    /// Writes an entry of the current list
+    virtual void list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length) = 0;
+
+    /// Starts an entry of the current list made of named fields instead of
+    /// a name, for lists projected to the fields a client asked for
+    virtual void begin_record(Output_buffer& output, List_mark mark, uint64 id) = 0;
+
+    /// Writes a text field of the current record
+    virtual void record_string(Output_buffer& output, const char* key, size_t key_length, const char* value, size_t value_length) = 0;
+
+    /// Writes a numeric field of the current record
+    virtual void record_number(Output_buffer& output, const char* key, size_t key_length, uint64 value) = 0;
+
+    /// Ends the current record
+    virtual void end_record(Output_buffer& output) = 0;
+
+    /// Ends the current list. A cursor other than 0 is the ID to continue
+    /// after, for lists cut short by a limit. A version other than 0 is the
+    /// state version the list reflects, for lists of mirrored state
+    virtual void end_list(Output_buffer& output, uint64 cursor, uint64 version) = 0;
+
+    /// Writes a change of the state of a server connection. The sequence
+    /// number identifies the notification for ts3.events.resume
+    virtual void server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state) = 0;
+
+    /// Writes a received message
+    virtual void message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message) = 0;
+
+    /// Writes a client starting or stopping to talk. The whisper flag is
+    /// set for whispers to us, the timestamp is a monotonic time in
+    /// microseconds. Talk events are not kept for replay, their sequence
+    /// number is 0
+    virtual void talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp) = 0;
+
+    /// Writes the state of a client or channel after a window of changes.
+    /// The parent is the channel of a client or the parent of a channel.
+    /// Removed entities have no parent and name. Absorbed is the number of
+    /// changes merged into this one. Updates are not kept for replay, their
+    /// sequence number is 0
+    virtual void update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed) = 0;
+};
+
+/// Writes the human readable format of the telnet interface, each response
+/// starting with ">" and ending with "\r\n". Record fields are written as
+/// key=value, quoting values like command arguments where needed. Before
+/// the blank line ending a list, "cursor=N" and "version=N" lines give the
+/// cursor and the state version. Messages give their sequence number on a
+/// "\tSeq: N" header line, all other notifications are a single line ending
+/// in a "seq=N" field: ">ts3.info Server <server> <state>", ">ts3.talk
+/// <server> <client> <0|1> <whisper 0|1> <timestamp>", and ">ts3.update
+/// <server> <client|channel> <id> <changed|removed>" with channel= or
+/// parent=, name= and absorbed= fields
+class Text_encoder : public Response_encoder {
+public:
+    virtual void reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status);
+    virtual void request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason);
+    virtual void text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length);
+    virtual void begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* header);
+    virtual void list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length);
+    virtual void begin_record(Output_buffer& output, List_mark mark, uint64 id);
+    virtual void record_string(Output_buffer& output, const char* key, size_t key_length, const char* value, size_t value_length);
+    virtual void record_number(Output_buffer& output, const char* key, size_t key_length, uint64 value);
+    virtual void end_record(Output_buffer& output);
+    virtual void end_list(Output_buffer& output, uint64 cursor, uint64 version);
+    virtual void server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state);
+    virtual void message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message);
+    virtual void talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp);
+    virtual void update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed);
+
+private:
+    /// Starts a response line, writing the prompt and the tag
+    void _begin_line(Output_buffer& output, const std::string& tag);
+};
+
+/// Kinds of frames written by the Binary_encoder
+enum Binary_frame_type {
+    BINARY_FRAME_REPLY = 1,         // tag, command, status
+    BINARY_FRAME_REQUEST_STATUS,    // tag, command, status, request ID, reason
+    BINARY_FRAME_TEXT,              // tag, text
+    BINARY_FRAME_LIST_BEGIN,        // tag, command
+    BINARY_FRAME_LIST_ENTRY,        // mark, ID, name
+    BINARY_FRAME_LIST_END,          // cursor, 0 if the list is complete, version, 0 if none
+    BINARY_FRAME_SERVER_EVENT,      // server connection ID, state, sequence number
+    BINARY_FRAME_MESSAGE_EVENT,     // event, server connection ID, sender ID, sender name, message, sequence number
+    BINARY_FRAME_LIST_RECORD,       // mark, ID, then a key and a value per field
+    BINARY_FRAME_TALK_EVENT,        // server connection ID, client ID, talking, whisper, timestamp, sequence number
+    BINARY_FRAME_UPDATE_EVENT       // server connection ID, "client" or "channel", ID, removed, parent, name, absorbed, sequence number
+};
+
+/// Writes length prefixed frames. A frame is a varint holding the length of
+/// its body, followed by the body. The body is a sequence of values, each
+/// starting with a varint v: if v is even, the value is the number v / 2;
+/// if v is odd, v / 2 bytes of UTF-8 text follow, so numbers are limited to
+/// 63 bits. The first value of every frame is its Binary_frame_type. Clients
+/// send commands the same way, as frames holding the command and its
+/// arguments
+class Binary_encoder : public Response_encoder {
+public:
+    virtual void reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status);
+    virtual void request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason);
+    virtual void text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length);
+    virtual void begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* header);
+    virtual void list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length);
+    virtual void begin_record(Output_buffer& output, List_mark mark, uint64 id);
+    virtual void record_string(Output_buffer& output, const char* key, size_t key_length, const char* value, size_t value_length);
+    virtual void record_number(Output_buffer& output, const char* key, size_t key_length, uint64 value);
+    virtual void end_record(Output_buffer& output);
+    virtual void end_list(Output_buffer& output, uint64 cursor, uint64 version);
+    virtual void server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state);
+    virtual void message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message);
+    virtual void talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp);
+    virtual void update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed);
+
+private:
+    /// Starts a frame of the given type
+    void _begin_frame(Binary_frame_type type);
+
+    /// Adds a number to the current frame
+    void _put_number(uint64 value);
+
+    /// Adds text to the current frame
+    void _put_string(const char* data, size_t length);
+
+    /// Writes the current frame, prefixed with its length
+    void _end_frame(Output_buffer& output);
+
+private: // Private members
+
+    /// Body of the frame being built. Kept to reuse its storage
+    std::string _frame;
+};
+
+/// Writes a JSON object per line, ended by "\r\n". Responses have the
+/// members "command" and "status", tracked requests add "request", failures
+/// add "reason", and lists hold their entries in an "entries" array, where
+/// records have their fields as members beside "id". Lists cut short have
+/// a "cursor" member, lists of mirrored state a "version" member.
+/// Notifications have an "event" member instead of "command" and their
+/// sequence number in a "seq" member. The "tag"
+/// member is present if the command had a tag. Objects are written straight
+/// into the output, escaping strings on the way
+class Json_encoder : public Response_encoder {
+public:
+    /// Constructor
+    Json_encoder();
+
+    virtual void reply(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status);
+    virtual void request_status(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason);
+    virtual void text(Output_buffer& output, const std::string& tag, const char* text, size_t text_length);
+    virtual void begin_list(Output_buffer& output, const std::string& tag, const char* command, size_t command_length, const char* header);
+    virtual void list_entry(Output_buffer& output, List_mark mark, uint64 id, const char* name, size_t name_length);
+    virtual void begin_record(Output_buffer& output, List_mark mark, uint64 id);
+    virtual void record_string(Output_buffer& output, const char* key, size_t key_length, const char* value, size_t value_length);
+    virtual void record_number(Output_buffer& output, const char* key, size_t key_length, uint64 value);
+    virtual void end_record(Output_buffer& output);
+    virtual void end_list(Output_buffer& output, uint64 cursor, uint64 version);
+    virtual void server_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, const char* state);
+    virtual void message_event(Output_buffer& output, uint64 seq, const char* event, uint64 server_connection_id, uint64 from_id, const std::string& from_name, const std::string& message);
+    virtual void talk_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, uint64 client_id, bool talking, bool whisper, uint64 timestamp);
+    virtual void update_event(Output_buffer& output, uint64 seq, uint64 server_connection_id, bool is_client, uint64 id, bool removed, uint64 parent_id, const std::string& name, unsigned int absorbed);
+
+private:
+    /// Opens an object, with the tag member if there is a tag
+    void _begin_object(Output_buffer& output, const std::string& tag);
+
+    /// Writes a member holding a string. The first member of an object is
+    /// written without a leading comma
+    void _put_string(Output_buffer& output, const char* key, const char* value, size_t value_length);
+
+    /// Writes a member holding a number
+    void _put_number(Output_buffer& output, const char* key, uint64 value);
+
+    /// Writes the name of a member
+    void _put_key(Output_buffer& output, const char* key);
+
+    /// Writes the name of a member given with its length
+    void _put_key(Output_buffer& output, const char* key, size_t key_length);
+
+    /// Closes an object and ends the line
+    void _end_object(Output_buffer& output);
+
+private: // Private members
+
+    /// Set while the current object or list entry has no members yet
+    bool _first_member;
+
+    /// Set while the current list has no entries yet
+    bool _first_entry;
+};
+
+#endif // _RESPONSE_ENCODER_H_
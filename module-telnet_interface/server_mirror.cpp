@@ -0,0 +1,471 @@
+/*
+* Filenme: server_mirror.cpp
+* Purpose: Implements the Server_mirror class functions and members
+*/
+#include "server_mirror.h"
+
+#include <algorithm>
+
+/// Returned for channels without subchannels
+static const std::vector<uint64> NO_CHILDREN;
+
+/// Version of the latest change to any mirror
+uint64 Server_mirror::_current_version = 0;
+
+//-----------------------------------------------------------------------------
+/// Constructor, creates an empty mirror
+Server_mirror::Server_mirror() :
+    _oldest_change(0),
+    _log_start(++_current_version) {
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor
+Server_mirror::~Server_mirror() {
+}
+
+//-----------------------------------------------------------------------------
+/// Applies a channel or client update
+void Server_mirror::apply(const Mirror_update& update) {
+    switch (update.type) {
+    case MIRROR_UPDATE_RESET:          clear(); break;
+    case MIRROR_UPDATE_CHANNEL:        _set_channel(update.id, update.parent_id, update.order, update.name); break;
+    case MIRROR_UPDATE_REMOVE_CHANNEL: _remove_channel(update.id); break;
+    case MIRROR_UPDATE_CLIENT:         _set_client((anyID)update.id, update.parent_id, update.name); break;
+    case MIRROR_UPDATE_REMOVE_CLIENT:  _remove_client((anyID)update.id); break;
+    case MIRROR_UPDATE_IDENTITY:       _set_identity((anyID)update.id, update.parent_id, update.name); break;
+    default:
+        // Server updates are handled by the owner of the mirror
+        break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Removes all channels and clients
+void Server_mirror::clear() {
+    _channels.clear();
+    _channel_index.clear();
+    _channel_ids.clear();
+    _clients.clear();
+    _client_index.clear();
+    _client_ids.clear();
+    _children.clear();
+    _nicknames.clear();
+    _identities.clear();
+
+    // Entries vanished without being logged
+    _changes.clear();
+    _oldest_change = 0;
+    _log_start = ++_current_version;
+    _names.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the version of the latest change to any mirror
+uint64 Server_mirror::get_current_version() {
+    return _current_version;
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a new version without a change to a mirror
+uint64 Server_mirror::advance_version() {
+    return ++_current_version;
+}
+
+//-----------------------------------------------------------------------------
+/// Appends the changes made after a version, oldest first
+bool Server_mirror::collect_changes(uint64 since, std::vector<Mirror_change>& changes) const {
+    if (since < _log_start) {
+        return false;
+    }
+
+    // Versions grow along the ring, so the changes to return are at its end
+    size_t count = _changes.size();
+    size_t skip = count;
+    while (skip > 0 && _changes[(_oldest_change + skip - 1) % count].version > since) {
+        skip--;
+    }
+    for (size_t i = skip; i < count; i++) {
+        changes.push_back(_changes[(_oldest_change + i) % count]);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns all channels
+const std::vector<Mirror_channel>& Server_mirror::get_channels() const {
+    return _channels;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns all clients
+const std::vector<Mirror_client>& Server_mirror::get_clients() const {
+    return _clients;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the IDs of all channels, sorted ascending
+const std::vector<uint64>& Server_mirror::get_channel_ids() const {
+    return _channel_ids;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the IDs of all clients, sorted ascending
+const std::vector<anyID>& Server_mirror::get_client_ids() const {
+    return _client_ids;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the channel with the given ID
+const Mirror_channel* Server_mirror::find_channel(uint64 channel_id) const {
+    std::unordered_map<uint64, size_t>::const_iterator it = _channel_index.find(channel_id);
+    if (it == _channel_index.end()) {
+        return nullptr;
+    }
+    return &_channels[it->second];
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the client with the given ID
+const Mirror_client* Server_mirror::find_client(anyID client_id) const {
+    std::unordered_map<anyID, size_t>::const_iterator it = _client_index.find(client_id);
+    if (it == _client_index.end()) {
+        return nullptr;
+    }
+    return &_clients[it->second];
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the index of the nicknames of the clients
+const Nickname_index& Server_mirror::get_nicknames() const {
+    return _nicknames;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the client using a unique identifier
+const Mirror_client* Server_mirror::find_client_by_uid(const std::string& uid) const {
+    std::unordered_map<std::string, Mirror_identity>::const_iterator it = _identities.find(uid);
+    if (it == _identities.end() || it->second.client_id == 0) {
+        return nullptr;
+    }
+    return find_client(it->second.client_id);
+}
+
+//-----------------------------------------------------------------------------
+/// Returns what is known about a unique identifier
+const Mirror_identity* Server_mirror::find_identity(const std::string& uid) const {
+    std::unordered_map<std::string, Mirror_identity>::const_iterator it = _identities.find(uid);
+    if (it == _identities.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the IDs of the subchannels of a channel
+const std::vector<uint64>& Server_mirror::get_children(uint64 channel_id) const {
+    std::unordered_map<uint64, std::vector<uint64> >::const_iterator it = _children.find(channel_id);
+    if (it == _children.end()) {
+        return NO_CHILDREN;
+    }
+    return it->second;
+}
+
+//-----------------------------------------------------------------------------
+/// Adds or updates a channel
+void Server_mirror::_set_channel(uint64 channel_id, uint64 parent_id, uint64 order, const std::string& name) {
+    std::unordered_map<uint64, size_t>::iterator it = _channel_index.find(channel_id);
+    if (it == _channel_index.end()) {
+        Mirror_channel channel;
+        channel.id = channel_id;
+        channel.parent_id = parent_id;
+        channel.order = order;
+        channel.name = _intern(name);
+
+        // Clients may have been seen in the channel before the channel
+        channel.client_count = 0;
+        for (size_t i = 0; i < _clients.size(); i++) {
+            if (_clients[i].channel_id == channel_id) {
+                channel.client_count++;
+            }
+        }
+
+        _channel_index[channel_id] = _channels.size();
+        _channels.push_back(channel);
+        _channel_ids.insert(std::lower_bound(_channel_ids.begin(), _channel_ids.end(), channel_id), channel_id);
+        _attach_channel(parent_id, channel_id);
+        _log_change(MIRROR_ENTITY_CHANNEL, MIRROR_CHANGE_ADDED, channel_id);
+    } else {
+        Mirror_channel& channel = _channels[it->second];
+        if (channel.parent_id != parent_id) {
+            _detach_channel(channel.parent_id, channel_id);
+            channel.parent_id = parent_id;
+            channel.order = order;
+            _attach_channel(parent_id, channel_id);
+        } else if (channel.order != order) {
+            channel.order = order;
+            _sort_children(_children[parent_id]);
+        }
+        if (*channel.name != name) {
+            _release(channel.name);
+            channel.name = _intern(name);
+        }
+        _log_change(MIRROR_ENTITY_CHANNEL, MIRROR_CHANGE_CHANGED, channel_id);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Removes a channel. The last channel takes its place, so the storage
+/// stays dense
+void Server_mirror::_remove_channel(uint64 channel_id) {
+    std::unordered_map<uint64, size_t>::iterator it = _channel_index.find(channel_id);
+    if (it == _channel_index.end()) {
+        return;
+    }
+
+    size_t index = it->second;
+    _channel_index.erase(it);
+    _channel_ids.erase(std::lower_bound(_channel_ids.begin(), _channel_ids.end(), channel_id));
+    _release(_channels[index].name);
+    _detach_channel(_channels[index].parent_id, channel_id);
+    _log_change(MIRROR_ENTITY_CHANNEL, MIRROR_CHANGE_REMOVED, channel_id);
+
+    if (index != _channels.size() - 1) {
+        _channels[index] = _channels.back();
+        _channel_index[_channels[index].id] = index;
+    }
+    _channels.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+/// Adds or updates a client
+void Server_mirror::_set_client(anyID client_id, uint64 channel_id, const std::string& name) {
+    std::unordered_map<anyID, size_t>::iterator it = _client_index.find(client_id);
+    if (it == _client_index.end()) {
+        Mirror_client client;
+        client.id = client_id;
+        client.channel_id = channel_id;
+        client.name = _intern(name);
+        client.uid = nullptr;
+        _client_index[client_id] = _clients.size();
+        _clients.push_back(client);
+        _client_ids.insert(std::lower_bound(_client_ids.begin(), _client_ids.end(), client_id), client_id);
+        _count_clients(channel_id, 1);
+        _nicknames.add(client_id, name);
+        _log_change(MIRROR_ENTITY_CLIENT, MIRROR_CHANGE_ADDED, client_id);
+    } else {
+        Mirror_client& client = _clients[it->second];
+        if (client.channel_id != channel_id) {
+            _count_clients(client.channel_id, -1);
+            _count_clients(channel_id, 1);
+        }
+        client.channel_id = channel_id;
+        if (*client.name != name) {
+            _release(client.name);
+            client.name = _intern(name);
+            _nicknames.remove(client_id);
+            _nicknames.add(client_id, name);
+        }
+
+        // Logged even if the mirrored fields are unchanged, as the update
+        // may carry changes of properties read from TeamSpeak
+        _log_change(MIRROR_ENTITY_CLIENT, MIRROR_CHANGE_CHANGED, client_id);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Removes a client. The last client takes its place, so the storage stays
+/// dense
+void Server_mirror::_remove_client(anyID client_id) {
+    std::unordered_map<anyID, size_t>::iterator it = _client_index.find(client_id);
+    if (it == _client_index.end()) {
+        return;
+    }
+
+    size_t index = it->second;
+    _client_index.erase(it);
+    _client_ids.erase(std::lower_bound(_client_ids.begin(), _client_ids.end(), client_id));
+    _release(_clients[index].name);
+    _count_clients(_clients[index].channel_id, -1);
+    _nicknames.remove(client_id);
+    _release_identity(_clients[index]);
+    _log_change(MIRROR_ENTITY_CLIENT, MIRROR_CHANGE_REMOVED, client_id);
+
+    if (index != _clients.size() - 1) {
+        _clients[index] = _clients.back();
+        _client_index[_clients[index].id] = index;
+    }
+    _clients.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+/// Records the client and database ID of a unique identifier
+void Server_mirror::_set_identity(anyID client_id, uint64 database_id, const std::string& uid) {
+    Mirror_identity unknown = { 0, 0, 0 };
+    std::unordered_map<std::string, Mirror_identity>::iterator it = _identities.insert(std::make_pair(uid, unknown)).first;
+    if (database_id != 0) {
+        it->second.database_id = database_id;
+    }
+    if (client_id == 0) {
+        return;
+    }
+
+    std::unordered_map<anyID, size_t>::iterator client = _client_index.find(client_id);
+    if (client == _client_index.end()) {
+        // Only clients in the mirror are tracked, so leaving clients can
+        // release their identifier
+        if (it->second.client_count == 0 && it->second.database_id == 0) {
+            _identities.erase(it);
+        }
+        return;
+    }
+
+    Mirror_client& mirrored = _clients[client->second];
+    if (mirrored.uid != &it->first) {
+        _release_identity(mirrored);
+        mirrored.uid = &it->first;
+        it->second.client_count++;
+    }
+    it->second.client_id = client_id;
+}
+
+//-----------------------------------------------------------------------------
+/// Detaches a leaving client from its unique identifier
+void Server_mirror::_release_identity(const Mirror_client& client) {
+    if (client.uid == nullptr) {
+        return;
+    }
+
+    std::unordered_map<std::string, Mirror_identity>::iterator it = _identities.find(*client.uid);
+    Mirror_identity& identity = it->second;
+    identity.client_count--;
+    if (identity.client_id == client.id) {
+        // Hand the identifier to another connection of the same identity
+        identity.client_id = 0;
+        for (size_t i = 0; identity.client_count > 0 && i < _clients.size(); i++) {
+            if (_clients[i].uid == client.uid && _clients[i].id != client.id) {
+                identity.client_id = _clients[i].id;
+                break;
+            }
+        }
+    }
+    if (identity.client_count == 0 && identity.database_id == 0) {
+        _identities.erase(it);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Records a change under a new version. Once the log is full, the oldest
+/// change is dropped and changes from before it can no longer be followed
+void Server_mirror::_log_change(Mirror_entity entity, Mirror_change_type type, uint64 id) {
+    Mirror_change change;
+    change.version = ++_current_version;
+    change.entity = entity;
+    change.type = type;
+    change.id = id;
+
+    if (_changes.size() < MIRROR_CHANGE_LOG_SIZE) {
+        _changes.push_back(change);
+        return;
+    }
+    _log_start = _changes[_oldest_change].version;
+    _changes[_oldest_change] = change;
+    _oldest_change = (_oldest_change + 1) % MIRROR_CHANGE_LOG_SIZE;
+}
+
+//-----------------------------------------------------------------------------
+/// Adds a channel to the subchannels of its parent
+void Server_mirror::_attach_channel(uint64 parent_id, uint64 channel_id) {
+    std::vector<uint64>& children = _children[parent_id];
+    children.push_back(channel_id);
+    _sort_children(children);
+}
+
+//-----------------------------------------------------------------------------
+/// Removes a channel from the subchannels of its parent
+void Server_mirror::_detach_channel(uint64 parent_id, uint64 channel_id) {
+    std::unordered_map<uint64, std::vector<uint64> >::iterator it = _children.find(parent_id);
+    if (it == _children.end()) {
+        return;
+    }
+
+    std::vector<uint64>& children = it->second;
+    for (size_t i = 0; i < children.size(); i++) {
+        if (children[i] == channel_id) {
+            children.erase(children.begin() + i);
+            break;
+        }
+    }
+    if (children.empty()) {
+        _children.erase(it);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Sorts subchannels by following their order links, each channel naming
+/// the sibling above it. While updates are still arriving the links may
+/// be incomplete; chains whose head is unknown follow in their previous
+/// order, so the result settles once all siblings are known
+void Server_mirror::_sort_children(std::vector<uint64>& children) {
+    if (children.size() < 2) {
+        return;
+    }
+
+    _order_scratch.clear();
+    for (size_t i = 0; i < children.size(); i++) {
+        const Mirror_channel* channel = find_channel(children[i]);
+        _order_scratch[channel != nullptr ? channel->order : 0] = i;
+    }
+
+    std::vector<uint64> sorted;
+    sorted.reserve(children.size());
+    std::vector<char> placed(children.size(), 0);
+    size_t next = 0;
+    while (sorted.size() < children.size()) {
+        // Start a chain at the first channel, or at the first one not placed
+        // yet if the chain broke off
+        uint64 above = sorted.empty() ? 0 : sorted.back();
+        std::unordered_map<uint64, size_t>::iterator it = _order_scratch.find(above);
+        size_t index;
+        if (it != _order_scratch.end() && !placed[it->second]) {
+            index = it->second;
+        } else {
+            while (placed[next]) {
+                next++;
+            }
+            index = next;
+        }
+        placed[index] = 1;
+        sorted.push_back(children[index]);
+    }
+    children.swap(sorted);
+}
+
+//-----------------------------------------------------------------------------
+/// Changes the number of clients in a channel, if the channel is known
+void Server_mirror::_count_clients(uint64 channel_id, int delta) {
+    std::unordered_map<uint64, size_t>::iterator it = _channel_index.find(channel_id);
+    if (it != _channel_index.end()) {
+        _channels[it->second].client_count += delta;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the shared copy of a name, taking a reference
+const std::string* Server_mirror::_intern(const std::string& name) {
+    std::unordered_map<std::string, unsigned int>::iterator it = _names.find(name);
+    if (it == _names.end()) {
+        it = _names.insert(std::make_pair(name, 0u)).first;
+    }
+    it->second++;
+    return &it->first;
+}
+
+//-----------------------------------------------------------------------------
+/// Drops a reference to a shared name
+void Server_mirror::_release(const std::string* name) {
+    std::unordered_map<std::string, unsigned int>::iterator it = _names.find(*name);
+    if (it != _names.end() && --it->second == 0) {
+        _names.erase(it);
+    }
+}
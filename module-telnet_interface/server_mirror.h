@@ -0,0 +1,293 @@
+/*
+* Filenme: server_mirror.h
+* Purpose: Defines the Server_mirror class, an in-process copy of the
+*          channels and clients of a single server connection
+*/
+#ifndef _SERVER_MIRROR_H_
+#define _SERVER_MIRROR_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "teamspeak/public_definitions.h"
+#include "nickname_index.h"
+
+/// A channel of the mirrored server
+struct Mirror_channel {
+    /// ID of the channel
+    uint64 id;
+
+    /// ID of the parent channel, 0 for top level channels
+    uint64 parent_id;
+
+    /// ID of the sibling sorted directly above the channel, 0 if it is the
+    /// first one
+    uint64 order;
+
+    /// Number of clients in the channel, not counting subchannels
+    unsigned int client_count;
+
+    /// Interned name of the channel
+    const std::string* name;
+};
+
+/// A client of the mirrored server
+struct Mirror_client {
+    /// ID of the client
+    anyID id;
+
+    /// ID of the channel the client is in
+    uint64 channel_id;
+
+    /// Interned nickname of the client
+    const std::string* name;
+
+    /// Unique identifier of the client, owned by the mirror's identity
+    /// table, or nullptr while it is unknown
+    const std::string* uid;
+};
+
+/// What the mirror knows about a unique identifier
+struct Mirror_identity {
+    /// ID of the client using the identifier, 0 if it is not connected.
+    /// If several clients connect with the same identity, one of them
+    anyID client_id;
+
+    /// Number of mirrored clients using the identifier
+    unsigned int client_count;
+
+    /// Database ID of the identifier, 0 while it is unknown
+    uint64 database_id;
+};
+
+/// Kinds of changes applied to a mirror
+enum Mirror_update_type {
+    MIRROR_UPDATE_RESET,            // Drop the mirrored state of the server
+    MIRROR_UPDATE_REMOVE_SERVER,    // The server connection is gone
+    MIRROR_UPDATE_CHANNEL,          // A channel was added or changed
+    MIRROR_UPDATE_REMOVE_CHANNEL,   // A channel was deleted
+    MIRROR_UPDATE_CLIENT,           // A client appeared or changed
+    MIRROR_UPDATE_REMOVE_CLIENT,    // A client left the view
+    MIRROR_UPDATE_IDENTITY          // A unique identifier was resolved
+};
+
+/// A change to the mirror, collected on a TeamSpeak thread and applied on
+/// the interface thread
+struct Mirror_update {
+    /// Kind of change
+    Mirror_update_type type;
+
+    /// Server connection the change applies to
+    uint64 server_connection_id;
+
+    /// ID of the channel or client. For identities, the client using the
+    /// identifier, 0 if not known
+    uint64 id;
+
+    /// Parent of a channel, or channel of a client. For identities, the
+    /// database ID, 0 if not known
+    uint64 parent_id;
+
+    /// Sibling sorted directly above a channel, unused for clients
+    uint64 order;
+
+    /// Name of the channel, nickname of the client, or unique identifier
+    std::string name;
+};
+
+/// Kinds of entries recorded by the change log
+enum Mirror_entity {
+    MIRROR_ENTITY_CHANNEL,
+    MIRROR_ENTITY_CLIENT
+};
+
+/// Kinds of changes recorded by the change log
+enum Mirror_change_type {
+    MIRROR_CHANGE_ADDED,    // The entry appeared
+    MIRROR_CHANGE_CHANGED,  // A property of the entry changed
+    MIRROR_CHANGE_REMOVED   // The entry is gone
+};
+
+/// A change recorded by the change log
+struct Mirror_change {
+    /// Version the change produced
+    uint64 version;
+
+    /// Kind of entry changed
+    Mirror_entity entity;
+
+    /// Kind of change
+    Mirror_change_type type;
+
+    /// ID of the channel or client
+    uint64 id;
+};
+
+/// Number of changes kept by the change log of a mirror
+const size_t MIRROR_CHANGE_LOG_SIZE = 1024;
+
+class Server_mirror {
+public:
+    /// Constructor, creates an empty mirror
+    Server_mirror();
+
+    /// Destructor
+    ~Server_mirror();
+
+    /// Applies a channel or client update
+    void apply(const Mirror_update& update);
+
+    /// Removes all channels and clients. Changes from before can no longer
+    /// be followed
+    void clear();
+
+    /// Returns the version of the latest change to any mirror. Versions are
+    /// shared by all mirrors, so a version taken before listing several
+    /// servers is a valid starting point for all of them
+    static uint64 get_current_version();
+
+    /// Starts a new version without a change to a mirror, for changes
+    /// outside the mirrors such as a mirror being dropped. Returns it
+    static uint64 advance_version();
+
+    /// Appends the changes made after a version, oldest first. Returns
+    /// false if the change log no longer reaches back that far, in which
+    /// case the state must be listed afresh
+    bool collect_changes(uint64 since, std::vector<Mirror_change>& changes) const;
+
+    /// Returns all channels, in no particular order
+    const std::vector<Mirror_channel>& get_channels() const;
+
+    /// Returns all clients, in no particular order
+    const std::vector<Mirror_client>& get_clients() const;
+
+    /// Returns the IDs of all channels, sorted ascending
+    const std::vector<uint64>& get_channel_ids() const;
+
+    /// Returns the IDs of all clients, sorted ascending
+    const std::vector<anyID>& get_client_ids() const;
+
+    /// Returns the channel with the given ID, or nullptr if it is unknown
+    const Mirror_channel* find_channel(uint64 channel_id) const;
+
+    /// Returns the client with the given ID, or nullptr if it is unknown
+    const Mirror_client* find_client(anyID client_id) const;
+
+    /// Returns the IDs of the subchannels of a channel, or of the top level
+    /// channels for ID 0, sorted like the client shows them
+    const std::vector<uint64>& get_children(uint64 channel_id) const;
+
+    /// Returns the index of the nicknames of the clients
+    const Nickname_index& get_nicknames() const;
+
+    /// Returns the client using a unique identifier, or nullptr if no such
+    /// client is known
+    const Mirror_client* find_client_by_uid(const std::string& uid) const;
+
+    /// Returns what is known about a unique identifier, or nullptr if
+    /// nothing is
+    const Mirror_identity* find_identity(const std::string& uid) const;
+
+private:
+    /// Adds or updates a channel
+    void _set_channel(uint64 channel_id, uint64 parent_id, uint64 order, const std::string& name);
+
+    /// Removes a channel
+    void _remove_channel(uint64 channel_id);
+
+    /// Adds or updates a client
+    void _set_client(anyID client_id, uint64 channel_id, const std::string& name);
+
+    /// Removes a client
+    void _remove_client(anyID client_id);
+
+    /// Records the client and database ID of a unique identifier. IDs of 0
+    /// are unknown and leave the recorded ones alone
+    void _set_identity(anyID client_id, uint64 database_id, const std::string& uid);
+
+    /// Detaches a leaving client from its unique identifier
+    void _release_identity(const Mirror_client& client);
+
+    /// Records a change under a new version
+    void _log_change(Mirror_entity entity, Mirror_change_type type, uint64 id);
+
+    /// Adds a channel to the subchannels of its parent
+    void _attach_channel(uint64 parent_id, uint64 channel_id);
+
+    /// Removes a channel from the subchannels of its parent
+    void _detach_channel(uint64 parent_id, uint64 channel_id);
+
+    /// Sorts subchannels by following their order links
+    void _sort_children(std::vector<uint64>& children);
+
+    /// Changes the number of clients in a channel, if the channel is known
+    void _count_clients(uint64 channel_id, int delta);
+
+    /// Returns the shared copy of a name, taking a reference
+    const std::string* _intern(const std::string& name);
+
+    /// Drops a reference to a shared name
+    void _release(const std::string* name);
+
+    // Mirrors hold pointers into their own name pool and are not copied
+    Server_mirror(const Server_mirror&);
+    Server_mirror& operator=(const Server_mirror&);
+
+private: // Private members
+
+    /// Channels, stored densely so listing them walks contiguous memory
+    std::vector<Mirror_channel> _channels;
+
+    /// Maps channel IDs to their index in _channels
+    std::unordered_map<uint64, size_t> _channel_index;
+
+    /// IDs of the channels in ascending order, so lists can resume at a
+    /// cursor without walking all channels
+    std::vector<uint64> _channel_ids;
+
+    /// Clients, stored densely so listing them walks contiguous memory
+    std::vector<Mirror_client> _clients;
+
+    /// Maps client IDs to their index in _clients
+    std::unordered_map<anyID, size_t> _client_index;
+
+    /// IDs of the clients in ascending order, so lists can resume at a
+    /// cursor without walking all clients
+    std::vector<anyID> _client_ids;
+
+    /// Sorted subchannel IDs by parent ID, 0 holding the top level channels.
+    /// Only channels with subchannels have an entry
+    std::unordered_map<uint64, std::vector<uint64> > _children;
+
+    /// Position of each sibling by the ID of the sibling above it, used
+    /// while sorting. Kept to reuse its storage
+    std::unordered_map<uint64, size_t> _order_scratch;
+
+    /// Nicknames of the clients, for lookups by name
+    Nickname_index _nicknames;
+
+    /// Identities by unique identifier. Identifiers of connected clients
+    /// stay while the client does; those with a known database ID stay
+    /// until the mirror is cleared. Map nodes never move, so clients point
+    /// to the keys
+    std::unordered_map<std::string, Mirror_identity> _identities;
+
+    /// Latest changes, a ring of MIRROR_CHANGE_LOG_SIZE entries once full
+    std::vector<Mirror_change> _changes;
+
+    /// Index of the oldest change in _changes
+    size_t _oldest_change;
+
+    /// All changes made after this version are in the log
+    uint64 _log_start;
+
+    /// Version of the latest change to any mirror
+    static uint64 _current_version;
+
+    /// Interned names with their reference count. Map nodes never move, so
+    /// pointers to the keys stay valid until the name is released
+    std::unordered_map<std::string, unsigned int> _names;
+};
+
+#endif // _SERVER_MIRROR_H_
@@ -0,0 +1,183 @@
+/*
+* Filenme: subscription_table.cpp
+* Purpose: Implements the Subscription_table class functions and members
+*/
+#include "subscription_table.h"
+
+#include <cstring>
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+/// Constructor, creates an empty table
+Subscription_table::Subscription_table() {
+}
+
+//-----------------------------------------------------------------------------
+/// Adds a filter for a session
+void Subscription_table::subscribe(Telnet_session* session, const Event_filter& filter) {
+    std::vector<Compiled_filter>::iterator it = std::lower_bound(_filters.begin(), _filters.end(), session, _session_less);
+    for (; it != _filters.end() && it->session == session; ++it) {
+        if (_equals(*it, session, filter)) {
+            // Already subscribed
+            return;
+        }
+    }
+
+    Compiled_filter compiled;
+    compiled.session = session;
+    compiled.types = filter.types;
+    compiled.server_connection_id = filter.server_connection_id;
+    compiled.channel_id = filter.channel_id;
+    compiled.from_id = filter.from_id;
+    compiled.prefix = filter.prefix.empty() ? -1 : _acquire_prefix(filter.prefix);
+    _filters.insert(it, compiled);
+}
+
+//-----------------------------------------------------------------------------
+/// Removes the filter of a session which equals the given one
+bool Subscription_table::unsubscribe(Telnet_session* session, const Event_filter& filter) {
+    std::vector<Compiled_filter>::iterator it = std::lower_bound(_filters.begin(), _filters.end(), session, _session_less);
+    for (; it != _filters.end() && it->session == session; ++it) {
+        if (_equals(*it, session, filter)) {
+            if (it->prefix >= 0) {
+                _release_prefix(it->prefix);
+            }
+            _filters.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Removes all filters of a session
+void Subscription_table::remove_session(Telnet_session* session) {
+    std::vector<Compiled_filter>::iterator first = std::lower_bound(_filters.begin(), _filters.end(), session, _session_less);
+    std::vector<Compiled_filter>::iterator last = first;
+    for (; last != _filters.end() && last->session == session; ++last) {
+        if (last->prefix >= 0) {
+            _release_prefix(last->prefix);
+        }
+    }
+    _filters.erase(first, last);
+}
+
+//-----------------------------------------------------------------------------
+/// Collects the sessions to which a notification is delivered
+void Subscription_table::match(const Notification& notification, std::vector<Telnet_session*>& sessions) {
+    sessions.clear();
+
+    // Compare the message against each distinct prefix once
+    for (size_t i = 0; i < _prefixes.size(); i++) {
+        const std::string& prefix = _prefixes[i];
+        _prefix_matches[i] = _prefix_references[i] > 0 &&
+            prefix.length() <= notification.message_length &&
+            memcmp(prefix.c_str(), notification.message, prefix.length()) == 0;
+    }
+
+    for (size_t i = 0; i < _filters.size(); i++) {
+        const Compiled_filter& filter = _filters[i];
+        if (!sessions.empty() && sessions.back() == filter.session) {
+            // The session already receives the notification
+            continue;
+        }
+
+        if ((filter.types & notification.type) != 0 &&
+            (filter.server_connection_id == 0 || filter.server_connection_id == notification.server_connection_id) &&
+            (filter.channel_id == 0 || filter.channel_id == notification.channel_id) &&
+            (filter.from_id == 0 || filter.from_id == notification.from_id) &&
+            (filter.prefix < 0 || _prefix_matches[filter.prefix])) {
+            sessions.push_back(filter.session);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if any filter of a session matches a notification
+bool Subscription_table::accepts(Telnet_session* session, const Notification& notification) const {
+    std::vector<Compiled_filter>::const_iterator it = std::lower_bound(_filters.begin(), _filters.end(), session, _session_less);
+    for (; it != _filters.end() && it->session == session; ++it) {
+        if ((it->types & notification.type) == 0 ||
+            (it->server_connection_id != 0 && it->server_connection_id != notification.server_connection_id) ||
+            (it->channel_id != 0 && it->channel_id != notification.channel_id) ||
+            (it->from_id != 0 && it->from_id != notification.from_id)) {
+            continue;
+        }
+        if (it->prefix < 0) {
+            return true;
+        }
+        const std::string& prefix = _prefixes[it->prefix];
+        if (prefix.length() <= notification.message_length &&
+            memcmp(prefix.c_str(), notification.message, prefix.length()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if any filter accepts one of a mask of notification types
+bool Subscription_table::is_subscribed(unsigned int types) const {
+    for (size_t i = 0; i < _filters.size(); i++) {
+        if ((_filters[i].types & types) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the index of a prefix, adding a reference to it
+int Subscription_table::_acquire_prefix(const std::string& prefix) {
+    int free_slot = -1;
+    for (size_t i = 0; i < _prefixes.size(); i++) {
+        if (_prefix_references[i] > 0 && _prefixes[i] == prefix) {
+            _prefix_references[i]++;
+            return (int)i;
+        }
+        if (_prefix_references[i] == 0 && free_slot < 0) {
+            free_slot = (int)i;
+        }
+    }
+
+    if (free_slot < 0) {
+        free_slot = (int)_prefixes.size();
+        _prefixes.push_back(prefix);
+        _prefix_references.push_back(1);
+        _prefix_matches.push_back(0);
+    } else {
+        _prefixes[free_slot] = prefix;
+        _prefix_references[free_slot] = 1;
+    }
+    return free_slot;
+}
+
+//-----------------------------------------------------------------------------
+/// Drops a reference to a prefix
+void Subscription_table::_release_prefix(int prefix) {
+    if (--_prefix_references[prefix] == 0) {
+        _prefixes[prefix].clear();
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Orders compiled filters by their session
+bool Subscription_table::_session_less(const Compiled_filter& filter, Telnet_session* session) {
+    return filter.session < session;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if a compiled filter equals a requested filter
+bool Subscription_table::_equals(const Compiled_filter& compiled, Telnet_session* session, const Event_filter& filter) const {
+    if (compiled.session != session ||
+        compiled.types != filter.types ||
+        compiled.server_connection_id != filter.server_connection_id ||
+        compiled.channel_id != filter.channel_id ||
+        compiled.from_id != filter.from_id) {
+        return false;
+    }
+    if (compiled.prefix < 0) {
+        return filter.prefix.empty();
+    }
+    return _prefixes[compiled.prefix] == filter.prefix;
+}
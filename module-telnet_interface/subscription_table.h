@@ -0,0 +1,148 @@
+/*
+* Filenme: subscription_table.h
+* Purpose: Defines the Subscription_table class, which holds the event
+*          filters of all sessions and matches notifications against them
+*/
+#ifndef _SUBSCRIPTION_TABLE_H_
+#define _SUBSCRIPTION_TABLE_H_
+
+#include <string>
+#include <vector>
+
+#include "teamspeak/public_definitions.h"
+
+class Telnet_session;
+
+/// Kinds of notifications sessions can subscribe to, usable as a mask
+enum Notification_type {
+    NOTIFICATION_SERVER  = 1 << 0,  // Server connection status changes
+    NOTIFICATION_PRIVATE = 1 << 1,  // Private text messages
+    NOTIFICATION_CHANNEL = 1 << 2,  // Channel text messages
+    NOTIFICATION_POKE    = 1 << 3,  // Pokes
+    NOTIFICATION_ALL     = (1 << 4) - 1,
+    NOTIFICATION_TALK    = 1 << 4,  // Clients starting or stopping to talk.
+                                    // Frequent, so not part of ALL
+    NOTIFICATION_UPDATE  = 1 << 5   // Coalesced changes to clients and
+                                    // channels. Not part of ALL either
+};
+
+/// A notification as seen by the filters
+struct Notification {
+    /// Kind of notification
+    Notification_type type;
+
+    /// Server connection the notification comes from
+    uint64 server_connection_id;
+
+    /// Channel of the sender, 0 if there is no sender
+    uint64 channel_id;
+
+    /// Client which sent the message, 0 if there is no sender
+    uint64 from_id;
+
+    /// Message text, matched against prefixes
+    const char* message;
+
+    /// Length of the message text
+    size_t message_length;
+};
+
+/// A subscription requested by a session. ID fields of 0 match any ID
+struct Event_filter {
+    /// Mask of Notification_type values
+    unsigned int types;
+
+    /// Server connection to match
+    uint64 server_connection_id;
+
+    /// Channel of the sender to match
+    uint64 channel_id;
+
+    /// Sender to match
+    uint64 from_id;
+
+    /// Start of the message to match, empty to match any message
+    std::string prefix;
+};
+
+class Subscription_table {
+public:
+    /// Constructor, creates an empty table
+    Subscription_table();
+
+    /// Adds a filter for a session. Filters of a session are combined, a
+    /// notification is delivered if any of them matches
+    void subscribe(Telnet_session* session, const Event_filter& filter);
+
+    /// Removes the filter of a session which equals the given one. Returns
+    /// false if there is no such filter
+    bool unsubscribe(Telnet_session* session, const Event_filter& filter);
+
+    /// Removes all filters of a session
+    void remove_session(Telnet_session* session);
+
+    /// Collects the sessions to which a notification is delivered, replacing
+    /// the contents of the vector. Each session is added once
+    void match(const Notification& notification, std::vector<Telnet_session*>& sessions);
+
+    /// Determines if any filter of a session matches a notification. Used
+    /// for single sessions, where preparing the prefixes for match isn't
+    /// worth it
+    bool accepts(Telnet_session* session, const Notification& notification) const;
+
+    /// Determines if any filter accepts one of a mask of notification
+    /// types, so notifications nobody wants needn't be built
+    bool is_subscribed(unsigned int types) const;
+
+private:
+    /// A filter reduced to plain values, so matching needs no string work
+    struct Compiled_filter {
+        /// Session owning the filter
+        Telnet_session* session;
+
+        /// Mask of Notification_type values
+        unsigned int types;
+
+        /// Server connection to match, 0 for any
+        uint64 server_connection_id;
+
+        /// Channel of the sender to match, 0 for any
+        uint64 channel_id;
+
+        /// Sender to match, 0 for any
+        uint64 from_id;
+
+        /// Index into _prefixes, -1 to match any message
+        int prefix;
+    };
+
+    /// Returns the index of a prefix, adding a reference to it
+    int _acquire_prefix(const std::string& prefix);
+
+    /// Drops a reference to a prefix
+    void _release_prefix(int prefix);
+
+    /// Orders compiled filters by their session
+    static bool _session_less(const Compiled_filter& filter, Telnet_session* session);
+
+    /// Determines if a compiled filter equals a requested filter
+    bool _equals(const Compiled_filter& compiled, Telnet_session* session, const Event_filter& filter) const;
+
+private: // Private members
+
+    /// Filters of all sessions, ordered by session so each session's
+    /// filters are adjacent
+    std::vector<Compiled_filter> _filters;
+
+    /// Distinct prefixes used by the filters. Each is compared once per
+    /// notification, however many sessions use it
+    std::vector<std::string> _prefixes;
+
+    /// Number of filters using each prefix, 0 marks a free slot
+    std::vector<unsigned int> _prefix_references;
+
+    /// Match results of the prefixes for the current notification
+    std::vector<char> _prefix_matches;
+};
+
+#endif // _SUBSCRIPTION_TABLE_H_
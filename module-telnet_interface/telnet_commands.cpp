@@ -0,0 +1,1800 @@
+/*
+* Filenme: telnet_commands.cpp
+* Purpose: Implements the command handlers of the Telnet_interface class and
+*          the table dispatching commands to them
+*/
+#include "telnet_if.h"
+#include "teamspeak/public_errors.h"
+#include "teamspeak/public_rare_definitions.h"
+
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+const char* TEAMSPEAK_CMD_PREFIX = "ts3";
+
+/// Size of the buffers receiving return codes
+const size_t RETURN_CODE_SIZE = 64;
+
+/// Names of the notification types accepted by the events commands
+static const struct {
+    const char* name;
+    unsigned int types;
+} NOTIFICATION_TYPE_NAMES[] = {
+    { "all",     NOTIFICATION_ALL },
+    { "server",  NOTIFICATION_SERVER },
+    { "private", NOTIFICATION_PRIVATE },
+    { "channel", NOTIFICATION_CHANNEL },
+    { "poke",    NOTIFICATION_POKE },
+    { "talk",    NOTIFICATION_TALK },
+    { "update",  NOTIFICATION_UPDATE },
+};
+
+/// Names of the formats accepted by ts3.session.format
+static const struct {
+    const char* name;
+    Session_format format;
+} SESSION_FORMAT_NAMES[] = {
+    { "text",   SESSION_FORMAT_TEXT },
+    { "json",   SESSION_FORMAT_JSON },
+    { "binary", SESSION_FORMAT_BINARY },
+};
+
+/// Size of the buffer holding a property name while resolving a field
+const size_t PROPERTY_NAME_SIZE = 64;
+
+/// Number of entries written per chunk of a list
+const uint64 LIST_CHUNK_ENTRIES = 64;
+
+/// Prefix of user arguments given as a unique identifier instead of an ID
+const char UID_PREFIX[] = "uid:";
+const size_t UID_PREFIX_LENGTH = sizeof(UID_PREFIX) - 1;
+
+/// Longest coalescing window accepted by ts3.events.coalesce, in
+/// milliseconds
+const uint64 COALESCE_MAX_WINDOW = 60000;
+
+/// Fields of the list commands whose name differs from their property
+static const struct {
+    List_target target;
+    const char* name;
+    const char* property;
+} LIST_FIELD_ALIASES[] = {
+    { LIST_TARGET_CLIENTS, "uid",     "client_unique_identifier" },
+    { LIST_TARGET_CLIENTS, "talking", "client_flag_talking" },
+};
+
+/// Commands supported by the interface. Usage strings are shown to the
+/// client, optional parameters are marked with *. Commands without usage
+/// string are not listed
+const Telnet_interface::Command_entry Telnet_interface::_commands[] = {
+    { "ts3.identifier.add",         &Telnet_interface::_command_identifier_unsupported, nullptr },
+    { "ts3.identifier.remove",      &Telnet_interface::_command_identifier_unsupported, nullptr },
+    { "ts3.servers.connect",        &Telnet_interface::_command_servers_connect,        "<hostname> <identity> <nickname> <*capture_profile> <*playback_profile> <*sound_profile>" },
+    { "ts3.servers.disconnect",     &Telnet_interface::_command_servers_disconnect,     "<*server_id>" },
+    { "ts3.servers.list",           &Telnet_interface::_command_servers_list,           "" },
+    { "ts3.servers.select",         &Telnet_interface::_command_servers_select,         "<server_id>" },
+    { "ts3.channels.list",          &Telnet_interface::_command_channels_list,          "<*all> <*fields=name,parent,...> <*limit=n> <*cursor=id> <*since=version> <*where field=value|field!=value|field~=text ...>" },
+    { "ts3.channels.select",        &Telnet_interface::_command_channels_select,        "<channel_id> <password>" },
+    { "ts3.channels.tree",          &Telnet_interface::_command_channels_tree,          "<*root_channel_id> <*depth>" },
+    { "ts3.users.list",             &Telnet_interface::_command_users_list,             "<*all> <*fields=nickname,channel,uid,...> <*limit=n> <*cursor=id> <*since=version> <*where field=value|field!=value|field~=text ...>" },
+    { "ts3.users.find",             &Telnet_interface::_command_users_find,             "<^prefix|text> <*all>" },
+    { "ts3.users.resolve",          &Telnet_interface::_command_users_resolve,          "<user_id|uid:identifier>" },
+    { "ts3.users.move",             &Telnet_interface::_command_users_move,             "<user_id|uid:identifier> <channel_id> <*password>" },
+    { "ts3.users.kick",             &Telnet_interface::_command_users_kick,             "<user_id|uid:identifier> <channel|server> <*reason>" },
+    { "ts3.messaging.send_private", &Telnet_interface::_command_messaging_send_private, "<user_id|uid:identifier> <message>" },
+    { "ts3.messaging.send_channel", &Telnet_interface::_command_messaging_send_channel, "<message>" },
+    { "ts3.messaging.send_poke",    &Telnet_interface::_command_messaging_send_poke,    "<user_id|uid:identifier> <message>" },
+    { "ts3.events.subscribe",       &Telnet_interface::_command_events_subscribe,       "<all|server|private|channel|poke|talk|update[,...]> <*server=id> <*channel=id> <*from=user_id> <*prefix=text>" },
+    { "ts3.events.unsubscribe",     &Telnet_interface::_command_events_unsubscribe,     "<*type> <*filters as given to subscribe>" },
+    { "ts3.events.resume",          &Telnet_interface::_command_events_resume,          "<last_seq>" },
+    { "ts3.events.coalesce",        &Telnet_interface::_command_events_coalesce,        "<*window_ms>" },
+    { "ts3.session.format",         &Telnet_interface::_command_session_format,         "<text|json|binary>" },
+    { "ts3.session.binary",         &Telnet_interface::_command_session_binary,         "" },
+};
+
+/// Number of supported commands
+const size_t Telnet_interface::_command_count = sizeof(Telnet_interface::_commands) / sizeof(Telnet_interface::_commands[0]);
+
+//-----------------------------------------------------------------------------
+/// Builds the lookup table for the supported commands
+void Telnet_interface::_build_command_table() {
+    std::vector<const char*> names(_command_count);
+    for (size_t i = 0; i < _command_count; i++) {
+        names[i] = _commands[i].name;
+    }
+    _command_table.build(&names[0], names.size());
+}
+
+//-----------------------------------------------------------------------------
+/// Sends a list of supported command to the client
+void Telnet_interface::_send_usage_to_client(Telnet_session& session) {
+    session.queue_write("The TeamSpeak3 Telnet interface supports the following commands:");
+    for (size_t i = 0; i < _command_count; i++) {
+        if (_commands[i].usage == nullptr) {
+            continue;
+        }
+        std::string usage = _commands[i].name;
+        if (_commands[i].usage[0] != '\0') {
+            usage.append(" ");
+            usage.append(_commands[i].usage);
+        }
+        session.queue_write(usage);
+    }
+    session.queue_write("Optional parameters are marked with *");
+    session.queue_write("Parameters containing spaces can be enclosed in double quotes");
+    session.queue_write("Requests answered with ok <n> are followed by done <n> or failed <n> <reason> once the server has processed them");
+    session.queue_write("Commands prefixed with #tag get the tag repeated on every line answering them");
+}
+
+//-----------------------------------------------------------------------------
+/// Parses and executes a single command line. The line is tokenized in
+/// place, so the handlers work on the received data without copying it
+void Telnet_interface::_parse_line(Telnet_session& session, char* line, size_t length) {
+    // The command is epected to have the following syntax: <command> <param1> <param2> ... <paramx>
+    Command_arguments arguments(line, length, session.get_format() == SESSION_FORMAT_BINARY ? ARGUMENT_SYNTAX_BINARY : ARGUMENT_SYNTAX_TEXT);
+
+    // The command is expected to have the following format: ts3.<category>.<action>
+    Token command;
+    if (arguments.next(command) != ARGUMENT_OK) {
+        return;
+    }
+
+    // A leading #tag is repeated on every line answering the command
+    if (command.data[0] == '#') {
+        session.set_reply_tag(command.data, command.length);
+        if (arguments.next(command) != ARGUMENT_OK) {
+            session.queue_write("ts3.error: no command after tag");
+            session.clear_reply_tag();
+            return;
+        }
+    }
+
+    int index = _command_table.find(command.data, command.length);
+    if (index >= 0) {
+        (this->*_commands[index].handler)(session, command, arguments);
+    } else {
+        _handle_unknown_command(session, std::string(command.data, command.length));
+    }
+
+    // Notifications written later belong to no command
+    session.clear_reply_tag();
+}
+
+//-----------------------------------------------------------------------------
+/// Reports a command that is not in the command table. Only this rare path
+/// splits the command into its parts, to tell apart an unknown action from an
+/// unknown category
+void Telnet_interface::_handle_unknown_command(Telnet_session& session, const std::string& command) {
+    std::istringstream command_parser(command);
+    std::string command_prefix;
+    std::getline(command_parser, command_prefix, '.');
+
+    if (command_prefix != TEAMSPEAK_CMD_PREFIX) {
+        _send_usage_to_client(session);
+        return;
+    }
+
+    std::string command_category;
+    std::getline(command_parser, command_category, '.');
+
+    std::string command_action;
+    std::getline(command_parser, command_action, '.');
+
+    std::string category_prefix = command_prefix + "." + command_category + ".";
+    for (size_t i = 0; i < _command_count; i++) {
+        if (strncmp(_commands[i].name, category_prefix.c_str(), category_prefix.length()) == 0) {
+            session.queue_write(command + " is not a supported action");
+            return;
+        }
+    }
+
+    std::string error_str = "ts3.error: ";
+    error_str.append(command_action + ": " + command_category + " is not a supported category");
+    session.queue_write(error_str);
+
+    _send_usage_to_client(session);
+}
+
+//-----------------------------------------------------------------------------
+// Identifier commands. Due to limited functionality on the plugin API, it is
+// not possible to add or remove new identities
+void Telnet_interface::_command_identifier_unsupported(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    _ts3Functions.logMessage("Found identifier command", LogLevel_DEBUG, "TestPlugin", 0);
+    session.queue_reply(command.data, command.length, "fail. Not available, as API does not support identity management");
+}
+
+//-----------------------------------------------------------------------------
+/// Establishes a new server connection
+void Telnet_interface::_command_servers_connect(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    bool valid = true;
+    Token host;
+    valid &= arguments.next(host) == ARGUMENT_OK;
+
+    Token identity;
+    valid &= arguments.next(identity) == ARGUMENT_OK;
+
+    Token nickname;
+    valid &= arguments.next(nickname) == ARGUMENT_OK;
+
+    // Optional parameters fall back to the defaults when missing
+    const char* capture_profile = "Default";
+    const char* playback_profile = "Default";
+    const char* sound_profile = "Default Sound Profile (Female)";
+    const char* server_password = "";
+
+    const char** optional[] = { &capture_profile, &playback_profile, &sound_profile, &server_password };
+    for (size_t i = 0; valid && i < sizeof(optional) / sizeof(optional[0]); i++) {
+        Token token;
+        Argument_result result = arguments.next(token);
+        if (result == ARGUMENT_OK) {
+            *optional[i] = token.data;
+        } else {
+            valid &= result == ARGUMENT_MISSING;
+            break;
+        }
+    }
+
+    if (valid) {
+        _ts3Functions.logMessage("Connecting...", LogLevel_DEBUG, "TestPlugin", 0);
+
+        uint64 new_server_connection_handler_id = 0;
+
+        // Start connection
+        int connect_result = _ts3Functions.guiConnect(
+            PLUGIN_CONNECT_TAB_NEW_IF_CURRENT_CONNECTED,
+            "PluginServerTab",       // serverLabel
+            host.data,               // serverAddress
+            server_password,         // serverPassword
+            nickname.data,           // nickname
+            "",                      // channel
+            "",                      // channelPassword
+            capture_profile,         // captureProfile
+            playback_profile,        // playbackProfile
+            "Default",               // hotkeyProfile
+            sound_profile,           // soundProfile
+            "",                      // userIdentity
+            "",                      // oneTimeKey
+            "",                      // phoneticName
+            &new_server_connection_handler_id
+            );
+
+        if (_evaluate_result(connect_result)) {
+            session.queue_reply(command.data, command.length, "ok");
+
+            std::ostringstream client_info_msg;
+            client_info_msg << "ts3.info New connection to server has ID " << new_server_connection_handler_id;
+            session.queue_write(client_info_msg.str());
+        } else {
+            session.queue_reply(command.data, command.length, "fail");
+        }
+    } else {
+        _ts3Functions.logMessage("servers.connect command is not valid", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Disconnects the given or the active server connection
+void Telnet_interface::_command_servers_disconnect(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    uint64 server_id = session.get_active_server_connection();
+    if (arguments.next_number(server_id, ARGUMENT_MAX_UINT64) == ARGUMENT_INVALID) {
+        _ts3Functions.logMessage("servers.disconnect has an invalid server ID", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail. Invalid connection ID");
+        return;
+    }
+
+    uint64* ids;
+    bool found = false;
+    if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
+        for (int i = 0; ids[i]; i++) {
+            if (ids[i] == server_id) {
+                _ts3Functions.logMessage("Disconnecting...", LogLevel_DEBUG, "TestPlugin", 0);
+                _ts3Functions.stopConnection(server_id, "Bye");
+                session.queue_reply(command.data, command.length, "ok");
+                found = true;
+                break;
+            }
+        }
+        _ts3Functions.freeMemory(ids);
+    }
+
+    if (!found) {
+        _ts3Functions.logMessage("servers.disconnect does not name a valid server", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail. Unknown connection ID");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Lists managed server connections
+void Telnet_interface::_command_servers_list(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    uint64* ids;
+    char* server_name;
+    if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
+        session.begin_list(command.data, command.length, "Server connections follow below, selected server indicated with [*]");
+        for (int i = 0; ids[i]; i++) {
+
+            if (_evaluate_result(_ts3Functions.getServerVariableAsString(ids[i], VIRTUALSERVER_NAME, &server_name))) {
+                List_mark mark = session.get_active_server_connection() == ids[i] ? LIST_MARK_SELECTED : LIST_MARK_UNSELECTED;
+                session.queue_list_entry(mark, ids[i], server_name, strlen(server_name));
+                _ts3Functions.freeMemory(server_name);
+            }
+        }
+        _ts3Functions.freeMemory(ids);
+
+        session.end_list(0, 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Selects the server connection used by the following commands
+void Telnet_interface::_command_servers_select(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    uint64 server_id;
+    Argument_result result = arguments.next_number(server_id, ARGUMENT_MAX_UINT64);
+
+    if (result == ARGUMENT_OK) {
+        uint64* ids;
+        bool found = false;
+        if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
+            for (int i = 0; ids[i]; i++) {
+                if (ids[i] == server_id) {
+                    _ts3Functions.logMessage("Selecting server", LogLevel_DEBUG, "TestPlugin", 0);
+                    session.set_active_server_connection(server_id);
+                    session.set_active_server_channel(0);
+                    found = true;
+                    session.queue_reply(command.data, command.length, "ok");
+                    break;
+                }
+            }
+            _ts3Functions.freeMemory(ids);
+        }
+
+        if (!found) {
+            _ts3Functions.logMessage("Could not select server, invalid ID specified", LogLevel_INFO, "TestPlugin", 0);
+            session.queue_reply(command.data, command.length, "fail. Unknown connection ID.");
+        }
+    } else if (result == ARGUMENT_INVALID) {
+        _ts3Functions.logMessage("Could not select server, malformed ID specified", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail. Invalid connection ID.");
+    } else {
+        _ts3Functions.logMessage("Could not select server, no ID specified", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail. ID not specified.");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Lists the channels on the active server, served from the mirror in
+/// order of their ID
+void Telnet_interface::_command_channels_list(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    List_query query;
+    if (_parse_list_query(arguments, LIST_TARGET_CHANNELS, query) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. Invalid list options");
+        return;
+    }
+
+    if (query.since != 0) {
+        _write_list_changes(session, command, "Channels follow below, selected channel indicated with [*]", LIST_TARGET_CHANNELS, query);
+        return;
+    }
+    if (query.all_servers) {
+        session.begin_list(command.data, command.length, "Channels follow below, selected channel indicated with [*]");
+        _write_list_all_servers(session, LIST_TARGET_CHANNELS, query);
+        return;
+    }
+
+    const Server_mirror* mirror = _find_mirror(session.get_active_server_connection());
+    if (mirror == nullptr) {
+        session.queue_reply(command.data, command.length, "fail. Server not connected");
+        return;
+    }
+
+    session.begin_list(command.data, command.length, "Channels follow below, selected channel indicated with [*]");
+    _start_list_stream(session, LIST_TARGET_CHANNELS, query);
+}
+
+//-----------------------------------------------------------------------------
+/// Moves the own client to a channel on the active server
+void Telnet_interface::_command_channels_select(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    uint64 channel_id;
+    Argument_result result = arguments.next_number(channel_id, ARGUMENT_MAX_UINT64);
+
+    if (result == ARGUMENT_OK) {
+        Token password;
+        if (arguments.next(password) != ARGUMENT_OK) {
+            password.data = "";
+            password.length = 0;
+        }
+
+        anyID myid;
+        char return_code_buffer[RETURN_CODE_SIZE];
+        const char* return_code = _create_return_code(return_code_buffer, sizeof(return_code_buffer));
+        if (_evaluate_result(_ts3Functions.getClientID(session.get_active_server_connection(), &myid))) {  // Determine own ID
+            if (_evaluate_result(_ts3Functions.requestClientMove(session.get_active_server_connection(), myid, channel_id, password.data, return_code))) {
+                _ts3Functions.logMessage("Channel selected", LogLevel_DEBUG, "TestPlugin", 0);
+                session.set_active_server_channel(channel_id);
+                _reply_request_sent(session, command, return_code);
+            } else {
+                _ts3Functions.logMessage("Could not select channel", LogLevel_INFO, "TestPlugin", 0);
+                session.queue_reply(command.data, command.length, "fail");
+            }
+        } else {
+            _ts3Functions.logMessage("Could not select channel", LogLevel_INFO, "TestPlugin", 0);
+            session.queue_reply(command.data, command.length, "fail. Could not select");
+        }
+    } else if (result == ARGUMENT_INVALID) {
+        _ts3Functions.logMessage("Could not select channel, malformed ID specified", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail. Invalid channel ID");
+    } else {
+        _ts3Functions.logMessage("Could not select channel, no ID specified", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail. No channel specified");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Lists the channel tree of the active server below a channel, or the
+/// whole tree, with the number of clients in each channel and in each
+/// subtree. Walks only the subtree in the mirror's child lists, so channels
+/// come in the order the client shows them
+void Telnet_interface::_command_channels_tree(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    const Server_mirror* mirror = _find_mirror(session.get_active_server_connection());
+    if (mirror == nullptr) {
+        session.queue_reply(command.data, command.length, "fail. Server not connected");
+        return;
+    }
+
+    uint64 root_id = 0;
+    uint64 max_depth = ARGUMENT_MAX_UINT64;
+    Argument_result result = arguments.next_number(root_id, ARGUMENT_MAX_UINT64);
+    if (result == ARGUMENT_OK) {
+        result = arguments.next_number(max_depth, ARGUMENT_MAX_UINT64);
+    }
+    if (result == ARGUMENT_INVALID) {
+        session.queue_reply(command.data, command.length, "fail. Invalid tree options");
+        return;
+    }
+    if (root_id != 0 && mirror->find_channel(root_id) == nullptr) {
+        session.queue_reply(command.data, command.length, "fail. Invalid channel ID");
+        return;
+    }
+
+    // Walk the subtree depth first, pushing children in reverse so they are
+    // visited in order. The whole subtree is walked, as totals include
+    // channels below the depth shown
+    _tree_nodes.clear();
+    _tree_stack.clear();
+    Tree_node node = { root_id, 0, (size_t)-1, 0 };
+    if (root_id != 0) {
+        _tree_stack.push_back(node);
+    } else {
+        const std::vector<uint64>& top = mirror->get_children(0);
+        for (size_t i = top.size(); i > 0; i--) {
+            node.id = top[i - 1];
+            node.depth = 1;
+            _tree_stack.push_back(node);
+        }
+    }
+    while (!_tree_stack.empty()) {
+        node = _tree_stack.back();
+        _tree_stack.pop_back();
+        node.total = mirror->find_channel(node.id)->client_count;
+        size_t position = _tree_nodes.size();
+        _tree_nodes.push_back(node);
+
+        const std::vector<uint64>& children = mirror->get_children(node.id);
+        for (size_t i = children.size(); i > 0; i--) {
+            Tree_node child = { children[i - 1], node.depth + 1, position, 0 };
+            _tree_stack.push_back(child);
+        }
+    }
+
+    // Parents precede their children, so a backwards pass sums the subtrees
+    for (size_t i = _tree_nodes.size(); i > 0; i--) {
+        const Tree_node& child = _tree_nodes[i - 1];
+        if (child.parent != (size_t)-1) {
+            _tree_nodes[child.parent].total += child.total;
+        }
+    }
+
+    session.begin_list(command.data, command.length, "Channel tree follows below, selected channel indicated with [*]");
+    for (size_t i = 0; i < _tree_nodes.size(); i++) {
+        const Tree_node& entry = _tree_nodes[i];
+        if (entry.depth > max_depth) {
+            continue;
+        }
+        const Mirror_channel* channel = mirror->find_channel(entry.id);
+        List_mark mark = session.get_active_server_channel() == entry.id ? LIST_MARK_SELECTED : LIST_MARK_UNSELECTED;
+        session.begin_list_record(mark, entry.id);
+        session.queue_record_string("name", 4, channel->name->c_str(), channel->name->length());
+        session.queue_record_number("parent", 6, channel->parent_id);
+        session.queue_record_number("depth", 5, entry.depth);
+        session.queue_record_number("clients", 7, channel->client_count);
+        session.queue_record_number("total", 5, entry.total);
+        session.end_list_record();
+    }
+    session.end_list(0, 0);
+}
+
+//-----------------------------------------------------------------------------
+/// Lists the users on the active server, served from the mirror in order
+/// of their ID
+void Telnet_interface::_command_users_list(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    List_query query;
+    if (_parse_list_query(arguments, LIST_TARGET_CLIENTS, query) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. Invalid list options");
+        return;
+    }
+
+    if (query.since != 0) {
+        _write_list_changes(session, command, "Users follow below", LIST_TARGET_CLIENTS, query);
+        return;
+    }
+    if (query.all_servers) {
+        session.begin_list(command.data, command.length, "Users follow below");
+        _write_list_all_servers(session, LIST_TARGET_CLIENTS, query);
+        return;
+    }
+
+    const Server_mirror* mirror = _find_mirror(session.get_active_server_connection());
+    if (mirror == nullptr) {
+        session.queue_reply(command.data, command.length, "fail. Server not connected");
+        return;
+    }
+
+    session.begin_list(command.data, command.length, "Users follow below");
+    _start_list_stream(session, LIST_TARGET_CLIENTS, query);
+}
+
+//-----------------------------------------------------------------------------
+/// Finds users by the start of their nickname, given as "^prefix", or by
+/// a part of it, ignoring case. Searches the active server, or all servers
+/// if "all" is given
+void Telnet_interface::_command_users_find(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    Token pattern;
+    if (arguments.next(pattern) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. No pattern specified");
+        return;
+    }
+
+    Token scope;
+    bool all = false;
+    Argument_result result = arguments.next(scope);
+    if (result == ARGUMENT_OK && scope.length == 3 && strncmp(scope.data, "all", 3) == 0) {
+        all = true;
+    } else if (result != ARGUMENT_MISSING) {
+        session.queue_reply(command.data, command.length, "fail. Invalid find options");
+        return;
+    }
+
+    // Search the servers in order of their ID
+    std::vector<uint64> server_ids;
+    if (all) {
+        for (std::unordered_map<uint64, Server_mirror*>::const_iterator it = _mirrors.begin(); it != _mirrors.end(); ++it) {
+            server_ids.push_back(it->first);
+        }
+        std::sort(server_ids.begin(), server_ids.end());
+    } else if (_find_mirror(session.get_active_server_connection()) != nullptr) {
+        server_ids.push_back(session.get_active_server_connection());
+    } else {
+        session.queue_reply(command.data, command.length, "fail. Server not connected");
+        return;
+    }
+
+    bool prefix = pattern.length > 0 && pattern.data[0] == '^';
+    std::string text = prefix ? std::string(pattern.data + 1, pattern.length - 1) : std::string(pattern.data, pattern.length);
+
+    session.begin_list(command.data, command.length, "Matching users follow below");
+    std::vector<anyID> matches;
+    for (size_t i = 0; i < server_ids.size(); i++) {
+        const Server_mirror* mirror = _find_mirror(server_ids[i]);
+        matches.clear();
+        if (prefix) {
+            mirror->get_nicknames().find_prefix(text, matches);
+        } else {
+            mirror->get_nicknames().find_substring(text, matches);
+        }
+
+        for (size_t j = 0; j < matches.size(); j++) {
+            const Mirror_client* client = mirror->find_client(matches[j]);
+            session.begin_list_record(LIST_MARK_NONE, client->id);
+            session.queue_record_number("server", 6, server_ids[i]);
+            session.queue_record_string("nickname", 8, client->name->c_str(), client->name->length());
+            session.queue_record_number("channel", 7, client->channel_id);
+            session.end_list_record();
+        }
+    }
+    session.end_list(0, 0);
+}
+
+//-----------------------------------------------------------------------------
+/// Shows the client ID, unique identifier and database ID of a user. A
+/// database ID which is not known yet is requested from the server, so
+/// asking again once it answered shows it
+void Telnet_interface::_command_users_resolve(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    const Server_mirror* mirror = _find_mirror(session.get_active_server_connection());
+    if (mirror == nullptr) {
+        session.queue_reply(command.data, command.length, "fail. Server not connected");
+        return;
+    }
+
+    Token target;
+    if (arguments.next(target) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. No user specified");
+        return;
+    }
+
+    // Identities are known for connected clients, and for identifiers
+    // whose database ID was requested
+    std::string uid;
+    uint64 client_id = 0;
+    if (target.length > UID_PREFIX_LENGTH && strncmp(target.data, UID_PREFIX, UID_PREFIX_LENGTH) == 0) {
+        uid.assign(target.data + UID_PREFIX_LENGTH, target.length - UID_PREFIX_LENGTH);
+    } else if (parse_number(target, ARGUMENT_MAX_ANY_ID, client_id)) {
+        const Mirror_client* client = mirror->find_client((anyID)client_id);
+        if (client == nullptr || client->uid == nullptr) {
+            session.queue_reply(command.data, command.length, "fail. Unknown user");
+            return;
+        }
+        uid = *client->uid;
+    } else {
+        session.queue_reply(command.data, command.length, "fail. Invalid user");
+        return;
+    }
+
+    const Mirror_identity* identity = mirror->find_identity(uid);
+    uint64 database_id = identity != nullptr ? identity->database_id : 0;
+    if (database_id == 0) {
+        _evaluate_result(_ts3Functions.requestClientDBIDfromUID(session.get_active_server_connection(), uid.c_str(), nullptr));
+    }
+
+    session.begin_list(command.data, command.length, "User identity follows below, IDs of 0 are unknown");
+    session.begin_list_record(LIST_MARK_NONE, identity != nullptr ? identity->client_id : 0);
+    session.queue_record_string("uid", 3, uid.c_str(), uid.length());
+    session.queue_record_number("database_id", 11, database_id);
+    session.end_list_record();
+    session.end_list(0, 0);
+}
+
+//-----------------------------------------------------------------------------
+/// Moves a user to a channel on the active server
+void Telnet_interface::_command_users_move(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    anyID client_id;
+    uint64 channel_id;
+    if (_next_client(session, arguments, client_id) != ARGUMENT_OK ||
+        arguments.next_number(channel_id, ARGUMENT_MAX_UINT64) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. Invalid user or channel");
+        return;
+    }
+
+    Token password;
+    if (arguments.next(password) != ARGUMENT_OK) {
+        password.data = "";
+        password.length = 0;
+    }
+
+    char return_code_buffer[RETURN_CODE_SIZE];
+    const char* return_code = _create_return_code(return_code_buffer, sizeof(return_code_buffer));
+    if (_evaluate_result(_ts3Functions.requestClientMove(session.get_active_server_connection(), client_id, channel_id, password.data, return_code))) {
+        _ts3Functions.logMessage("User moved", LogLevel_DEBUG, "TestPlugin", 0);
+        _reply_request_sent(session, command, return_code);
+    } else {
+        _ts3Functions.logMessage("Could not move user", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Kicks a user from their channel or from the active server
+void Telnet_interface::_command_users_kick(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    anyID client_id;
+    Token scope;
+    if (_next_client(session, arguments, client_id) != ARGUMENT_OK || arguments.next(scope) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. Invalid user or scope");
+        return;
+    }
+
+    bool from_server;
+    if (scope.length == 7 && strncmp(scope.data, "channel", 7) == 0) {
+        from_server = false;
+    } else if (scope.length == 6 && strncmp(scope.data, "server", 6) == 0) {
+        from_server = true;
+    } else {
+        session.queue_reply(command.data, command.length, "fail. Invalid user or scope");
+        return;
+    }
+
+    // The reason is the remainder of the line
+    Token reason = arguments.rest();
+
+    char return_code_buffer[RETURN_CODE_SIZE];
+    const char* return_code = _create_return_code(return_code_buffer, sizeof(return_code_buffer));
+    unsigned int result;
+    if (from_server) {
+        result = _ts3Functions.requestClientKickFromServer(session.get_active_server_connection(), client_id, reason.data, return_code);
+    } else {
+        result = _ts3Functions.requestClientKickFromChannel(session.get_active_server_connection(), client_id, reason.data, return_code);
+    }
+    if (_evaluate_result(result)) {
+        _ts3Functions.logMessage("User kicked", LogLevel_DEBUG, "TestPlugin", 0);
+        _reply_request_sent(session, command, return_code);
+    } else {
+        _ts3Functions.logMessage("Could not kick user", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns where the value of a client property is read from. Properties
+/// not listed here are text
+static List_field_source client_property_source(size_t flag) {
+    switch (flag) {
+    case CLIENT_NICKNAME:
+        return LIST_FIELD_NAME;
+    case CLIENT_FLAG_TALKING:
+    case CLIENT_INPUT_MUTED:
+    case CLIENT_OUTPUT_MUTED:
+    case CLIENT_OUTPUTONLY_MUTED:
+    case CLIENT_INPUT_HARDWARE:
+    case CLIENT_OUTPUT_HARDWARE:
+    case CLIENT_IS_MUTED:
+    case CLIENT_IS_RECORDING:
+    case CLIENT_AWAY:
+    case CLIENT_TYPE:
+    case CLIENT_FLAG_AVATAR:
+    case CLIENT_TALK_POWER:
+    case CLIENT_TALK_REQUEST:
+    case CLIENT_IS_TALKER:
+    case CLIENT_IS_PRIORITY_SPEAKER:
+    case CLIENT_UNREAD_MESSAGES:
+    case CLIENT_IS_CHANNEL_COMMANDER:
+        return LIST_FIELD_INT;
+    case CLIENT_DATABASE_ID:
+    case CLIENT_CHANNEL_GROUP_ID:
+    case CLIENT_CHANNEL_GROUP_INHERITED_CHANNEL_ID:
+        return LIST_FIELD_UINT64;
+    default:
+        return LIST_FIELD_STRING;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns where the value of a channel property is read from. Properties
+/// not listed here are text
+static List_field_source channel_property_source(size_t flag) {
+    switch (flag) {
+    case CHANNEL_NAME:
+        return LIST_FIELD_NAME;
+    case CHANNEL_CODEC:
+    case CHANNEL_CODEC_QUALITY:
+    case CHANNEL_MAXCLIENTS:
+    case CHANNEL_MAXFAMILYCLIENTS:
+    case CHANNEL_FLAG_PERMANENT:
+    case CHANNEL_FLAG_SEMI_PERMANENT:
+    case CHANNEL_FLAG_DEFAULT:
+    case CHANNEL_FLAG_PASSWORD:
+    case CHANNEL_CODEC_LATENCY_FACTOR:
+    case CHANNEL_CODEC_IS_UNENCRYPTED:
+    case CHANNEL_DELETE_DELAY:
+    case CHANNEL_FLAG_MAXCLIENTS_UNLIMITED:
+    case CHANNEL_FLAG_MAXFAMILYCLIENTS_UNLIMITED:
+    case CHANNEL_FLAG_MAXFAMILYCLIENTS_INHERITED:
+    case CHANNEL_FLAG_ARE_SUBSCRIBED:
+    case CHANNEL_NEEDED_TALK_POWER:
+    case CHANNEL_FORCED_SILENCE:
+    case CHANNEL_FLAG_PRIVATE:
+        return LIST_FIELD_INT;
+    case CHANNEL_ORDER:
+        return LIST_FIELD_UINT64;
+    default:
+        return LIST_FIELD_STRING;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if a field holds a number
+static bool is_numeric_field(const List_field& field) {
+    return field.source == LIST_FIELD_CHANNEL || field.source == LIST_FIELD_PARENT ||
+        field.source == LIST_FIELD_INT || field.source == LIST_FIELD_UINT64;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if a where clause is answered by the mirror, without calling
+/// into TeamSpeak
+static bool is_mirror_predicate(const List_predicate& predicate) {
+    return predicate.field.source == LIST_FIELD_NAME || predicate.field.source == LIST_FIELD_CHANNEL ||
+        predicate.field.source == LIST_FIELD_PARENT;
+}
+
+//-----------------------------------------------------------------------------
+/// Converts an ASCII letter to lower case
+static char ascii_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if text contains a lower case needle, ignoring ASCII case
+static bool contains_ignore_case(const std::string& text, const std::string& needle) {
+    if (needle.length() > text.length()) {
+        return false;
+    }
+    size_t last = text.length() - needle.length();
+    for (size_t i = 0; i <= last; i++) {
+        size_t j = 0;
+        while (j < needle.length() && ascii_lower(text[i + j]) == needle[j]) {
+            j++;
+        }
+        if (j == needle.length()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Parses the options of a list command: [fields=<name>[,<name>...]]
+/// [limit=<n>] [cursor=<id>] [where <clause> [<clause>...]]
+/// The where clauses take the rest of the line
+Argument_result Telnet_interface::_parse_list_query(Command_arguments& arguments, List_target target, List_query& query) {
+    query.limit = 0;
+    query.cursor = 0;
+    query.all_servers = false;
+    query.since = 0;
+
+    bool where = false;
+    Token option;
+    Argument_result result;
+    while ((result = arguments.next(option)) == ARGUMENT_OK) {
+        if (where) {
+            List_predicate predicate;
+            if (!_compile_list_predicate(target, option, predicate)) {
+                return ARGUMENT_INVALID;
+            }
+            query.predicates.push_back(predicate);
+            continue;
+        }
+        if (option.length == 5 && memcmp(option.data, "where", 5) == 0) {
+            where = true;
+            continue;
+        }
+        if (option.length == 3 && memcmp(option.data, "all", 3) == 0) {
+            query.all_servers = true;
+            continue;
+        }
+
+        const char* separator = (const char*)memchr(option.data, '=', option.length);
+        if (separator == nullptr) {
+            return ARGUMENT_INVALID;
+        }
+
+        size_t key_length = separator - option.data;
+        if (key_length == 6 && memcmp(option.data, "fields", 6) == 0) {
+            // Comma separated list of field names
+            const char* name = separator + 1;
+            const char* names_end = option.data + option.length;
+            while (name < names_end) {
+                const char* name_end = (const char*)memchr(name, ',', names_end - name);
+                if (name_end == nullptr) {
+                    name_end = names_end;
+                }
+
+                List_field field;
+                if (!_resolve_list_field(target, name, name_end - name, field)) {
+                    return ARGUMENT_INVALID;
+                }
+                query.fields.push_back(field);
+                name = name_end + 1;
+            }
+            if (query.fields.empty()) {
+                return ARGUMENT_INVALID;
+            }
+        } else if (key_length == 5 && memcmp(option.data, "limit", 5) == 0) {
+            Token value;
+            value.data = separator + 1;
+            value.length = option.length - key_length - 1;
+            if (!parse_number(value, ARGUMENT_MAX_UINT64, query.limit) || query.limit == 0) {
+                return ARGUMENT_INVALID;
+            }
+        } else if (key_length == 6 && memcmp(option.data, "cursor", 6) == 0) {
+            Token value;
+            value.data = separator + 1;
+            value.length = option.length - key_length - 1;
+            if (!parse_number(value, ARGUMENT_MAX_UINT64, query.cursor)) {
+                return ARGUMENT_INVALID;
+            }
+        } else if (key_length == 5 && memcmp(option.data, "since", 5) == 0) {
+            Token value;
+            value.data = separator + 1;
+            value.length = option.length - key_length - 1;
+            if (!parse_number(value, ARGUMENT_MAX_UINT64, query.since) || query.since == 0) {
+                return ARGUMENT_INVALID;
+            }
+        } else {
+            return ARGUMENT_INVALID;
+        }
+    }
+    if (result != ARGUMENT_MISSING || (where && query.predicates.empty())) {
+        return ARGUMENT_INVALID;
+    }
+    if ((query.all_servers || query.since != 0) && (query.limit != 0 || query.cursor != 0)) {
+        // A cursor only orders the entries of a single server, and changes
+        // are listed at once
+        return ARGUMENT_INVALID;
+    }
+
+    // Clauses answered by the mirror are cheap, so they run first and spare
+    // the calls into TeamSpeak for entries they reject
+    std::stable_partition(query.predicates.begin(), query.predicates.end(), is_mirror_predicate);
+    return ARGUMENT_OK;
+}
+
+//-----------------------------------------------------------------------------
+/// Compiles a where clause: <field>=<value>, <field>!=<value> or
+/// <field>~=<text>. Numeric fields are compared with numbers, so their
+/// operand is parsed here once
+bool Telnet_interface::_compile_list_predicate(List_target target, const Token& clause, List_predicate& predicate) {
+    const char* equals = (const char*)memchr(clause.data, '=', clause.length);
+    if (equals == nullptr) {
+        return false;
+    }
+
+    size_t name_length = equals - clause.data;
+    predicate.op = LIST_PREDICATE_EQUAL;
+    if (name_length > 0 && equals[-1] == '!') {
+        predicate.op = LIST_PREDICATE_NOT_EQUAL;
+        name_length--;
+    } else if (name_length > 0 && equals[-1] == '~') {
+        predicate.op = LIST_PREDICATE_CONTAINS;
+        name_length--;
+    }
+    if (!_resolve_list_field(target, clause.data, name_length, predicate.field)) {
+        return false;
+    }
+
+    Token operand;
+    operand.data = equals + 1;
+    operand.length = clause.data + clause.length - operand.data;
+
+    predicate.numeric = is_numeric_field(predicate.field);
+    predicate.number = 0;
+    if (predicate.numeric) {
+        return predicate.op != LIST_PREDICATE_CONTAINS && parse_number(operand, ARGUMENT_MAX_UINT64, predicate.number);
+    }
+
+    predicate.text.assign(operand.data, operand.length);
+    if (predicate.op == LIST_PREDICATE_CONTAINS) {
+        std::transform(predicate.text.begin(), predicate.text.end(), predicate.text.begin(), ascii_lower);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Resolves the name of a field to the property it reads. Fields are named
+/// like their property without the client_ or channel_ prefix, so
+/// TeamSpeak's own lookup decides which properties exist
+bool Telnet_interface::_resolve_list_field(List_target target, const char* name, size_t name_length, List_field& field) {
+    field.name.assign(name, name_length);
+    field.flag = 0;
+
+    // Fields which are not properties of their own
+    if (target == LIST_TARGET_CLIENTS && name_length == 7 && memcmp(name, "channel", 7) == 0) {
+        field.source = LIST_FIELD_CHANNEL;
+        return true;
+    }
+    if (target == LIST_TARGET_CHANNELS && name_length == 6 && memcmp(name, "parent", 6) == 0) {
+        field.source = LIST_FIELD_PARENT;
+        return true;
+    }
+
+    char property[PROPERTY_NAME_SIZE];
+    const char* prefix = target == LIST_TARGET_CLIENTS ? "client_" : "channel_";
+    size_t prefix_length = strlen(prefix);
+    if (name_length == 0 || prefix_length + name_length >= sizeof(property)) {
+        return false;
+    }
+    memcpy(property, prefix, prefix_length);
+    memcpy(property + prefix_length, name, name_length);
+    property[prefix_length + name_length] = '\0';
+
+    for (size_t i = 0; i < sizeof(LIST_FIELD_ALIASES) / sizeof(LIST_FIELD_ALIASES[0]); i++) {
+        if (LIST_FIELD_ALIASES[i].target == target && strlen(LIST_FIELD_ALIASES[i].name) == name_length && memcmp(LIST_FIELD_ALIASES[i].name, name, name_length) == 0) {
+            strcpy(property, LIST_FIELD_ALIASES[i].property);
+            break;
+        }
+    }
+
+    unsigned int error;
+    if (target == LIST_TARGET_CLIENTS) {
+        error = _ts3Functions.clientPropertyStringToFlag(property, &field.flag);
+        field.source = client_property_source(field.flag);
+    } else {
+        error = _ts3Functions.channelPropertyStringToFlag(property, &field.flag);
+        field.source = channel_property_source(field.flag);
+    }
+    return error == ERROR_ok;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads a field of a list entry. Values held by the mirror are taken from
+/// it, only the other properties are read from TeamSpeak. Negative numbers
+/// are returned as text, as numbers in the output are unsigned
+bool Telnet_interface::_read_list_field(uint64 server_connection_id, List_target target, const List_field& field, const List_entry& entry, List_value& value) {
+    switch (field.source) {
+    case LIST_FIELD_NAME:
+        value.numeric = false;
+        value.text = *entry.name;
+        return true;
+
+    case LIST_FIELD_CHANNEL:
+    case LIST_FIELD_PARENT:
+        value.numeric = true;
+        value.number = entry.parent_id;
+        return true;
+
+    case LIST_FIELD_STRING: {
+        char* text;
+        unsigned int error = target == LIST_TARGET_CLIENTS ?
+            _ts3Functions.getClientVariableAsString(server_connection_id, (anyID)entry.id, field.flag, &text) :
+            _ts3Functions.getChannelVariableAsString(server_connection_id, entry.id, field.flag, &text);
+        if (error != ERROR_ok) {
+            return false;
+        }
+        value.numeric = false;
+        value.text = text;
+        _ts3Functions.freeMemory(text);
+        return true;
+    }
+
+    case LIST_FIELD_INT: {
+        int number;
+        unsigned int error = target == LIST_TARGET_CLIENTS ?
+            _ts3Functions.getClientVariableAsInt(server_connection_id, (anyID)entry.id, field.flag, &number) :
+            _ts3Functions.getChannelVariableAsInt(server_connection_id, entry.id, field.flag, &number);
+        if (error != ERROR_ok) {
+            return false;
+        }
+        value.numeric = number >= 0;
+        if (value.numeric) {
+            value.number = (uint64)number;
+        } else {
+            value.text = std::to_string(number);
+        }
+        return true;
+    }
+
+    case LIST_FIELD_UINT64: {
+        unsigned int error = target == LIST_TARGET_CLIENTS ?
+            _ts3Functions.getClientVariableAsUInt64(server_connection_id, (anyID)entry.id, field.flag, &value.number) :
+            _ts3Functions.getChannelVariableAsUInt64(server_connection_id, entry.id, field.flag, &value.number);
+        value.numeric = true;
+        return error == ERROR_ok;
+    }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if a list entry matches all where clauses of a query. Entries
+/// whose compared property cannot be read don't match
+bool Telnet_interface::_matches_list_query(uint64 server_connection_id, List_target target, const List_query& query, const List_entry& entry, List_value& value) {
+    for (size_t i = 0; i < query.predicates.size(); i++) {
+        const List_predicate& predicate = query.predicates[i];
+        if (!_read_list_field(server_connection_id, target, predicate.field, entry, value)) {
+            return false;
+        }
+
+        bool match;
+        if (predicate.numeric) {
+            // Negative values never equal the unsigned operand
+            bool equal = value.numeric && value.number == predicate.number;
+            match = predicate.op == LIST_PREDICATE_EQUAL ? equal : !equal;
+        } else if (predicate.op == LIST_PREDICATE_CONTAINS) {
+            match = contains_ignore_case(value.text, predicate.text);
+        } else {
+            bool equal = value.text == predicate.text;
+            match = predicate.op == LIST_PREDICATE_EQUAL ? equal : !equal;
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Queues the requested fields of a channel or client as a list record.
+/// Properties which cannot be read are left out
+void Telnet_interface::_queue_list_record(Telnet_session& session, uint64 server_connection_id, List_target target, const List_query& query, List_mark mark, const char* change, const List_entry& entry, List_value& value) {
+    session.begin_list_record(mark, entry.id);
+    if (query.all_servers) {
+        session.queue_record_number("server", 6, server_connection_id);
+    }
+    if (change != nullptr) {
+        session.queue_record_string("change", 6, change, strlen(change));
+    }
+    for (size_t i = 0; i < query.fields.size(); i++) {
+        const List_field& field = query.fields[i];
+        if (!_read_list_field(server_connection_id, target, field, entry, value)) {
+            continue;
+        }
+        if (value.numeric) {
+            session.queue_record_number(field.name.c_str(), field.name.length(), value.number);
+        } else {
+            session.queue_record_string(field.name.c_str(), field.name.length(), value.text.c_str(), value.text.length());
+        }
+    }
+    session.end_list_record();
+}
+
+//-----------------------------------------------------------------------------
+/// Orders list entries by their ID
+static bool list_entry_less(const List_entry& a, const List_entry& b) {
+    return a.id < b.id;
+}
+
+/// The changes to an entry since a state version, folded into one
+struct Folded_change {
+    /// ID of the channel or client
+    uint64 id;
+
+    /// Set if the entry existed at the version, i.e. it was not added first
+    bool existed;
+
+    /// Latest change to the entry
+    Mirror_change_type last;
+};
+
+//-----------------------------------------------------------------------------
+/// Orders folded changes by the ID of their entry
+static bool folded_change_less(const Folded_change& a, const Folded_change& b) {
+    return a.id < b.id;
+}
+
+//-----------------------------------------------------------------------------
+/// Requests the name and parent of each entry if no fields were asked for
+void Telnet_interface::_add_default_list_fields(List_target target, List_query& query) {
+    if (!query.fields.empty()) {
+        return;
+    }
+
+    const char* name = target == LIST_TARGET_CHANNELS ? "name" : "nickname";
+    const char* parent = target == LIST_TARGET_CHANNELS ? "parent" : "channel";
+    List_field field;
+    if (_resolve_list_field(target, name, strlen(name), field)) {
+        query.fields.push_back(field);
+    }
+    if (_resolve_list_field(target, parent, strlen(parent), field)) {
+        query.fields.push_back(field);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the entries of all servers as one list in a single pass. The
+/// mirrors only change on this thread, so the list is consistent across
+/// the servers, and it goes out with the session's next flush. Entries are
+/// always records tagged with their server, with the name and parent if no
+/// fields were requested
+void Telnet_interface::_write_list_all_servers(Telnet_session& session, List_target target, List_query& query) {
+    _add_default_list_fields(target, query);
+    uint64 version = Server_mirror::get_current_version();
+
+    std::vector<uint64> server_ids;
+    for (std::unordered_map<uint64, Server_mirror*>::const_iterator it = _mirrors.begin(); it != _mirrors.end(); ++it) {
+        server_ids.push_back(it->first);
+    }
+    std::sort(server_ids.begin(), server_ids.end());
+
+    List_value value;
+    for (size_t i = 0; i < server_ids.size(); i++) {
+        uint64 server_connection_id = server_ids[i];
+        const Server_mirror* mirror = _find_mirror(server_connection_id);
+
+        _list_chunk.clear();
+        if (target == LIST_TARGET_CHANNELS) {
+            const std::vector<Mirror_channel>& channels = mirror->get_channels();
+            for (size_t j = 0; j < channels.size(); j++) {
+                List_entry entry = { channels[j].id, channels[j].parent_id, channels[j].name };
+                if (_matches_list_query(server_connection_id, target, query, entry, value)) {
+                    _list_chunk.push_back(entry);
+                }
+            }
+        } else {
+            const std::vector<Mirror_client>& clients = mirror->get_clients();
+            for (size_t j = 0; j < clients.size(); j++) {
+                List_entry entry = { clients[j].id, clients[j].channel_id, clients[j].name };
+                if (_matches_list_query(server_connection_id, target, query, entry, value)) {
+                    _list_chunk.push_back(entry);
+                }
+            }
+        }
+        std::sort(_list_chunk.begin(), _list_chunk.end(), list_entry_less);
+
+        bool active = server_connection_id == session.get_active_server_connection();
+        for (size_t j = 0; j < _list_chunk.size(); j++) {
+            const List_entry& entry = _list_chunk[j];
+            List_mark mark = LIST_MARK_NONE;
+            if (target == LIST_TARGET_CHANNELS) {
+                mark = active && session.get_active_server_channel() == entry.id ? LIST_MARK_SELECTED : LIST_MARK_UNSELECTED;
+            }
+            _queue_list_record(session, server_connection_id, target, query, mark, nullptr, entry, value);
+        }
+    }
+    _list_chunk.clear();
+    session.end_list(0, version);
+}
+
+//-----------------------------------------------------------------------------
+/// Answers a list command asking for the changes since a state version.
+/// Each entry changed since is listed once, as a record starting with the
+/// kind of change: "added" or "changed" with the requested fields, or
+/// "removed" without fields. Entries which no longer match the where
+/// clauses are listed as removed, as the client may hold them, and entries
+/// which came and went in between are left out
+void Telnet_interface::_write_list_changes(Telnet_session& session, const Token& command, const char* header, List_target target, List_query& query) {
+    std::vector<uint64> server_ids;
+    if (query.all_servers) {
+        for (std::unordered_map<uint64, Server_mirror*>::const_iterator it = _mirrors.begin(); it != _mirrors.end(); ++it) {
+            server_ids.push_back(it->first);
+        }
+        std::sort(server_ids.begin(), server_ids.end());
+    } else if (_find_mirror(session.get_active_server_connection()) != nullptr) {
+        server_ids.push_back(session.get_active_server_connection());
+    } else {
+        session.queue_reply(command.data, command.length, "fail. Server not connected");
+        return;
+    }
+
+    // Collect the changes of all servers before writing anything, so the
+    // command fails as a whole if any server cannot follow them back. A
+    // dropped server is only noticed by the lists spanning all servers
+    uint64 version = Server_mirror::get_current_version();
+    std::vector<Mirror_change> changes;
+    std::vector<size_t> server_ends;
+    bool available = !query.all_servers || query.since >= _mirror_dropped_version;
+    for (size_t i = 0; available && i < server_ids.size(); i++) {
+        available = _find_mirror(server_ids[i])->collect_changes(query.since, changes);
+        server_ends.push_back(changes.size());
+    }
+    if (!available) {
+        session.queue_reply(command.data, command.length, "fail. Changes no longer available, list again without since");
+        return;
+    }
+
+    _add_default_list_fields(target, query);
+    Mirror_entity entity = target == LIST_TARGET_CHANNELS ? MIRROR_ENTITY_CHANNEL : MIRROR_ENTITY_CLIENT;
+
+    session.begin_list(command.data, command.length, header);
+    List_value value;
+    std::vector<Folded_change> folded;
+    std::unordered_map<uint64, size_t> folded_index;
+    size_t first = 0;
+    for (size_t i = 0; i < server_ids.size(); i++) {
+        uint64 server_connection_id = server_ids[i];
+        const Server_mirror* mirror = _find_mirror(server_connection_id);
+
+        // Fold the changes of each entry into whether it existed before
+        // and whether it exists now
+        folded.clear();
+        folded_index.clear();
+        for (size_t j = first; j < server_ends[i]; j++) {
+            const Mirror_change& change = changes[j];
+            if (change.entity != entity) {
+                continue;
+            }
+            std::unordered_map<uint64, size_t>::iterator it = folded_index.find(change.id);
+            if (it == folded_index.end()) {
+                Folded_change entry = { change.id, change.type != MIRROR_CHANGE_ADDED, change.type };
+                folded_index[change.id] = folded.size();
+                folded.push_back(entry);
+            } else {
+                folded[it->second].last = change.type;
+            }
+        }
+        first = server_ends[i];
+        std::sort(folded.begin(), folded.end(), folded_change_less);
+
+        bool active = server_connection_id == session.get_active_server_connection();
+        for (size_t j = 0; j < folded.size(); j++) {
+            const Folded_change& change = folded[j];
+
+            List_entry entry = { change.id, 0, nullptr };
+            if (change.last != MIRROR_CHANGE_REMOVED) {
+                if (target == LIST_TARGET_CHANNELS) {
+                    const Mirror_channel* channel = mirror->find_channel(change.id);
+                    if (channel != nullptr) {
+                        entry.parent_id = channel->parent_id;
+                        entry.name = channel->name;
+                    }
+                } else {
+                    const Mirror_client* client = mirror->find_client((anyID)change.id);
+                    if (client != nullptr) {
+                        entry.parent_id = client->channel_id;
+                        entry.name = client->name;
+                    }
+                }
+            }
+            bool listed = entry.name != nullptr && _matches_list_query(server_connection_id, target, query, entry, value);
+            if (!listed && !change.existed) {
+                continue;
+            }
+
+            List_mark mark = LIST_MARK_NONE;
+            if (target == LIST_TARGET_CHANNELS) {
+                mark = active && session.get_active_server_channel() == change.id ? LIST_MARK_SELECTED : LIST_MARK_UNSELECTED;
+            }
+            if (listed) {
+                _queue_list_record(session, server_connection_id, target, query, mark, change.existed ? "changed" : "added", entry, value);
+            } else {
+                session.begin_list_record(mark, change.id);
+                if (query.all_servers) {
+                    session.queue_record_number("server", 6, server_connection_id);
+                }
+                session.queue_record_string("change", 6, "removed", 7);
+                session.end_list_record();
+            }
+        }
+    }
+    session.end_list(0, version);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts writing a list after its header. Small lists are written right
+/// away; larger ones are written in chunks, pausing whenever the session's
+/// output is congested, so the memory held per list does not grow with the
+/// size of the server
+void Telnet_interface::_start_list_stream(Telnet_session& session, List_target target, const List_query& query) {
+    List_stream* stream = new List_stream;
+    stream->target = target;
+    stream->query = query;
+    stream->server_connection_id = session.get_active_server_connection();
+    stream->remaining = query.limit != 0 ? query.limit : ARGUMENT_MAX_UINT64;
+    stream->version = Server_mirror::get_current_version();
+    _list_streams[&session] = stream;
+
+    _continue_list_stream(session);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes chunks of the list of a session until it is complete or the
+/// output is congested. Other output is held back while the list pauses
+bool Telnet_interface::_continue_list_stream(Telnet_session& session) {
+    std::unordered_map<Telnet_session*, List_stream*>::iterator it = _list_streams.find(&session);
+    if (it == _list_streams.end()) {
+        return true;
+    }
+
+    List_stream* stream = it->second;
+    bool complete = false;
+    while (!complete && !session.is_output_congested()) {
+        complete = _write_list_chunk(session, *stream);
+    }
+
+    if (!complete) {
+        session.hold_output();
+        return false;
+    }
+
+    _list_streams.erase(it);
+    delete stream;
+    session.release_held_output();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Continues a list once the client has caught up, then the commands
+/// received behind it. Keeps going while the socket takes everything, as a
+/// drained session is not selected for writing again
+bool Telnet_interface::_serve_list_stream(Telnet_session& session) {
+    bool connected = true;
+    while (connected && !session.is_output_congested() && _has_list_stream(&session)) {
+        if (_continue_list_stream(session)) {
+            connected = _parse_buffer(session);
+        }
+        if (connected) {
+            connected = session.flush();
+        }
+    }
+    return connected;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if a list of the session waits for its output to drain
+bool Telnet_interface::_has_list_stream(Telnet_session* session) const {
+    return !_list_streams.empty() && _list_streams.find(session) != _list_streams.end();
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the next chunk of a list: the matching entries with the smallest
+/// IDs following the cursor. The mirror may change between chunks, so each
+/// chunk starts afresh at the cursor, found in the mirror's sorted IDs
+bool Telnet_interface::_write_list_chunk(Telnet_session& session, List_stream& stream) {
+    const Server_mirror* mirror = _find_mirror(stream.server_connection_id);
+    if (mirror == nullptr) {
+        // The server is gone, the list ends with what was written so far
+        session.end_list(0, 0);
+        return true;
+    }
+
+    uint64 chunk_size = stream.remaining < LIST_CHUNK_ENTRIES ? stream.remaining : LIST_CHUNK_ENTRIES;
+
+    // Collect one entry more than is written, to tell if more follow
+    List_value value;
+    _list_chunk.clear();
+    if (stream.target == LIST_TARGET_CHANNELS) {
+        const std::vector<uint64>& ids = mirror->get_channel_ids();
+        std::vector<uint64>::const_iterator it = std::upper_bound(ids.begin(), ids.end(), stream.query.cursor);
+        for (; it != ids.end() && _list_chunk.size() <= chunk_size; ++it) {
+            const Mirror_channel* channel = mirror->find_channel(*it);
+            List_entry entry = { channel->id, channel->parent_id, channel->name };
+            if (_matches_list_query(stream.server_connection_id, stream.target, stream.query, entry, value)) {
+                _list_chunk.push_back(entry);
+            }
+        }
+    } else if (stream.query.cursor < 0xFFFF) {
+        // Client IDs are 16 bit, no client follows a larger cursor
+        const std::vector<anyID>& ids = mirror->get_client_ids();
+        std::vector<anyID>::const_iterator it = std::upper_bound(ids.begin(), ids.end(), (anyID)stream.query.cursor);
+        for (; it != ids.end() && _list_chunk.size() <= chunk_size; ++it) {
+            const Mirror_client* client = mirror->find_client(*it);
+            List_entry entry = { client->id, client->channel_id, client->name };
+            if (_matches_list_query(stream.server_connection_id, stream.target, stream.query, entry, value)) {
+                _list_chunk.push_back(entry);
+            }
+        }
+    }
+
+    bool more = _list_chunk.size() > chunk_size;
+    size_t count = more ? (size_t)chunk_size : _list_chunk.size();
+    for (size_t i = 0; i < count; i++) {
+        const List_entry& entry = _list_chunk[i];
+        List_mark mark = LIST_MARK_NONE;
+        if (stream.target == LIST_TARGET_CHANNELS) {
+            mark = session.get_active_server_channel() == entry.id ? LIST_MARK_SELECTED : LIST_MARK_UNSELECTED;
+        }
+
+        if (stream.query.fields.empty()) {
+            session.queue_list_entry(mark, entry.id, entry.name->c_str(), entry.name->length());
+        } else {
+            _queue_list_record(session, stream.server_connection_id, stream.target, stream.query, mark, nullptr, entry, value);
+        }
+        stream.query.cursor = entry.id;
+    }
+    stream.remaining -= count;
+
+    if (!more) {
+        session.end_list(0, stream.version);
+        return true;
+    }
+    if (stream.remaining == 0) {
+        // Cut short by the limit, the client continues after the cursor
+        session.end_list(stream.query.cursor, stream.version);
+        return true;
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Drops the pending list of a session, which is closed
+void Telnet_interface::_drop_list_stream(Telnet_session* session) {
+    std::unordered_map<Telnet_session*, List_stream*>::iterator it = _list_streams.find(session);
+    if (it != _list_streams.end()) {
+        delete it->second;
+        _list_streams.erase(it);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Sends a message to the active channel
+void Telnet_interface::_command_messaging_send_channel(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    _ts3Functions.logMessage("Found messages command", LogLevel_DEBUG, "TestPlugin", 0);
+
+    // The message is the remainder of the line
+    Token message = arguments.rest();
+
+    char return_code_buffer[RETURN_CODE_SIZE];
+    const char* return_code = _create_return_code(return_code_buffer, sizeof(return_code_buffer));
+    if (_evaluate_result(_ts3Functions.requestSendChannelTextMsg(session.get_active_server_connection(), message.data, session.get_active_server_channel(), return_code))) {
+        _ts3Functions.logMessage("Sent message to channel", LogLevel_DEBUG, "TestPlugin", 0);
+        _reply_request_sent(session, command, return_code);
+    } else {
+        _ts3Functions.logMessage("Could not send message to channel", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next argument as a client of the active server
+Argument_result Telnet_interface::_next_client(Telnet_session& session, Command_arguments& arguments, anyID& client_id) {
+    Token target;
+    Argument_result result = arguments.next(target);
+    if (result != ARGUMENT_OK) {
+        return result;
+    }
+
+    if (target.length > UID_PREFIX_LENGTH && strncmp(target.data, UID_PREFIX, UID_PREFIX_LENGTH) == 0) {
+        const Server_mirror* mirror = _find_mirror(session.get_active_server_connection());
+        if (mirror == nullptr) {
+            return ARGUMENT_INVALID;
+        }
+        const Mirror_client* client = mirror->find_client_by_uid(std::string(target.data + UID_PREFIX_LENGTH, target.length - UID_PREFIX_LENGTH));
+        if (client == nullptr) {
+            return ARGUMENT_INVALID;
+        }
+        client_id = client->id;
+        return ARGUMENT_OK;
+    }
+
+    uint64 number;
+    if (!parse_number(target, ARGUMENT_MAX_ANY_ID, number)) {
+        return ARGUMENT_INVALID;
+    }
+    client_id = (anyID)number;
+    return ARGUMENT_OK;
+}
+
+//-----------------------------------------------------------------------------
+/// Sends a private message to a user
+void Telnet_interface::_command_messaging_send_private(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    _ts3Functions.logMessage("Found messages command", LogLevel_DEBUG, "TestPlugin", 0);
+
+    anyID contact_id;
+    if (_next_client(session, arguments, contact_id) == ARGUMENT_OK) {
+        Token message = arguments.rest();
+
+        char return_code_buffer[RETURN_CODE_SIZE];
+        const char* return_code = _create_return_code(return_code_buffer, sizeof(return_code_buffer));
+        if (_evaluate_result(_ts3Functions.requestSendPrivateTextMsg(session.get_active_server_connection(), message.data, contact_id, return_code))) {
+            _ts3Functions.logMessage("Sent private message", LogLevel_DEBUG, "TestPlugin", 0);
+            _reply_request_sent(session, command, return_code);
+        } else {
+            _ts3Functions.logMessage("Could not send private message to user", LogLevel_INFO, "TestPlugin", 0);
+            session.queue_reply(command.data, command.length, "fail");
+        }
+    } else {
+        _ts3Functions.logMessage("Could not send private message to user", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Pokes a user
+void Telnet_interface::_command_messaging_send_poke(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    _ts3Functions.logMessage("Found messages command", LogLevel_DEBUG, "TestPlugin", 0);
+
+    anyID contact_id;
+    if (_next_client(session, arguments, contact_id) == ARGUMENT_OK) {
+        Token message = arguments.rest();
+
+        char return_code_buffer[RETURN_CODE_SIZE];
+        const char* return_code = _create_return_code(return_code_buffer, sizeof(return_code_buffer));
+        if (_evaluate_result(_ts3Functions.requestClientPoke(session.get_active_server_connection(), contact_id, message.data, return_code))) {
+            _ts3Functions.logMessage("User poked", LogLevel_DEBUG, "TestPlugin", 0);
+            _reply_request_sent(session, command, return_code);
+        } else {
+            _ts3Functions.logMessage("Could not send poke to user", LogLevel_INFO, "TestPlugin", 0);
+            session.queue_reply(command.data, command.length, "fail");
+        }
+    } else {
+        _ts3Functions.logMessage("Could not send poke to user", LogLevel_INFO, "TestPlugin", 0);
+        session.queue_reply(command.data, command.length, "fail");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the filter matching all notifications
+Event_filter Telnet_interface::_default_filter() {
+    Event_filter filter;
+    filter.types = NOTIFICATION_ALL;
+    filter.server_connection_id = 0;
+    filter.channel_id = 0;
+    filter.from_id = 0;
+    return filter;
+}
+
+//-----------------------------------------------------------------------------
+/// Parses the type and filters of a subscribe or unsubscribe command:
+/// <type[,type...]> [server=<id>] [channel=<id>] [from=<user_id>] [prefix=<text>]
+Argument_result Telnet_interface::_parse_event_filter(Command_arguments& arguments, Event_filter& filter) {
+    filter = _default_filter();
+    filter.types = 0;
+
+    Token types;
+    Argument_result result = arguments.next(types);
+    if (result != ARGUMENT_OK) {
+        return result;
+    }
+
+    // Comma separated list of type names
+    const char* type = types.data;
+    const char* types_end = types.data + types.length;
+    while (type < types_end) {
+        const char* type_end = (const char*)memchr(type, ',', types_end - type);
+        if (type_end == nullptr) {
+            type_end = types_end;
+        }
+
+        bool found = false;
+        size_t type_length = type_end - type;
+        for (size_t i = 0; i < sizeof(NOTIFICATION_TYPE_NAMES) / sizeof(NOTIFICATION_TYPE_NAMES[0]); i++) {
+            if (strlen(NOTIFICATION_TYPE_NAMES[i].name) == type_length && memcmp(NOTIFICATION_TYPE_NAMES[i].name, type, type_length) == 0) {
+                filter.types |= NOTIFICATION_TYPE_NAMES[i].types;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return ARGUMENT_INVALID;
+        }
+        type = type_end + 1;
+    }
+    if (filter.types == 0) {
+        return ARGUMENT_INVALID;
+    }
+
+    // Optional key=value filters
+    Token option;
+    while ((result = arguments.next(option)) == ARGUMENT_OK) {
+        const char* separator = (const char*)memchr(option.data, '=', option.length);
+        if (separator == nullptr) {
+            return ARGUMENT_INVALID;
+        }
+
+        size_t key_length = separator - option.data;
+        Token value;
+        value.data = separator + 1;
+        value.length = option.length - key_length - 1;
+
+        if (key_length == 6 && memcmp(option.data, "server", 6) == 0) {
+            if (!parse_number(value, ARGUMENT_MAX_UINT64, filter.server_connection_id)) {
+                return ARGUMENT_INVALID;
+            }
+        } else if (key_length == 7 && memcmp(option.data, "channel", 7) == 0) {
+            if (!parse_number(value, ARGUMENT_MAX_UINT64, filter.channel_id)) {
+                return ARGUMENT_INVALID;
+            }
+        } else if (key_length == 4 && memcmp(option.data, "from", 4) == 0) {
+            if (!parse_number(value, ARGUMENT_MAX_ANY_ID, filter.from_id)) {
+                return ARGUMENT_INVALID;
+            }
+        } else if (key_length == 6 && memcmp(option.data, "prefix", 6) == 0) {
+            filter.prefix.assign(value.data, value.length);
+        } else {
+            return ARGUMENT_INVALID;
+        }
+    }
+    return result == ARGUMENT_MISSING ? ARGUMENT_OK : ARGUMENT_INVALID;
+}
+
+//-----------------------------------------------------------------------------
+/// Subscribes the session to notifications matching a filter. A session
+/// receives a notification if any of its filters matches. The first
+/// subscribe of a session replaces the filter for all notifications it
+/// connected with, so it only receives what it asked for
+void Telnet_interface::_command_events_subscribe(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    Event_filter filter;
+    if (_parse_event_filter(arguments, filter) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. Invalid filter");
+        return;
+    }
+
+    if (session.has_default_filter()) {
+        _subscriptions.remove_session(&session);
+        session.set_default_filter(false);
+    }
+    _subscriptions.subscribe(&session, filter);
+    session.queue_reply(command.data, command.length, "ok");
+}
+
+//-----------------------------------------------------------------------------
+/// Removes a filter given exactly as it was subscribed, or all filters of
+/// the session if no filter is given
+void Telnet_interface::_command_events_unsubscribe(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    Event_filter filter;
+    Argument_result result = _parse_event_filter(arguments, filter);
+    if (result == ARGUMENT_MISSING) {
+        _subscriptions.remove_session(&session);
+        session.set_default_filter(false);
+        session.queue_reply(command.data, command.length, "ok");
+    } else if (result == ARGUMENT_INVALID) {
+        session.queue_reply(command.data, command.length, "fail. Invalid filter");
+    } else if (!_subscriptions.unsubscribe(&session, filter)) {
+        session.queue_reply(command.data, command.length, "fail. Not subscribed");
+    } else {
+        // While the session has its initial filter, that is the only one
+        session.set_default_filter(false);
+        session.queue_reply(command.data, command.length, "ok");
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Replays the notifications after the last one a client received, for
+/// clients which reconnect. Only notifications matching the session's
+/// current filters are replayed, so clients subscribe again first. The
+/// events are sent from the buffers encoded when they were delivered, in
+/// order, followed by the reply. Fails without replaying anything if some of the missed
+/// events are no longer kept. Update and talk notifications are not kept,
+/// clients list the state instead
+void Telnet_interface::_command_events_resume(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    Token token;
+    uint64 last_seq;
+    if (arguments.next(token) != ARGUMENT_OK || !parse_number(token, ARGUMENT_MAX_UINT64, last_seq) ||
+        last_seq > _event_log.get_last_seq()) {
+        session.queue_reply(command.data, command.length, "fail. Invalid sequence number");
+        return;
+    }
+
+    uint64 first_seq = _event_log.get_first_seq();
+    if (first_seq != 0 && last_seq + 1 < first_seq) {
+        std::ostringstream status;
+        status << "fail. Events lost, oldest available is " << first_seq;
+        session.queue_reply(command.data, command.length, status.str().c_str());
+        return;
+    }
+
+    Notification notification;
+    for (uint64 seq = last_seq + 1; seq <= _event_log.get_last_seq(); seq++) {
+        Logged_event* event = _event_log.find(seq);
+        _describe_event(*event, notification);
+        if (_subscriptions.accepts(&session, notification)) {
+            session.queue_shared(_encode_event(*event, session.get_format()));
+        }
+    }
+    session.queue_reply(command.data, command.length, "ok");
+}
+
+//-----------------------------------------------------------------------------
+/// Sets the window during which changes to a client or channel are merged
+/// into one update notification, if given, then lists the window and how
+/// many changes were merged so far. The window applies to all sessions, as
+/// the notifications are shared
+void Telnet_interface::_command_events_coalesce(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    Token token;
+    Argument_result result = arguments.next(token);
+    if (result == ARGUMENT_OK) {
+        uint64 window;
+        if (!parse_number(token, COALESCE_MAX_WINDOW, window)) {
+            session.queue_reply(command.data, command.length, "fail. Invalid window");
+            return;
+        }
+        _coalescer.set_window(window);
+    } else if (result != ARGUMENT_MISSING) {
+        session.queue_reply(command.data, command.length, "fail. Invalid window");
+        return;
+    }
+
+    session.begin_list(command.data, command.length, "Coalescing window in milliseconds and changes received and merged follow below");
+    session.begin_list_record(LIST_MARK_NONE, 0);
+    session.queue_record_number("window", 6, _coalescer.get_window());
+    session.queue_record_number("received", 8, _coalescer.get_received_count());
+    session.queue_record_number("absorbed", 8, _coalescer.get_absorbed_count());
+    session.end_list_record();
+    session.end_list(0, 0);
+}
+
+//-----------------------------------------------------------------------------
+/// Switches the format of the session's output. The reply is written in the
+/// previous format
+void Telnet_interface::_command_session_format(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    Token name;
+    if (arguments.next(name) != ARGUMENT_OK) {
+        session.queue_reply(command.data, command.length, "fail. No format specified");
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(SESSION_FORMAT_NAMES) / sizeof(SESSION_FORMAT_NAMES[0]); i++) {
+        if (strlen(SESSION_FORMAT_NAMES[i].name) == name.length && memcmp(SESSION_FORMAT_NAMES[i].name, name.data, name.length) == 0) {
+            session.queue_reply(command.data, command.length, "ok");
+            session.set_format(SESSION_FORMAT_NAMES[i].format);
+            return;
+        }
+    }
+    session.queue_reply(command.data, command.length, "fail. Unknown format");
+}
+
+//-----------------------------------------------------------------------------
+/// Switches the session to length prefixed binary frames, see
+/// Binary_encoder. Same as ts3.session.format binary: the reply is still
+/// written in the previous format, everything after it in both directions
+/// is framed
+void Telnet_interface::_command_session_binary(Telnet_session& session, const Token& command, Command_arguments& arguments) {
+    session.queue_reply(command.data, command.length, "ok");
+    session.set_format(SESSION_FORMAT_BINARY);
+}
@@ -5,6 +5,7 @@
 #include "telnet_if.h"
 #include "teamspeak/public_errors.h"
 
+#include <Windows.h>
 #include <ws2tcpip.h>
 #include <string>
 #include <fstream>
@@ -16,7 +17,22 @@ extern struct TS3Functions ts3Functions;
 const int TELNET_PORT = 23;
 const char* TELNET_PORT_STR = "23";
 
-const char* TEAMSPEAK_CMD_PREFIX = "ts3";
+/// Number of events which can be queued for the interface thread
+const size_t INTERFACE_EVENT_QUEUE_SIZE = 4096;
+
+/// Number of control events which can be queued for the interface thread
+const size_t CONTROL_EVENT_QUEUE_SIZE = 1024;
+
+/// Number of recent notifications kept for ts3.events.resume
+const size_t EVENT_LOG_SIZE = 1024;
+
+/// Bytes reserved for an encoded notification besides its name and text,
+/// enough for the headers and numbers of any format
+const size_t EVENT_ENCODING_OVERHEAD = 128;
+
+/// Milliseconds during which changes to a client or channel are merged
+/// into one update notification, until ts3.events.coalesce changes it
+const uint64 COALESCE_DEFAULT_WINDOW = 100;
 
 //-----------------------------------------------------------------------------
 /// Create instance if no instance exists yet
@@ -45,12 +61,16 @@ void Telnet_interface::destroy_instance() {
 //-----------------------------------------------------------------------------
 // Handle connection to server established
 void Telnet_interface::handle_server_connected(uint64 server_connection_id) {
-
+    // The interface thread reads the channels and clients, callbacks keep
+    // the mirror up to date from here on. A single event, so large servers
+    // don't flood the queue
+    Interface_event event;
+    event.type = INTERFACE_EVENT_SNAPSHOT_SERVER;
+    event.server_connection_id = server_connection_id;
+    _post_event(event);
 
     // Notify Client
-    std::ostringstream client_info_msg;
-    client_info_msg << "ts3.info Server " << server_connection_id << " connected";
-    _queue_write(client_info_msg.str());
+    _notify(NOTIFICATION_SERVER, server_connection_id, 0, 0, "", "connected");
 
 }
 
@@ -59,61 +79,152 @@ void Telnet_interface::handle_server_connected(uint64 server_connection_id) {
 void Telnet_interface::handle_server_connecting(uint64 server_connection_id) {
 
     // Notify Client
-    std::ostringstream client_info_msg;
-    client_info_msg << "ts3.info Server " << server_connection_id << " connecting";
-    _queue_write(client_info_msg.str());
+    _notify(NOTIFICATION_SERVER, server_connection_id, 0, 0, "", "connecting");
 }
 
 //-----------------------------------------------------------------------------
 // Handle connection to server terminated
 void Telnet_interface::handle_server_disconnected(uint64 server_connection_id) {
+    _post_mirror_update(MIRROR_UPDATE_REMOVE_SERVER, server_connection_id, 0, 0, 0, "");
+
     // Notify Client
-    std::ostringstream client_info_msg;
-    client_info_msg << "ts3.info Server " << server_connection_id << " disconnected";
-    _queue_write(client_info_msg.str());
+    _notify(NOTIFICATION_SERVER, server_connection_id, 0, 0, "", "disconnected");
+}
+
+//-----------------------------------------------------------------------------
+/// Handles a channel being created or changed. The channel is only marked,
+/// its state is read once however often it changes
+void Telnet_interface::handle_channel_changed(uint64 server_connection_id, uint64 channel_id) {
+    _post_entity_change(server_connection_id, MIRROR_ENTITY_CHANNEL, channel_id, false);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles a channel being deleted
+void Telnet_interface::handle_channel_deleted(uint64 server_connection_id, uint64 channel_id) {
+    _post_entity_change(server_connection_id, MIRROR_ENTITY_CHANNEL, channel_id, true);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles a client's properties being changed
+void Telnet_interface::handle_client_changed(uint64 server_connection_id, anyID client_id) {
+    _post_entity_change(server_connection_id, MIRROR_ENTITY_CLIENT, client_id, false);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles a client moving to another channel. The client is only marked,
+/// its channel and properties are read once however often it moves
+void Telnet_interface::handle_client_moved(uint64 server_connection_id, anyID client_id, uint64 new_channel_id) {
+    _post_entity_change(server_connection_id, MIRROR_ENTITY_CLIENT, client_id, new_channel_id == 0);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles the unique identifier of a client being reported
+void Telnet_interface::handle_client_identified(uint64 server_connection_id, anyID client_id, const char* uid) {
+    _post_mirror_update(MIRROR_UPDATE_IDENTITY, server_connection_id, client_id, 0, 0, uid);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles the database ID of a unique identifier being reported
+void Telnet_interface::handle_database_id(uint64 server_connection_id, const char* uid, uint64 database_id) {
+    _post_mirror_update(MIRROR_UPDATE_IDENTITY, server_connection_id, 0, database_id, 0, uid);
 }
 
 //-----------------------------------------------------------------------------
 /// Handles received text message
 void Telnet_interface::handle_private_text_message(uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message) {
-    std::ostringstream client_info_msg;
-    client_info_msg << "ts3.messaging.receive_private\r\n" <<
-        "\tServer: " << server_connection_id << "\r\n" <<
-        "\tFrom: " << from_name << " [" << fromID << "]\r\n" <<
-        message;
-    _queue_write(client_info_msg.str());
+    _notify_message(NOTIFICATION_PRIVATE, server_connection_id, fromID, from_name, message);
 }
 
 //-----------------------------------------------------------------------------
 /// Handles received text message
 void Telnet_interface::handle_channel_text_message(uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message) {
-    std::ostringstream client_info_msg;
-    client_info_msg << "ts3.messaging.receive_channel\r\n" <<
-        "\tServer: " << server_connection_id << "\r\n" <<
-        "\tFrom: " << from_name << " [" << fromID << "]\r\n" <<
-        message;
-    _queue_write(client_info_msg.str());
+    _notify_message(NOTIFICATION_CHANNEL, server_connection_id, fromID, from_name, message);
 }
 
 //-----------------------------------------------------------------------------
 /// Handles received text message
 void Telnet_interface::handle_poke(uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message) {
-    std::ostringstream client_info_msg;
-    client_info_msg << "ts3.messaging.receive_poke\r\n" <<
-        "\tServer: " << server_connection_id << "\r\n" <<
-        "\tFrom: " << from_name << " [" << fromID << "]\r\n" <<
-        message;
-    _queue_write(client_info_msg.str());
+    _notify_message(NOTIFICATION_POKE, server_connection_id, fromID, from_name, message);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles a client starting or stopping to talk. The client is sent by ID
+/// only, controllers resolve names from ts3.users.list
+void Telnet_interface::handle_talk_status(uint64 server_connection_id, anyID client_id, bool talking, bool whisper) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_NOTIFICATION;
+    event.notification_type = NOTIFICATION_TALK;
+    event.server_connection_id = server_connection_id;
+    event.channel_id = 0;
+    event.from_id = client_id;
+    event.talking = talking;
+    event.whisper = whisper;
+    event.timestamp = _monotonic_microseconds();
+    _post_event(event);
+}
+
+//-----------------------------------------------------------------------------
+/// Sets the ID registered for the plugin. The ID is handed to the interface
+/// thread, which creates the return codes
+void Telnet_interface::set_plugin_id(const char* plugin_id) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_PLUGIN_ID;
+    event.text = plugin_id;
+    _post_control_event(event);
+}
+
+//-----------------------------------------------------------------------------
+/// Handles the result of a request sent with a return code. Results have
+/// their own queue, as the session waits for each of them
+void Telnet_interface::handle_request_result(uint64 server_connection_id, const char* return_code, unsigned int error, const char* error_message) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_REQUEST_RESULT;
+    event.server_connection_id = server_connection_id;
+    event.text = return_code;
+    event.error = error;
+    event.error_message = error_message != nullptr ? error_message : "";
+    _post_control_event(event);
 }
 
 //-----------------------------------------------------------------------------
 /// Constructor
-Telnet_interface::Telnet_interface(const struct TS3Functions funcs) {
+Telnet_interface::Telnet_interface(const struct TS3Functions funcs) : _events(INTERFACE_EVENT_QUEUE_SIZE), _control_events(CONTROL_EVENT_QUEUE_SIZE), _event_log(EVENT_LOG_SIZE), _event_scratch(_slab_pool), _coalescer(COALESCE_DEFAULT_WINDOW) {
 
 	_state = TELNET_INTERFACE_STATE_IDLE;
     _server_socket = INVALID_SOCKET;
-    _client_socket = INVALID_SOCKET;
+    _wakeup_socket = INVALID_SOCKET;
+    _wsa_started = false;
+    _wakeup_pending = false;
+    _next_session_id = 1;
+    _next_request_id = 1;
+    _dropped_events = 0;
+    _lost_control_events = 0;
+    _mirror_dropped_version = 0;
+    for (size_t i = 0; i < SESSION_FORMAT_COUNT; i++) {
+        _unlogged_event.encoded[i] = nullptr;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    _counter_frequency = (uint64)frequency.QuadPart;
     _ts3Functions = funcs;
+
+    for (size_t i = 0; i < SESSION_FORMAT_COUNT; i++) {
+        _event_encoders[i] = Response_encoder::create((Session_format)i);
+    }
+
+    _build_command_table();
+    _snapshot_connected_servers(false);
+
+    // Winsock is needed for the wakeup socket in every state, not only
+    // while listening
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) == 0) {
+        _wsa_started = true;
+        _create_wakeup_socket();
+    } else {
+        _ts3Functions.logMessage("Error starting WSA", LogLevel_WARNING, "TestPlugin", 0);
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -124,27 +235,42 @@ Telnet_interface::~Telnet_interface() {
 	if (_state == TELNET_INTERFACE_STATE_LISTENING) {
 		closesocket(_server_socket);
 	} else if (_state == TELNET_INTERFACE_STATE_CONNECTED) {
-		closesocket(_client_socket);
+		_close_all_sessions();
 		closesocket(_server_socket);
 	}
+
+    if (_wakeup_socket != INVALID_SOCKET) {
+        closesocket(_wakeup_socket);
+    }
+    if (_wsa_started) {
+        WSACleanup();
+    }
+
+    for (std::unordered_map<uint64, Server_mirror*>::iterator it = _mirrors.begin(); it != _mirrors.end(); ++it) {
+        delete it->second;
+    }
+
+    for (size_t i = 0; i < SESSION_FORMAT_COUNT; i++) {
+        delete _event_encoders[i];
+    }
 }
 
 //-----------------------------------------------------------------------------
 /// Starts the server
 void Telnet_interface::event_listen() {
-    _pending_external_events.push_back(EXTERNAL_PLUGIN_EVENTS_LISTEN);
+    _post_external_event(EXTERNAL_PLUGIN_EVENTS_LISTEN);
 }
 
 //-----------------------------------------------------------------------------
 /// Closes the client and server connections
 void Telnet_interface::event_close() {
-    _pending_external_events.push_back(EXTERNAL_PLUGIN_EVENTS_CLOSE);
+    _post_external_event(EXTERNAL_PLUGIN_EVENTS_CLOSE);
 }
 
 //-----------------------------------------------------------------------------
 /// Closes all connections and gets ready to terminate
 void Telnet_interface::event_shutdown() {
-    _pending_external_events.push_back(EXTERNAL_PLUGIN_EVENTS_SHUTDOWN);
+    _post_external_event(EXTERNAL_PLUGIN_EVENTS_SHUTDOWN);
 }
 
 //-----------------------------------------------------------------------------
@@ -169,10 +295,12 @@ bool Telnet_interface::execution_complete() {
 }
 
 //-----------------------------------------------------------------------------
-/// Process external events
-void Telnet_interface::_process_events() {
-    while (!_pending_external_events.empty()) {
-        switch (*_pending_external_events.begin()) {
+/// Handles a queued event. Returns true if a notification was written to
+/// sessions
+bool Telnet_interface::_dispatch_event(const Interface_event& event) {
+    switch (event.type) {
+    case INTERFACE_EVENT_EXTERNAL:
+        switch (event.external_event) {
         case EXTERNAL_PLUGIN_EVENTS_LISTEN:  _handle_event_listen(); break;
         case EXTERNAL_PLUGIN_EVENTS_CLOSE:   _handle_event_close(); break;
         case EXTERNAL_PLUGIN_EVENTS_SHUTDOWN:_handle_event_shutdown(); break;
@@ -180,10 +308,378 @@ void Telnet_interface::_process_events() {
             // Unhandled event
             break;
         }
-        _pending_external_events.pop_front();
+        break;
+    case INTERFACE_EVENT_NOTIFICATION:
+        _deliver_notification(event);
+        return true;
+    case INTERFACE_EVENT_MIRROR_UPDATE:
+        _apply_mirror_update(event.mirror_update);
+        if (event.mirror_update.type == MIRROR_UPDATE_REMOVE_SERVER) {
+            _fail_server_requests(event.mirror_update.server_connection_id);
+        }
+        break;
+    case INTERFACE_EVENT_PLUGIN_ID:
+        _plugin_id = event.text;
+        break;
+    case INTERFACE_EVENT_REQUEST_RESULT:
+        _resolve_request(event);
+        break;
+    case INTERFACE_EVENT_SNAPSHOT_SERVER:
+        _load_server(event.server_connection_id, false);
+        break;
+    case INTERFACE_EVENT_ENTITY_CHANGED:
+        _coalescer.add(event.server_connection_id, event.entity, event.from_id, event.removed, _monotonic_microseconds() / 1000);
+        break;
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Processes the events queued by other threads. Records are handled in
+/// place and released to the producers afterwards
+void Telnet_interface::_process_events() {
+    bool notified = false;
+    Interface_event* event;
+    while ((event = _control_events.front()) != nullptr) {
+        notified |= _dispatch_event(*event);
+        _control_events.pop();
+    }
+    while ((event = _events.front()) != nullptr) {
+        notified |= _dispatch_event(*event);
+        _events.pop();
+    }
+
+    // Any tracked request may have lost its result, and waiting sessions
+    // would never hear of it
+    unsigned int lost = _lost_control_events.exchange(0);
+    if (lost > 0) {
+        std::ostringstream error_msg;
+        error_msg << lost << " control events dropped, control queue full";
+        _ts3Functions.logMessage(error_msg.str().c_str(), LogLevel_WARNING, "TestPlugin", 0);
+        _fail_all_requests("Result lost");
+    }
+
+    // Close the coalescing window once it has passed, reading the state of
+    // each entity changed in it once
+    if (!_coalescer.empty() && _monotonic_microseconds() / 1000 >= _coalescer.get_deadline()) {
+        _read_changed_entities();
+        _deliver_updates();
+        notified = true;
+    }
+
+    // Notifications are sent right away rather than once select reports
+    // the sockets writable, which would take another round
+    if (notified) {
+        _flush_sessions();
+    }
+
+    // Lost mirror updates leave the mirrors stale, so they are rebuilt
+    unsigned int dropped = _dropped_events.exchange(0);
+    if (dropped > 0) {
+        std::ostringstream error_msg;
+        error_msg << "ts3.error: " << dropped << " events dropped, event queue full";
+        _ts3Functions.logMessage(error_msg.str().c_str(), LogLevel_WARNING, "TestPlugin", 0);
+        for (size_t i = 0; i < _sessions.size(); i++) {
+            _sessions[i]->queue_write(error_msg.str());
+        }
+        _snapshot_connected_servers(true);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Logs a notification and writes it to the sessions subscribed to it. The
+/// notification is encoded once per format in use, and sessions reference
+/// the encoded buffer instead of copying it. Talk notifications are not
+/// logged for replay and carry sequence number 0, like updates, as they
+/// come in bursts and only matter while they are current
+void Telnet_interface::_deliver_notification(const Interface_event& event) {
+    bool talk = event.notification_type == NOTIFICATION_TALK;
+    if (talk && !_subscriptions.is_subscribed(NOTIFICATION_TALK)) {
+        return;
+    }
+
+    Logged_event& logged = talk ? _unlogged_event : _event_log.append();
+    if (talk) {
+        logged.seq = 0;
+    }
+    logged.type = event.notification_type;
+    logged.server_connection_id = event.server_connection_id;
+    logged.channel_id = event.channel_id;
+    logged.from_id = event.from_id;
+    logged.from_name = event.from_name;
+    logged.text = event.text;
+    logged.talking = event.talking;
+    logged.whisper = event.whisper;
+    logged.timestamp = event.timestamp;
+    logged.is_client = false;
+    logged.removed = false;
+    logged.parent_id = 0;
+    logged.absorbed = 0;
+
+    // Talk notifications are queued without any lookup on the audio
+    // thread, so the channel of the client is taken from the mirror, once
+    // a pending move of the client has been read
+    if (talk) {
+        if (_coalescer.is_unread(logged.server_connection_id, MIRROR_ENTITY_CLIENT, logged.from_id)) {
+            _read_changed_entities();
+        }
+        const Server_mirror* mirror = _find_mirror(logged.server_connection_id);
+        const Mirror_client* client = mirror != nullptr ? mirror->find_client((anyID)logged.from_id) : nullptr;
+        logged.channel_id = client != nullptr ? client->channel_id : 0;
+    }
+
+    _deliver_logged_event(logged);
+    if (talk) {
+        Event_log::release_encodings(logged);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Writes a logged event to the sessions subscribed to it
+void Telnet_interface::_deliver_logged_event(Logged_event& event) {
+    Notification notification;
+    _describe_event(event, notification);
+    _subscriptions.match(notification, _matched_sessions);
+
+    for (size_t i = 0; i < _matched_sessions.size(); i++) {
+        Telnet_session* session = _matched_sessions[i];
+        session->queue_shared(_encode_event(event, session->get_format()));
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Marks a client or channel as changed. May be called from any thread
+void Telnet_interface::_post_entity_change(uint64 server_connection_id, Mirror_entity entity, uint64 id, bool removed) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_ENTITY_CHANGED;
+    event.server_connection_id = server_connection_id;
+    event.from_id = id;
+    event.entity = entity;
+    event.removed = removed;
+    _post_event(event);
+}
+
+//-----------------------------------------------------------------------------
+/// Reads the state of the clients and channels marked as changed since it
+/// was last read, once per entity however often it changed, and applies it
+/// to the mirrors. Entities which are gone or can no longer be read are
+/// removed
+void Telnet_interface::_read_changed_entities() {
+    const std::vector<Coalesced_update>& changes = _coalescer.get_updates();
+    const std::vector<size_t>& unread = _coalescer.get_unread();
+    if (unread.empty()) {
+        return;
+    }
+
+    std::vector<Mirror_update> updates;
+    for (size_t i = 0; i < unread.size(); i++) {
+        const Coalesced_update& change = changes[unread[i]];
+        if (_find_mirror(change.server_connection_id) == nullptr) {
+            // Servers are only mirrored from their first snapshot on
+            continue;
+        }
+
+        bool read;
+        if (change.entity == MIRROR_ENTITY_CLIENT) {
+            read = !change.removed && _read_client(change.server_connection_id, (anyID)change.id, updates);
+        } else {
+            read = !change.removed && _read_channel(change.server_connection_id, change.id, updates);
+        }
+        if (!read) {
+            Mirror_update update;
+            update.type = change.entity == MIRROR_ENTITY_CLIENT ? MIRROR_UPDATE_REMOVE_CLIENT : MIRROR_UPDATE_REMOVE_CHANNEL;
+            update.server_connection_id = change.server_connection_id;
+            update.id = change.id;
+            update.parent_id = 0;
+            update.order = 0;
+            updates.push_back(update);
+        }
+    }
+    _coalescer.mark_read();
+
+    for (size_t i = 0; i < updates.size(); i++) {
+        _apply_mirror_update(updates[i]);
     }
 }
 
+//-----------------------------------------------------------------------------
+/// Marks the clients and channels which differ between the replaced and the
+/// new mirror of a server as changed. Only what update notifications show
+/// is compared, so entities changed meanwhile are reported and those gone
+/// meanwhile are reported removed
+void Telnet_interface::_coalesce_differences(uint64 server_connection_id, const Server_mirror& before, const Server_mirror& after) {
+    uint64 now = _monotonic_microseconds() / 1000;
+
+    const std::vector<Mirror_channel>& old_channels = before.get_channels();
+    for (size_t i = 0; i < old_channels.size(); i++) {
+        const Mirror_channel* channel = after.find_channel(old_channels[i].id);
+        if (channel == nullptr) {
+            _coalescer.add(server_connection_id, MIRROR_ENTITY_CHANNEL, old_channels[i].id, true, now);
+        } else if (channel->parent_id != old_channels[i].parent_id || *channel->name != *old_channels[i].name) {
+            _coalescer.add(server_connection_id, MIRROR_ENTITY_CHANNEL, channel->id, false, now);
+        }
+    }
+    const std::vector<Mirror_channel>& new_channels = after.get_channels();
+    for (size_t i = 0; i < new_channels.size(); i++) {
+        if (before.find_channel(new_channels[i].id) == nullptr) {
+            _coalescer.add(server_connection_id, MIRROR_ENTITY_CHANNEL, new_channels[i].id, false, now);
+        }
+    }
+
+    const std::vector<Mirror_client>& old_clients = before.get_clients();
+    for (size_t i = 0; i < old_clients.size(); i++) {
+        const Mirror_client* client = after.find_client(old_clients[i].id);
+        if (client == nullptr) {
+            _coalescer.add(server_connection_id, MIRROR_ENTITY_CLIENT, old_clients[i].id, true, now);
+        } else if (client->channel_id != old_clients[i].channel_id || *client->name != *old_clients[i].name) {
+            _coalescer.add(server_connection_id, MIRROR_ENTITY_CLIENT, client->id, false, now);
+        }
+    }
+    const std::vector<Mirror_client>& new_clients = after.get_clients();
+    for (size_t i = 0; i < new_clients.size(); i++) {
+        if (before.find_client(new_clients[i].id) == nullptr) {
+            _coalescer.add(server_connection_id, MIRROR_ENTITY_CLIENT, new_clients[i].id, false, now);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Sends an update notification for each client and channel changed during
+/// the coalescing window, with its state in the mirror. Entities of servers
+/// which were disconnected meanwhile are skipped, the server notification
+/// covers them. Updates are not logged for replay and carry sequence
+/// number 0, as a burst of them would push the messages out of the log
+void Telnet_interface::_deliver_updates() {
+    const std::vector<Coalesced_update>& updates = _coalescer.get_updates();
+    if (!_subscriptions.is_subscribed(NOTIFICATION_UPDATE)) {
+        _coalescer.clear();
+        return;
+    }
+
+    for (size_t i = 0; i < updates.size(); i++) {
+        const Coalesced_update& update = updates[i];
+        const Server_mirror* mirror = _find_mirror(update.server_connection_id);
+        if (mirror == nullptr) {
+            continue;
+        }
+
+        Logged_event& logged = _unlogged_event;
+        logged.seq = 0;
+        logged.type = NOTIFICATION_UPDATE;
+        logged.server_connection_id = update.server_connection_id;
+        logged.from_id = 0;
+        logged.channel_id = 0;
+        logged.from_name.clear();
+        logged.text.clear();
+        logged.talking = false;
+        logged.whisper = false;
+        logged.timestamp = 0;
+        logged.is_client = update.entity == MIRROR_ENTITY_CLIENT;
+        logged.removed = true;
+        logged.parent_id = 0;
+        logged.absorbed = update.absorbed;
+
+        // Filters match clients by sender and channel, channels by channel
+        if (logged.is_client) {
+            logged.from_id = update.id;
+            const Mirror_client* client = mirror->find_client((anyID)update.id);
+            if (client != nullptr) {
+                logged.removed = false;
+                logged.channel_id = client->channel_id;
+                logged.parent_id = client->channel_id;
+                logged.text = *client->name;
+            }
+        } else {
+            logged.channel_id = update.id;
+            const Mirror_channel* channel = mirror->find_channel(update.id);
+            if (channel != nullptr) {
+                logged.removed = false;
+                logged.parent_id = channel->parent_id;
+                logged.text = *channel->name;
+            }
+        }
+        _deliver_logged_event(logged);
+        Event_log::release_encodings(logged);
+    }
+    _coalescer.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Describes a logged event to the subscription filters
+void Telnet_interface::_describe_event(const Logged_event& event, Notification& notification) {
+    notification.type = event.type;
+    notification.server_connection_id = event.server_connection_id;
+    notification.channel_id = event.channel_id;
+    notification.from_id = event.from_id;
+
+    // Prefixes match the text of messages only
+    if (event.type == NOTIFICATION_SERVER || event.type == NOTIFICATION_TALK || event.type == NOTIFICATION_UPDATE) {
+        notification.message = "";
+        notification.message_length = 0;
+    } else {
+        notification.message = event.text.c_str();
+        notification.message_length = event.text.length();
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a logged event encoded in a format, encoding it on first use.
+/// The buffer is kept with the event, so replays don't encode it again.
+/// Events are encoded straight into the buffer, sized for the event's
+/// strings, so encoding takes a single pass and usually one allocation
+Shared_buffer* Telnet_interface::_encode_event(Logged_event& event, Session_format format) {
+    Shared_buffer*& encoded = event.encoded[format];
+    if (encoded == nullptr) {
+        encoded = Shared_buffer::create(event.from_name.size() + event.text.size() + EVENT_ENCODING_OVERHEAD);
+        _event_scratch.redirect(&encoded->get_bytes());
+
+        Response_encoder* encoder = _event_encoders[format];
+        if (event.type == NOTIFICATION_SERVER) {
+            encoder->server_event(_event_scratch, event.seq, event.server_connection_id, event.text.c_str());
+        } else if (event.type == NOTIFICATION_TALK) {
+            encoder->talk_event(_event_scratch, event.seq, event.server_connection_id, event.from_id, event.talking, event.whisper, event.timestamp);
+        } else if (event.type == NOTIFICATION_UPDATE) {
+            uint64 id = event.is_client ? event.from_id : event.channel_id;
+            encoder->update_event(_event_scratch, event.seq, event.server_connection_id, event.is_client, id, event.removed, event.parent_id, event.text, event.absorbed);
+        } else {
+            encoder->message_event(_event_scratch, event.seq, _message_event_name(event.type), event.server_connection_id, event.from_id, event.from_name, event.text);
+        }
+        _event_scratch.redirect(nullptr);
+    }
+    return encoded;
+}
+
+//-----------------------------------------------------------------------------
+/// Queues an event for the interface thread. May be called from any thread
+bool Telnet_interface::_post_event(const Interface_event& event) {
+    if (!_events.try_push(event)) {
+        _dropped_events++;
+        _signal_wakeup();
+        return false;
+    }
+    _signal_wakeup();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Queues an event on the control queue. Only a stalled interface thread
+/// lets it fill up, waiting for room could then deadlock against it
+void Telnet_interface::_post_control_event(const Interface_event& event) {
+    if (!_control_events.try_push(event)) {
+        _lost_control_events++;
+    }
+    _signal_wakeup();
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a listen, close or shutdown request
+void Telnet_interface::_post_external_event(External_plugin_events external_event) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_EXTERNAL;
+    event.external_event = external_event;
+    _post_control_event(event);
+}
+
 //-----------------------------------------------------------------------------
 // Listen event is handled. When in the IDLE state, a new server connection
 // is started
@@ -232,8 +728,14 @@ void Telnet_interface::_handle_event_listen() {
             return;
         }
 
-        // Listen on the socket
-        if (::listen(_server_socket, 1) == SOCKET_ERROR) {
+        freeaddrinfo(addrinfo_result);
+
+        // Connections are accepted from the reactor, which must never block
+        u_long non_blocking = 1;
+        ioctlsocket(_server_socket, FIONBIO, &non_blocking);
+
+        // Listen on the socket, allowing several controllers to connect at once
+        if (::listen(_server_socket, SOMAXCONN) == SOCKET_ERROR) {
             closesocket(_server_socket);
             WSACleanup();
             return;
@@ -257,7 +759,7 @@ void Telnet_interface::_handle_event_close() {
         WSACleanup();
         _change_state(TELNET_INTERFACE_STATE_IDLE);
     } else if (_state == TELNET_INTERFACE_STATE_CONNECTED) {
-        closesocket(_client_socket);
+        _close_all_sessions();
         closesocket(_server_socket);
         WSACleanup();
         _change_state(TELNET_INTERFACE_STATE_IDLE);
@@ -272,7 +774,7 @@ void Telnet_interface::_handle_event_shutdown() {
         closesocket(_server_socket);
         WSACleanup();
     } else if (_state == TELNET_INTERFACE_STATE_CONNECTED) {
-        closesocket(_client_socket);
+        _close_all_sessions();
         closesocket(_server_socket);
         WSACleanup();
     }
@@ -318,7 +820,6 @@ void Telnet_interface::_on_enter_TELNET_INTERFACE_STATE_LISTENING() {
 /// Enters the CONNECTED state
 void Telnet_interface::_on_enter_TELNET_INTERFACE_STATE_CONNECTED() {
     _ts3Functions.logMessage("Entering CONNECTED state", LogLevel_DEBUG, "TestPlugin", 0);
-    _queue_write("Welcome to the TeamSpeak 3 Client Telnet Interface");
 }
 
 //-----------------------------------------------------------------------------
@@ -328,80 +829,179 @@ void Telnet_interface::_on_enter_TELNET_INTERFACE_STATE_SHUTDOWN() {
 }
 
 //-----------------------------------------------------------------------------
-/// Runs the IDLE state
-void Telnet_interface::_run_TELNET_INTERFACE_STATE_IDLE() {}
-
-//-----------------------------------------------------------------------------
-/// Runs the LISTENING state
-void Telnet_interface::_run_TELNET_INTERFACE_STATE_LISTENING() {
-    timeval timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
-
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(_server_socket, &readfds);
+/// Runs the IDLE state - sleeps until an external event arrives
+void Telnet_interface::_run_TELNET_INTERFACE_STATE_IDLE() {
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
 
-    if (select(1, &readfds, NULL, NULL, &timeout) > 0) {
+    if (_wakeup_socket == INVALID_SOCKET) {
+        // No wakeup socket available, fall back to polling
+        Sleep(100);
+        return;
+    }
 
-        _client_socket = accept(_server_socket, NULL, NULL);
-        if (_client_socket == INVALID_SOCKET) {
-            _ts3Functions.logMessage("Invalid client socket, closing server socket", LogLevel_INFO, "TestPlugin", 0);
-            closesocket(_server_socket);
-            WSACleanup();
-        } else {
-            _ts3Functions.logMessage("Client socket connected!", LogLevel_INFO, "TestPlugin", 0);
-            _change_state(TELNET_INTERFACE_STATE_CONNECTED);
-        }
+    FD_SET(_wakeup_socket, &read_fds);
+    if (select((int)_wakeup_socket + 1, &read_fds, NULL, NULL, NULL) > 0) {
+        _drain_wakeup();
     }
 }
 
 //-----------------------------------------------------------------------------
-/// Runs the CONNECTED state
+/// Runs the LISTENING state - waits for the first session
+void Telnet_interface::_run_TELNET_INTERFACE_STATE_LISTENING() {
+    _run_reactor();
+}
+
+//-----------------------------------------------------------------------------
+/// Runs the CONNECTED state - serves all sessions
 void Telnet_interface::_run_TELNET_INTERFACE_STATE_CONNECTED() {
+    _run_reactor();
+}
+
+//-----------------------------------------------------------------------------
+/// Waits for socket readiness and serves the server and all sessions.
+/// A single select covers the server socket and every session, so idle
+/// sessions cost nothing but their slot in the descriptor set
+void Telnet_interface::_run_reactor() {
+    // Without a wakeup socket, poll so queued events are still picked up
     timeval timeout;
-    timeout.tv_sec = 1;
-    timeout.tv_usec = 0;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    timeval* timeout_ptr = &timeout;
 
     fd_set read_fds, write_fds;
     FD_ZERO(&read_fds);
     FD_ZERO(&write_fds);
-    FD_SET(_client_socket, &read_fds);
 
-    if (_write_stream.tellp() > _write_stream.tellg()) {
-        FD_SET(_client_socket, &write_fds);
+    SOCKET max_socket = _server_socket;
+    if (_wakeup_socket != INVALID_SOCKET) {
+        FD_SET(_wakeup_socket, &read_fds);
+        if (_wakeup_socket > max_socket) {
+            max_socket = _wakeup_socket;
+        }
+        timeout_ptr = NULL;
+    }
+
+    // Wake up to close the coalescing window
+    if (!_coalescer.empty()) {
+        uint64 now = _monotonic_microseconds() / 1000;
+        uint64 wait = _coalescer.get_deadline() > now ? _coalescer.get_deadline() - now : 0;
+        if (timeout_ptr == NULL || wait < 100) {
+            timeout.tv_sec = (long)(wait / 1000);
+            timeout.tv_usec = (long)(wait % 1000 * 1000);
+            timeout_ptr = &timeout;
+        }
+    }
+    if (_sessions.size() < FD_SETSIZE - 2) {
+        FD_SET(_server_socket, &read_fds);
+    }
+    for (size_t i = 0; i < _sessions.size(); i++) {
+        SOCKET socket = _sessions[i]->get_socket();
+        // Sessions waiting for a list to drain send no further commands
+        if (!_has_list_stream(_sessions[i])) {
+            FD_SET(socket, &read_fds);
+        }
+        if (_sessions[i]->has_pending_output()) {
+            FD_SET(socket, &write_fds);
+        }
+        if (socket > max_socket) {
+            max_socket = socket;
+        }
+    }
+
+    if (select((int)max_socket + 1, &read_fds, &write_fds, NULL, timeout_ptr) <= 0) {
+        return;
     }
 
-    if (select(1, &read_fds, &write_fds, NULL, &timeout) > 0) {
+    // Events and broadcasts are processed by the next call to execute
+    if (_wakeup_socket != INVALID_SOCKET && FD_ISSET(_wakeup_socket, &read_fds)) {
+        _drain_wakeup();
+    }
 
-        // Check if the client socket flag is set
-        if (FD_ISSET(_client_socket, &read_fds)) {
+    // Serve existing sessions first. Iterate backwards, so closed sessions
+    // can be removed in place
+    for (size_t i = _sessions.size(); i-- > 0;) {
+        Telnet_session* session = _sessions[i];
+        bool connected = true;
 
-            // Read data fom client
-            char buffer[100];
-            int bytes_received = recv(_client_socket, buffer, sizeof(buffer), 0);
-            if (bytes_received > 0) {
-                _ts3Functions.logMessage("Data received from client", LogLevel_DEBUG, "TestPlugin", 0);
-                _read_stream.write(buffer, bytes_received);
-                _parse_buffer();
+        if (FD_ISSET(session->get_socket(), &read_fds)) {
+            if (session->receive()) {
+                connected = _parse_buffer(*session);
             } else {
-                // Client has disconnected
                 _ts3Functions.logMessage("Client disconnected", LogLevel_INFO, "TestPlugin", 0);
-                closesocket(_client_socket);
-                _client_socket = INVALID_SOCKET;
-                _change_state(TELNET_INTERFACE_STATE_LISTENING);
+                connected = false;
             }
-        } else if (FD_ISSET(_client_socket, &write_fds)) {
-            // Data available for client - write
-            _ts3Functions.logMessage("Data available for client", LogLevel_DEBUG, "TestPlugin", 0);
-            int buffer_size = (int)(_write_stream.tellp() - _write_stream.tellg());
-            char* buffer = new char[buffer_size];
-            _write_stream.read(buffer, buffer_size);
-            int bytes_written = send(_client_socket, buffer, buffer_size, 0);
-            delete[] buffer;
         }
 
+        // Responses to the command just parsed are written right away
+        if (connected && session->has_pending_output()) {
+            connected = session->flush();
+        }
+
+        if (connected) {
+            connected = _serve_list_stream(*session);
+        }
+
+        if (!connected) {
+            _close_session(i);
+        }
+    }
+
+    if (FD_ISSET(_server_socket, &read_fds)) {
+        _accept_sessions();
+    }
+
+    // Keep the state in line with the number of connected sessions
+    if (_state == TELNET_INTERFACE_STATE_LISTENING && !_sessions.empty()) {
+        _change_state(TELNET_INTERFACE_STATE_CONNECTED);
+    } else if (_state == TELNET_INTERFACE_STATE_CONNECTED && _sessions.empty()) {
+        _change_state(TELNET_INTERFACE_STATE_LISTENING);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Accepts all pending connections on the server socket
+void Telnet_interface::_accept_sessions() {
+    while (_sessions.size() < FD_SETSIZE - 2) {
+        SOCKET client_socket = accept(_server_socket, NULL, NULL);
+        if (client_socket == INVALID_SOCKET) {
+            if (WSAGetLastError() != WSAEWOULDBLOCK) {
+                _ts3Functions.logMessage("Could not accept client socket", LogLevel_INFO, "TestPlugin", 0);
+            }
+            return;
+        }
+
+        _ts3Functions.logMessage("Client socket connected!", LogLevel_INFO, "TestPlugin", 0);
+        Telnet_session* session = new Telnet_session(client_socket, _next_session_id++, _slab_pool);
+        session->queue_write("Welcome to the TeamSpeak 3 Client Telnet Interface");
+        _sessions.push_back(session);
+
+        // New sessions receive all notifications until their first
+        // subscribe, which replaces this filter
+        _subscriptions.subscribe(session, _default_filter());
+        session->set_default_filter(true);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Closes and removes a session
+void Telnet_interface::_close_session(size_t index) {
+    _subscriptions.remove_session(_sessions[index]);
+    _drop_list_stream(_sessions[index]);
+    delete _sessions[index];
+    _sessions[index] = _sessions.back();
+    _sessions.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+/// Closes and removes all sessions
+void Telnet_interface::_close_all_sessions() {
+    for (size_t i = 0; i < _sessions.size(); i++) {
+        _subscriptions.remove_session(_sessions[i]);
+        _drop_list_stream(_sessions[i]);
+        delete _sessions[i];
     }
+    _sessions.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -433,423 +1033,427 @@ void Telnet_interface::_on_exit_TELNET_INTERFACE_STATE_SHUTDOWN() {
 }
 
 //-----------------------------------------------------------------------------
-/// Sends a list of supported command to the client
-void Telnet_interface::_send_usage_to_client() {
-    _queue_write("The TeamSpeak3 Telnet interface supports the following commands:");
-    _queue_write("ts3.servers.connect <hostname> <identity> <nickname> <*capture_profile> <*playback_profile> <*sound_profile>");
-    _queue_write("ts3.servers.disconnect <*server_id>");
-    _queue_write("ts3.servers.list");
-    _queue_write("ts3.servers.select <server_id>");
-    _queue_write("ts3.channels.list");
-    _queue_write("ts3.channels.select <channel_id> <password>");
-    _queue_write("ts3.users.list");
-    _queue_write("ts3.messaging.send_private <user_id> <message>");
-    _queue_write("ts3.messaging.send_channel <message>");
-    _queue_write("ts3.messaging.send_poke <user_id> <message>");
-    _queue_write("Optional parameters are marked with *");
-}
-
-//-----------------------------------------------------------------------------
-/// Parses the content of the received buffer
-void Telnet_interface::_parse_buffer() {
-    std::string line;
-
-    // Get the next line from the read buffer
-    std::getline(_read_stream, line);
-
-    // The command is epected to have the following syntax: <command> <param1> <param2> ... <paramx>
-    std::istringstream line_parser(line);
-
-    // The command is expected to have the following format: ts3.<category>.<action>
-    std::string command;
-    line_parser >> command;
-
-    std::istringstream command_parser(command);
-    std::string command_prefix;
-    std::getline(command_parser, command_prefix, '.');
-    
-    if (command_prefix == TEAMSPEAK_CMD_PREFIX) {
-        // Determine the category
-        std::string command_category;
-        std::getline(command_parser, command_category, '.');
-
-        // Determine the action
-        std::string command_action;
-        std::getline(command_parser, command_action, '.');
-
-        // Handle the specific command category
-        if (command_category == "identifier") {
-            // Due to limited functionality on the plugin API, it is not
-            // possible to add or remove new identities
-            _ts3Functions.logMessage("Found identifier command", LogLevel_DEBUG, "TestPlugin", 0);
-
-            if (command_action == "add") {
-                _queue_write(command + " fail. Not available, as API does not support identity management");
-            } else if (command_action == "remove") {
-                _queue_write(command + " fail. Not available, as API does not support identity management");
-            } else {
-                _queue_write(command + " is not a supported action");
-            }
+/// Parses all complete lines in the received buffer, so commands pipelined
+/// in a single packet are all executed right away. Returns false if the
+/// session has to be closed
+bool Telnet_interface::_parse_buffer(Telnet_session& session) {
+    char* line;
+    size_t length;
+    Line_framer_result result;
+    // Commands following a list which is written in chunks wait for it
+    while (!_has_list_stream(&session) && (result = session.next_command(line, length)) != LINE_FRAMER_NONE) {
+        if (result == LINE_FRAMER_LINE) {
+            // Commands see the changes marked so far, not only those of
+            // closed coalescing windows
+            _read_changed_entities();
+            _parse_line(session, line, length);
+        } else if (result == LINE_FRAMER_OVERFLOW) {
+            _ts3Functions.logMessage("Command line too long", LogLevel_INFO, "TestPlugin", 0);
+            session.queue_write("ts3.error: command line too long");
+        } else {
+            // The frames cannot be told apart any more
+            _ts3Functions.logMessage("Malformed frame received", LogLevel_INFO, "TestPlugin", 0);
+            session.queue_write("ts3.error: malformed frame");
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a notification for the sessions subscribed to it. TeamSpeak
+/// callbacks run on the client's threads, so the notification is handed
+/// over to the interface thread, which matches it against the subscriptions
+void Telnet_interface::_notify(Notification_type type, uint64 server_connection_id, uint64 channel_id, uint64 from_id, const char* from_name, const char* text) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_NOTIFICATION;
+    event.notification_type = type;
+    event.server_connection_id = server_connection_id;
+    event.channel_id = channel_id;
+    event.from_id = from_id;
+    event.from_name = from_name;
+    event.text = text;
+    event.talking = false;
+    event.whisper = false;
+    event.timestamp = 0;
+    _post_event(event);
+}
+
+//-----------------------------------------------------------------------------
+/// Formats and queues a received message
+void Telnet_interface::_notify_message(Notification_type type, uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message) {
+    // Filters match the channel the sender is in
+    uint64 channel_id = 0;
+    if (_ts3Functions.getChannelOfClient(server_connection_id, (anyID)fromID, &channel_id) != ERROR_ok) {
+        channel_id = 0;
+    }
+
+    _notify(type, server_connection_id, channel_id, fromID, from_name, message);
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the event name of a message notification
+const char* Telnet_interface::_message_event_name(Notification_type type) {
+    switch (type) {
+    case NOTIFICATION_PRIVATE: return "ts3.messaging.receive_private";
+    case NOTIFICATION_CHANNEL: return "ts3.messaging.receive_channel";
+    default:                   return "ts3.messaging.receive_poke";
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns a monotonic time in microseconds, from the performance counter
+uint64 Telnet_interface::_monotonic_microseconds() const {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion, so the multiplication can't overflow
+    uint64 ticks = (uint64)counter.QuadPart;
+    return ticks / _counter_frequency * 1000000 + ticks % _counter_frequency * 1000000 / _counter_frequency;
+}
 
+//-----------------------------------------------------------------------------
+/// Sends the output queued for all sessions, closing those whose connection
+/// failed. Iterate backwards, so closed sessions can be removed in place
+void Telnet_interface::_flush_sessions() {
+    for (size_t i = _sessions.size(); i-- > 0;) {
+        Telnet_session* session = _sessions[i];
+        bool connected = !session->has_pending_output() || session->flush();
+
+        // A list paused behind the notifications may be drained now. It has
+        // to continue here, as a session with a list is not selected for
+        // reading and one without output is not selected for writing
+        if (connected) {
+            connected = _serve_list_stream(*session);
         }
-        else if (command_category == "servers") {
-            // Handles the servers command category.
-            // Allows new connections and disconnecting from active connections
-            _ts3Functions.logMessage("Found servers command", LogLevel_DEBUG, "TestPlugin", 0);
-
-            // Establish a new connection
-            if (command_action == "connect") {
-                bool valid = true;
-                std::string host;
-                line_parser >> host;
-                valid &= !host.empty();
-
-                std::string identity;
-                line_parser >> identity;
-                valid &= !identity.empty();
-
-                std::string nickname;
-                line_parser >> nickname;
-                valid &= !nickname.empty();
-
-                std::string captureProfile;
-                line_parser >> captureProfile;
-                if (captureProfile.empty()) {
-                    captureProfile = "Default";
-                }
-
-                std::string playbackProfile;
-                line_parser >> playbackProfile;
-                if (playbackProfile.empty()) {
-                    playbackProfile = "Default";
-                }
-
-                std::string sound_profile;
-                line_parser >> sound_profile;
-                if (sound_profile.empty()) {
-                    sound_profile = "Default Sound Profile (Female)";
-                }
-
-                std::string server_password;
-                line_parser >> server_password;
-                
-
-                if (valid) {
-                    _ts3Functions.logMessage("Connecting...", LogLevel_DEBUG, "TestPlugin", 0);
-
-                    uint64 new_server_connection_handler_id = 0;
-
-                    // Start connection
-                    int connect_result = _ts3Functions.guiConnect(
-                        PLUGIN_CONNECT_TAB_NEW_IF_CURRENT_CONNECTED,
-                        "PluginServerTab",       // serverLabel
-                        host.c_str(),            // serverAddress
-                        server_password.c_str(), // serverPassword
-                        nickname.c_str(),        // nickname
-                        "",                      // channel
-                        "",                      // channelPassword
-                        captureProfile.c_str(),  // captureProfile
-                        playbackProfile.c_str(), // playbackProfile
-                        "Default",               // hotkeyProfile
-                        sound_profile.c_str(),   // soundProfile
-                        "",                      // userIdentity
-                        "",                      // oneTimeKey
-                        "",                      // phoneticName
-                        &new_server_connection_handler_id
-                        );
-
-                    if (_evaluate_result(connect_result)) {
-                        _queue_write(command + " ok");
-
-                        std::ostringstream client_info_msg;
-                        client_info_msg << "ts3.info New connection to server has ID " << new_server_connection_handler_id;
-                        _queue_write(client_info_msg.str());
-                    } else {
-                        _queue_write(command + " fail");
-                    }
-                } else {
-                    _ts3Functions.logMessage("servers.connect command is not valid", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail");
-                }
-
-            } else if (command_action == "disconnect") {
-                // Disconnect active server connection
-                std::string server_id_str;
-                line_parser >> server_id_str;
-
-                uint64 server_id = _active_server_connection;
-                if (!server_id_str.empty()) {
-                    server_id = atoi(server_id_str.c_str());
-                }
-
-                uint64* ids;
-                uint64 serverConnectionHandlerID = 0;
-                bool found = false;
-                if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
-                    for (int i = 0; ids[i]; i++) {
-                        if (ids[i] == server_id) {
-                            _ts3Functions.logMessage("Disconnecting...", LogLevel_DEBUG, "TestPlugin", 0);
-                            _ts3Functions.stopConnection(server_id, "Bye");
-                            _queue_write(command + " ok");
-                            found = true;
-                            break;
-                        }
-                    }
-                    _ts3Functions.freeMemory(ids);
-                }
-
-                if (!found) {
-                    _ts3Functions.logMessage("servers.disconnect does not name a valid server", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail. Unknown connection ID");
-                }
-
-            } else if (command_action == "list") {
-                // List managed connections
-                std::ostringstream response;
-                response << command << " Server connections follow below, selected server indicated with [*]\r\n";
-
-                uint64* ids;
-                uint64 serverConnectionHandlerID = 0;
-                char* server_name;
-                if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
-                    for (int i = 0; ids[i]; i++) {
-
-                        if (_evaluate_result(_ts3Functions.getServerVariableAsString(ids[i], VIRTUALSERVER_NAME, &server_name))) {
-
-                            if (_active_server_connection == ids[i]) {
-                                response << "[*] ";
-                            } else {
-                                response << "[ ] ";
-                            }
-                            response << ids[i] << ": ";
-                            response << server_name << "\r\n";
-                            _ts3Functions.freeMemory(server_name);
-                        }
-                    }
-                    _ts3Functions.freeMemory(ids);
-
-                    _queue_write(response.str());
-                }
-                
-
-            } else if (command_action == "select") {
-                // Disconnect active server connection
-                std::string server_id_str;
-                line_parser >> server_id_str;
-
-                uint64 server_id = _active_server_connection;
-                if (!server_id_str.empty()) {
-                    server_id = atoi(server_id_str.c_str());
-
-                    uint64* ids;
-                    uint64 serverConnectionHandlerID = 0;
-                    bool found = false;
-                    if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
-                        for (int i = 0; ids[i]; i++) {
-                            if (ids[i] == server_id) {
-                                _ts3Functions.logMessage("Selecting server", LogLevel_DEBUG, "TestPlugin", 0);
-                                _active_server_connection = server_id;
-                                _active_server_channel = 0;
-                                found = true;
-                                _queue_write(command + " ok");
-                                break;
-                            }
-                        }
-                        _ts3Functions.freeMemory(ids);
-                    }
-
-                    if (!found) {
-                        _ts3Functions.logMessage("Could not select server, invalid ID specified", LogLevel_INFO, "TestPlugin", 0);
-                        _queue_write(command + " fail. Unknown connection ID.");
-                    }
-                } else {
-                    _ts3Functions.logMessage("Could not select server, no ID specified", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail. ID not specified.");
-                }
 
-            } else {
-                _queue_write(command + " is not a supported action");
-            }
-        } else if (command_category == "channels") {
-
-            if (command_action == "list") {
-                // List channels on server
-                std::ostringstream response;
-                response << command << " Channels follow below, selected channel indicated with [*]\r\n";
-
-                uint64* ids;
-                uint64 serverConnectionHandlerID = 0;
-                char* channel_name;
-                if (_ts3Functions.getChannelList(_active_server_connection, &ids) == ERROR_ok) {
-                    for (int i = 0; ids[i]; i++) {
-
-                        if (_evaluate_result(_ts3Functions.getChannelVariableAsString(_active_server_connection, ids[i], CHANNEL_NAME, &channel_name))) {
-
-                            if (_active_server_channel == ids[i]) {
-                                response << "[*] ";
-                            } else {
-                                response << "[ ] ";
-                            }
-                            response << ids[i] << ": ";
-                            response << channel_name << "\r\n";
-                            _ts3Functions.freeMemory(channel_name);
-                        }
-                    }
-                    _ts3Functions.freeMemory(ids);
-
-                    _queue_write(response.str());
-                }
-            } else if (command_action == "select") {
-                std::string channel_id_str;
-                line_parser >> channel_id_str;
-
-                if (!channel_id_str.empty()) {
-
-                    uint64 channel_id = atoll(channel_id_str.c_str());
-
-                    std::string password;
-                    line_parser >> password;
-
-                    anyID myid;
-                    if (_evaluate_result(_ts3Functions.getClientID(_active_server_connection, &myid))) {  // Determine own ID
-                        if (_evaluate_result(_ts3Functions.requestClientMove(_active_server_connection, myid, channel_id, password.c_str(), NULL))) {
-                            _ts3Functions.logMessage("Channel selected", LogLevel_DEBUG, "TestPlugin", 0);
-                            _active_server_channel = channel_id;
-                            _queue_write(command + " ok");
-                        } else {
-                            _ts3Functions.logMessage("Could not select channel", LogLevel_INFO, "TestPlugin", 0);
-                            _queue_write(command + " fail");
-                        }
-                    } else {
-                        _ts3Functions.logMessage("Could not select channel", LogLevel_INFO, "TestPlugin", 0);
-                        _queue_write(command + " fail. Could not select");
-                    }
-                } else {
-                    _ts3Functions.logMessage("Could not select channel, no ID specified", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail. No channel specified");
-                }
-            } else {
-                _queue_write(command + " is not a supported action");
-            }
-        } else if (command_category == "users") {
-
-            if (command_action == "list") {
-                // List channels on server
-                std::ostringstream response;
-                response << command << " Users follow below\r\n";
-
-                anyID* ids;
-                uint64 serverConnectionHandlerID = 0;
-                char* user_name;
-                if (_ts3Functions.getClientList(_active_server_connection, &ids) == ERROR_ok) {
-                    for (int i = 0; ids[i]; i++) {
-
-                        if (_evaluate_result(_ts3Functions.getClientVariableAsString(_active_server_connection, ids[i], CLIENT_NICKNAME, &user_name))) {
-                            response << ids[i] << ": ";
-                            response << user_name << "\r\n";
-                            _ts3Functions.freeMemory(user_name);
-                        }
-                    }
-                    _ts3Functions.freeMemory(ids);
-
-                    _queue_write(response.str());
-                }
-            } else {
-                _queue_write(command + " is not a supported action");
-            }
-        } else if (command_category == "messaging") {
-            _ts3Functions.logMessage("Found messages command", LogLevel_DEBUG, "TestPlugin", 0);
-
-            if (command_action == "send_channel") {
-                std::string message;
-                std::getline(line_parser, message);
-                if (!message.empty()) {
-                    message.erase(0, 1); // Delete initial space
-                }
-
-                if (_evaluate_result(_ts3Functions.requestSendChannelTextMsg(_active_server_connection, message.c_str(), _active_server_channel, NULL))) {
-                    _ts3Functions.logMessage("Sent message to channel", LogLevel_DEBUG, "TestPlugin", 0);
-                    _queue_write(command + " ok");
-                } else {
-                    _ts3Functions.logMessage("Could not send message to channel", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail");
-                }
-
-            } else if (command_action == "send_private") {
-                std::string contact_id_str;
-                line_parser >> contact_id_str;
-
-                if (!contact_id_str.empty()) {
-                    anyID contact_id = atoi(contact_id_str.c_str());
-
-                    std::string message;
-                    std::getline(line_parser, message);
-                    if (!message.empty()) {
-                        message.erase(0, 1); // Delete initial space
-                    }
-
-                    if (_evaluate_result(_ts3Functions.requestSendPrivateTextMsg(_active_server_connection, message.c_str(), contact_id, NULL))) {
-                        _ts3Functions.logMessage("Sent private message", LogLevel_DEBUG, "TestPlugin", 0);
-                        _queue_write(command + " ok");
-                    } else {
-                        _ts3Functions.logMessage("Could not send private message to user", LogLevel_INFO, "TestPlugin", 0);
-                        _queue_write(command + " fail");
-                    }
-                } else {
-                    _ts3Functions.logMessage("Could not send private message to user", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail");
-                }
-
-            } else if (command_action == "send_poke") {
-                std::string contact_id_str;
-                line_parser >> contact_id_str;
-
-                if (!contact_id_str.empty()) {
-                    anyID contact_id = atoi(contact_id_str.c_str());
-
-                    std::string message;
-                    std::getline(line_parser, message);
-                    if (!message.empty()) {
-                        message.erase(0, 1); // Delete initial space
-                    }
-
-                    if (_evaluate_result(_ts3Functions.requestClientPoke(_active_server_connection, contact_id, message.c_str(), NULL))) {
-                        _ts3Functions.logMessage("User poked", LogLevel_DEBUG, "TestPlugin", 0);
-                        _queue_write(command + " ok");
-                    } else {
-                        _ts3Functions.logMessage("Could not send poke to user", LogLevel_INFO, "TestPlugin", 0);
-                        _queue_write(command + " fail");
-                    }
-                } else {
-                    _ts3Functions.logMessage("Could not send poke to user", LogLevel_INFO, "TestPlugin", 0);
-                    _queue_write(command + " fail");
-                }
-            } else {
-                _queue_write(command + " is not a supported action");
+        if (!connected) {
+            _ts3Functions.logMessage("Client disconnected", LogLevel_INFO, "TestPlugin", 0);
+            _close_session(i);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Reads the channels and clients of a server, producing the updates which
+/// replace its mirror
+void Telnet_interface::_snapshot_server(uint64 server_connection_id, std::vector<Mirror_update>& updates) {
+    Mirror_update update;
+    update.type = MIRROR_UPDATE_RESET;
+    update.server_connection_id = server_connection_id;
+    update.id = 0;
+    update.parent_id = 0;
+    update.order = 0;
+    updates.push_back(update);
+
+    uint64* channel_ids;
+    if (_ts3Functions.getChannelList(server_connection_id, &channel_ids) == ERROR_ok) {
+        for (int i = 0; channel_ids[i]; i++) {
+            _read_channel(server_connection_id, channel_ids[i], updates);
+        }
+        _ts3Functions.freeMemory(channel_ids);
+    }
+
+    anyID* client_ids;
+    if (_ts3Functions.getClientList(server_connection_id, &client_ids) == ERROR_ok) {
+        for (int i = 0; client_ids[i]; i++) {
+            _read_client(server_connection_id, client_ids[i], updates);
+        }
+        _ts3Functions.freeMemory(client_ids);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Reads a channel, producing the update which sets it in the mirror
+bool Telnet_interface::_read_channel(uint64 server_connection_id, uint64 channel_id, std::vector<Mirror_update>& updates) {
+    Mirror_update update;
+    update.type = MIRROR_UPDATE_CHANNEL;
+    update.server_connection_id = server_connection_id;
+    update.id = channel_id;
+
+    char* channel_name;
+    if (_ts3Functions.getParentChannelOfChannel(server_connection_id, channel_id, &update.parent_id) != ERROR_ok ||
+        _ts3Functions.getChannelVariableAsUInt64(server_connection_id, channel_id, CHANNEL_ORDER, &update.order) != ERROR_ok ||
+        _ts3Functions.getChannelVariableAsString(server_connection_id, channel_id, CHANNEL_NAME, &channel_name) != ERROR_ok) {
+        return false;
+    }
+    update.name = channel_name;
+    updates.push_back(update);
+    _ts3Functions.freeMemory(channel_name);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads a client, producing the updates which set it and its identity in
+/// the mirror
+bool Telnet_interface::_read_client(uint64 server_connection_id, anyID client_id, std::vector<Mirror_update>& updates) {
+    Mirror_update update;
+    update.type = MIRROR_UPDATE_CLIENT;
+    update.server_connection_id = server_connection_id;
+    update.id = client_id;
+    update.order = 0;
+
+    char* client_name;
+    if (_ts3Functions.getChannelOfClient(server_connection_id, client_id, &update.parent_id) != ERROR_ok ||
+        _ts3Functions.getClientVariableAsString(server_connection_id, client_id, CLIENT_NICKNAME, &client_name) != ERROR_ok) {
+        return false;
+    }
+    update.name = client_name;
+    updates.push_back(update);
+    _ts3Functions.freeMemory(client_name);
+
+    char* uid;
+    if (_ts3Functions.getClientVariableAsString(server_connection_id, client_id, CLIENT_UNIQUE_IDENTIFIER, &uid) == ERROR_ok) {
+        update.type = MIRROR_UPDATE_IDENTITY;
+        update.parent_id = 0;
+        update.name = uid;
+        updates.push_back(update);
+        _ts3Functions.freeMemory(uid);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+/// Snapshots all servers which are connected already, e.g. when the plugin
+/// is loaded while the client is connected, or after updates were lost.
+/// In the latter case, what changed while updates were lost is reported
+void Telnet_interface::_snapshot_connected_servers(bool report_changes) {
+    uint64* ids;
+    if (_ts3Functions.getServerConnectionHandlerList(&ids) == ERROR_ok) {
+        for (int i = 0; ids[i]; i++) {
+            int status;
+            if (_ts3Functions.getConnectionStatus(ids[i], &status) == ERROR_ok && status == STATUS_CONNECTION_ESTABLISHED) {
+                _load_server(ids[i], report_changes);
             }
+        }
+        _ts3Functions.freeMemory(ids);
+    }
+}
 
-        } else {
-            std::string error_str = "ts3.error: ";
-            error_str.append(command_action + ": " + command_category + " is not a supported category");
-            _queue_write(error_str);
+//-----------------------------------------------------------------------------
+/// Replaces the mirror of a server with a snapshot, read on the interface
+/// thread. Changes marked behind the snapshot event are read again, which
+/// repeats what the snapshot already holds. Snapshots of newly connected
+/// servers are not reported, the server notification covers them
+void Telnet_interface::_load_server(uint64 server_connection_id, bool report_changes) {
+    std::vector<Mirror_update> updates;
+    _snapshot_server(server_connection_id, updates);
+
+    // Keep the replaced mirror to compare against, only as long as someone
+    // listens
+    Server_mirror* before = nullptr;
+    std::unordered_map<uint64, Server_mirror*>::iterator it = _mirrors.find(server_connection_id);
+    if (report_changes && it != _mirrors.end() && _subscriptions.is_subscribed(NOTIFICATION_UPDATE)) {
+        before = it->second;
+        _mirrors.erase(it);
+    }
+
+    for (size_t i = 0; i < updates.size(); i++) {
+        _apply_mirror_update(updates[i]);
+    }
+
+    // The snapshot holds the latest state of every entity marked so far
+    _coalescer.mark_read(server_connection_id);
+    if (before != nullptr) {
+        _coalesce_differences(server_connection_id, *before, *_find_mirror(server_connection_id));
+        _coalescer.mark_read(server_connection_id);
+        delete before;
+    }
+}
 
-            _send_usage_to_client();
+//-----------------------------------------------------------------------------
+/// Queues a mirror update. May be called from any thread
+void Telnet_interface::_post_mirror_update(Mirror_update_type type, uint64 server_connection_id, uint64 id, uint64 parent_id, uint64 order, const char* name) {
+    Interface_event event;
+    event.type = INTERFACE_EVENT_MIRROR_UPDATE;
+    event.mirror_update.type = type;
+    event.mirror_update.server_connection_id = server_connection_id;
+    event.mirror_update.id = id;
+    event.mirror_update.parent_id = parent_id;
+    event.mirror_update.order = order;
+    event.mirror_update.name = name;
+    _post_event(event);
+}
+
+//-----------------------------------------------------------------------------
+/// Applies a mirror update
+void Telnet_interface::_apply_mirror_update(const Mirror_update& update) {
+    std::unordered_map<uint64, Server_mirror*>::iterator mirror = _mirrors.find(update.server_connection_id);
+
+    if (update.type == MIRROR_UPDATE_REMOVE_SERVER) {
+        if (mirror != _mirrors.end()) {
+            delete mirror->second;
+            _mirrors.erase(mirror);
+            _mirror_dropped_version = Server_mirror::advance_version();
         }
-    } else if (!command_prefix.empty()) {
-        _send_usage_to_client();
+    } else if (mirror != _mirrors.end()) {
+        mirror->second->apply(update);
+    } else if (update.type == MIRROR_UPDATE_RESET) {
+        // Servers are only mirrored from their first snapshot on, so
+        // updates racing ahead of it are dropped
+        _mirrors[update.server_connection_id] = new Server_mirror();
     }
-    if (!_read_stream.good()) {
-        _read_stream.clear();
-        _read_stream.str("");
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the mirror of a server connection
+const Server_mirror* Telnet_interface::_find_mirror(uint64 server_connection_id) const {
+    std::unordered_map<uint64, Server_mirror*>::const_iterator it = _mirrors.find(server_connection_id);
+    if (it == _mirrors.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+//-----------------------------------------------------------------------------
+/// Creates a return code for a request
+const char* Telnet_interface::_create_return_code(char* return_code, size_t size) {
+    if (_plugin_id.empty()) {
+        return nullptr;
     }
+    _ts3Functions.createReturnCode(_plugin_id.c_str(), return_code, size);
+    return return_code;
 }
 
 //-----------------------------------------------------------------------------
-/// Queues data for the client
-void Telnet_interface::_queue_write(std::string response) {
-    _write_stream.write(">", 1);
-    _write_stream.write(response.c_str(), response.length());
-    _write_stream.write("\r\n", 2);
+/// Replies to a command whose request was sent
+void Telnet_interface::_reply_request_sent(Telnet_session& session, const Token& command, const char* return_code) {
+    if (return_code == nullptr) {
+        session.queue_reply(command.data, command.length, "ok");
+        return;
+    }
+
+    Pending_request& request = _pending_requests[return_code];
+    request.session_id = session.get_id();
+    request.server_connection_id = session.get_active_server_connection();
+    request.request_id = _next_request_id++;
+
+    // The command was dispatched through the table, so the list holds its
+    // name and the request needn't copy it
+    request.command = _commands[_command_table.find(command.data, command.length)].name;
+    request.tag = session.get_reply_tag();
+
+    session.queue_request_status(command.data, command.length, "ok", request.request_id, nullptr);
+}
+
+//-----------------------------------------------------------------------------
+/// Reports the result of a tracked request to the session which sent it.
+/// Results of requests whose session is closed are discarded
+void Telnet_interface::_resolve_request(const Interface_event& event) {
+    std::unordered_map<std::string, Pending_request>::iterator it = _pending_requests.find(event.text);
+    if (it == _pending_requests.end()) {
+        return;
+    }
+
+    if (event.error == ERROR_ok) {
+        _reply_request_result(it->second, "done", nullptr);
+    } else {
+        _reply_request_result(it->second, "failed", event.error_message.c_str());
+    }
+    _pending_requests.erase(it);
+}
+
+//-----------------------------------------------------------------------------
+/// Fails all tracked requests of a server connection which is gone, as no
+/// result will arrive for them
+void Telnet_interface::_fail_server_requests(uint64 server_connection_id) {
+    std::unordered_map<std::string, Pending_request>::iterator it = _pending_requests.begin();
+    while (it != _pending_requests.end()) {
+        if (it->second.server_connection_id != server_connection_id) {
+            ++it;
+            continue;
+        }
+
+        _reply_request_result(it->second, "failed", "Server disconnected");
+        it = _pending_requests.erase(it);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Fails all tracked requests, after request results were lost. Results
+/// still arriving for them are ignored
+void Telnet_interface::_fail_all_requests(const char* reason) {
+    for (std::unordered_map<std::string, Pending_request>::iterator it = _pending_requests.begin(); it != _pending_requests.end(); ++it) {
+        _reply_request_result(it->second, "failed", reason);
+    }
+    _pending_requests.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Writes the result line of a tracked request
+void Telnet_interface::_reply_request_result(const Pending_request& request, const char* status, const char* reason) {
+    Telnet_session* session = _find_session(request.session_id);
+    if (session == nullptr) {
+        return;
+    }
+
+    session->set_reply_tag(request.tag.c_str(), request.tag.length());
+    session->queue_request_status(request.command, strlen(request.command), status, request.request_id, reason);
+    session->clear_reply_tag();
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the session with the given ID
+Telnet_session* Telnet_interface::_find_session(uint64 session_id) {
+    for (size_t i = 0; i < _sessions.size(); i++) {
+        if (_sessions[i]->get_id() == session_id) {
+            return _sessions[i];
+        }
+    }
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+/// Creates the wakeup socket: a loopback UDP socket connected to itself,
+/// which lets other threads interrupt the select of the interface thread
+void Telnet_interface::_create_wakeup_socket() {
+    sockaddr_in address;
+    int address_length = sizeof(address);
+    ZeroMemory(&address, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    _wakeup_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (_wakeup_socket == INVALID_SOCKET) {
+        _ts3Functions.logMessage("Could not create wakeup socket", LogLevel_WARNING, "TestPlugin", 0);
+        return;
+    }
+
+    if (bind(_wakeup_socket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR ||
+        getsockname(_wakeup_socket, (sockaddr*)&address, (socklen_t*)&address_length) == SOCKET_ERROR ||
+        connect(_wakeup_socket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR) {
+        _ts3Functions.logMessage("Could not bind wakeup socket", LogLevel_WARNING, "TestPlugin", 0);
+        closesocket(_wakeup_socket);
+        _wakeup_socket = INVALID_SOCKET;
+        return;
+    }
+
+    u_long non_blocking = 1;
+    ioctlsocket(_wakeup_socket, FIONBIO, &non_blocking);
+}
+
+//-----------------------------------------------------------------------------
+/// Wakes up the interface thread. May be called from any thread; signals
+/// raised before the interface thread wakes up are coalesced into one
+void Telnet_interface::_signal_wakeup() {
+    if (_wakeup_socket != INVALID_SOCKET && !_wakeup_pending.exchange(true)) {
+        send(_wakeup_socket, "", 1, 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Consumes pending wakeup signals
+void Telnet_interface::_drain_wakeup() {
+    char buffer[64];
+    while (recv(_wakeup_socket, buffer, sizeof(buffer), 0) > 0) {
+    }
+
+    // Clear the flag only once the socket is empty. A producer signalling
+    // while draining would otherwise leave the flag set without a datagram
+    // in flight, and no later signal would wake the thread. Events queued
+    // before the clear are processed by the next execute anyway
+    _wakeup_pending = false;
 }
 
 //-----------------------------------------------------------------------------
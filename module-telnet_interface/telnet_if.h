@@ -8,9 +8,19 @@
 #include <WinSock2.h>
 #include <sstream>
 #include <map>
-#include <list>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
 
 #include "ts3_functions.h"
+#include "telnet_session.h"
+#include "command_table.h"
+#include "command_arguments.h"
+#include "server_mirror.h"
+#include "mpsc_ring.h"
+#include "subscription_table.h"
+#include "event_log.h"
+#include "update_coalescer.h"
 
 /// States of the interface
 enum Telnet_interface_state {
@@ -27,6 +37,216 @@ enum External_plugin_events {
     EXTERNAL_PLUGIN_EVENTS_SHUTDOWN
 };
 
+/// Kinds of records passed to the interface thread
+enum Interface_event_type {
+    INTERFACE_EVENT_EXTERNAL,       // A listen, close or shutdown request
+    INTERFACE_EVENT_NOTIFICATION,   // A notification for subscribed sessions
+    INTERFACE_EVENT_MIRROR_UPDATE,  // A change to a server mirror
+    INTERFACE_EVENT_PLUGIN_ID,      // The ID registered for the plugin
+    INTERFACE_EVENT_REQUEST_RESULT, // The server answered a tracked request
+    INTERFACE_EVENT_SNAPSHOT_SERVER,// A server connected and is to be mirrored
+    INTERFACE_EVENT_ENTITY_CHANGED  // A client or channel changed, its state is read later
+};
+
+/// A record passed from other threads to the interface thread
+struct Interface_event {
+    /// Kind of record
+    Interface_event_type type;
+
+    /// Request, for external events
+    External_plugin_events external_event;
+
+    /// Kind of notification, for notifications
+    Notification_type notification_type;
+
+    /// Server connection, channel of the sender and sender of a
+    /// notification, 0 where not applicable
+    uint64 server_connection_id;
+    uint64 channel_id;
+    uint64 from_id;
+
+    /// Name of the sender of a notification
+    std::string from_name;
+
+    /// Message or server state of a notification, the plugin ID, or the
+    /// return code of a request result
+    std::string text;
+
+    /// Change to apply, for mirror updates
+    Mirror_update mirror_update;
+
+    /// Error code and message, for request results
+    unsigned int error;
+    std::string error_message;
+
+    /// Talk status of a talk notification: whether the client talks, and
+    /// whether it is a whisper to us
+    bool talking;
+    bool whisper;
+
+    /// Monotonic time of a talk notification in microseconds
+    uint64 timestamp;
+
+    /// Kind of entity changed and whether it is gone, for entity changes.
+    /// The ID of the client or channel is in from_id
+    Mirror_entity entity;
+    bool removed;
+};
+
+/// A request sent to the server with a return code, awaiting its result
+struct Pending_request {
+    /// Session which issued the command
+    uint64 session_id;
+
+    /// Server connection the request was sent to
+    uint64 server_connection_id;
+
+    /// Number identifying the request towards the session
+    uint64 request_id;
+
+    /// Command which sent the request, its name in the command list
+    const char* command;
+
+    /// Tag given with the command, empty if it had none
+    std::string tag;
+};
+
+/// Kinds of entries listed by the list commands
+enum List_target {
+    LIST_TARGET_CHANNELS,   // Channels of the active server
+    LIST_TARGET_CLIENTS     // Clients of the active server
+};
+
+/// Where the value of a field requested with fields= comes from
+enum List_field_source {
+    LIST_FIELD_NAME,        // Name of the entry, held by the mirror
+    LIST_FIELD_CHANNEL,     // Channel of a client, held by the mirror
+    LIST_FIELD_PARENT,      // Parent of a channel, held by the mirror
+    LIST_FIELD_STRING,      // Property read from TeamSpeak as text
+    LIST_FIELD_INT,         // Property read from TeamSpeak as an int
+    LIST_FIELD_UINT64       // Property read from TeamSpeak as a 64 bit number
+};
+
+/// A field requested with fields=, resolved once per command
+struct List_field {
+    /// Name of the field as requested, written as its key
+    std::string name;
+
+    /// Where the value comes from
+    List_field_source source;
+
+    /// Property flag, for properties read from TeamSpeak
+    size_t flag;
+};
+
+/// Comparisons of a where clause
+enum List_predicate_op {
+    LIST_PREDICATE_EQUAL,       // field=value
+    LIST_PREDICATE_NOT_EQUAL,   // field!=value
+    LIST_PREDICATE_CONTAINS     // field~=value, text containing the value,
+                                // ignoring ASCII case
+};
+
+/// A where clause, compiled when the command is parsed so entries are
+/// matched without parsing or resolving anything
+struct List_predicate {
+    /// Field compared
+    List_field field;
+
+    /// Comparison
+    List_predicate_op op;
+
+    /// Set if the field is numeric and compared with number
+    bool numeric;
+
+    /// Operand of numeric comparisons
+    uint64 number;
+
+    /// Operand of text comparisons, lower case for LIST_PREDICATE_CONTAINS
+    std::string text;
+};
+
+/// Options of a list command
+struct List_query {
+    /// Fields to write for each entry. Empty to write the name only
+    std::vector<List_field> fields;
+
+    /// Clauses all listed entries match, those reading the mirror first
+    std::vector<List_predicate> predicates;
+
+    /// Largest number of entries to list, 0 for all
+    uint64 limit;
+
+    /// Only entries with a larger ID are listed, 0 for all
+    uint64 cursor;
+
+    /// Set to list the entries of all servers instead of the active one
+    bool all_servers;
+
+    /// State version to list the changes since, 0 to list all entries
+    uint64 since;
+};
+
+/// An entry of a list as held by the mirror
+struct List_entry {
+    /// ID of the channel or client
+    uint64 id;
+
+    /// Parent of a channel, or channel of a client
+    uint64 parent_id;
+
+    /// Name of the channel or nickname of the client
+    const std::string* name;
+};
+
+/// A list being written in chunks. Entries are written in order of their
+/// ID, so the list can be continued after the last ID written even if the
+/// mirror changed in between
+struct List_stream {
+    /// Kind of entries listed
+    List_target target;
+
+    /// Options of the command, the cursor advancing with each chunk
+    List_query query;
+
+    /// Server connection whose mirror is listed
+    uint64 server_connection_id;
+
+    /// Number of entries still allowed by the limit
+    uint64 remaining;
+
+    /// State version when the list started
+    uint64 version;
+};
+
+/// Value of a field of a list entry
+struct List_value {
+    /// Set if the value is the number, otherwise it is the text
+    bool numeric;
+
+    /// Numeric value
+    uint64 number;
+
+    /// Text value. Kept between entries to reuse its storage
+    std::string text;
+};
+
+/// A channel visited while walking a channel tree
+struct Tree_node {
+    /// ID of the channel
+    uint64 id;
+
+    /// Levels below the root of the walk, the root being at 0
+    unsigned int depth;
+
+    /// Position of the parent among the visited nodes, -1 for the root and
+    /// for top level channels when walking the whole tree
+    size_t parent;
+
+    /// Clients in the channel and all its subchannels
+    unsigned int total;
+};
+
 class Telnet_interface {
 public:
 	
@@ -52,6 +272,28 @@ public:
 
     //-------------------------------------------------------------------------
 
+    /// Handles a channel being created or changed
+    void handle_channel_changed(uint64 server_connection_id, uint64 channel_id);
+
+    /// Handles a channel being deleted
+    void handle_channel_deleted(uint64 server_connection_id, uint64 channel_id);
+
+    /// Handles a client's properties being changed
+    void handle_client_changed(uint64 server_connection_id, anyID client_id);
+
+    /// Handles a client moving to another channel. A new channel ID of 0
+    /// means the client has left the server or is no longer visible
+    void handle_client_moved(uint64 server_connection_id, anyID client_id, uint64 new_channel_id);
+
+    /// Handles the unique identifier of a client being reported
+    void handle_client_identified(uint64 server_connection_id, anyID client_id, const char* uid);
+
+    /// Handles the database ID of a unique identifier being reported, in
+    /// answer to requestClientDBIDfromUID
+    void handle_database_id(uint64 server_connection_id, const char* uid, uint64 database_id);
+
+    //-------------------------------------------------------------------------
+
     /// Handles received private text message
     void handle_private_text_message(uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message);
 
@@ -61,6 +303,21 @@ public:
     /// Handles received poke
     void handle_poke(uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message);
 
+    /// Handles a client starting or stopping to talk. Only takes a
+    /// timestamp and queues the notification, as it runs on TeamSpeak's
+    /// audio path
+    void handle_talk_status(uint64 server_connection_id, anyID client_id, bool talking, bool whisper);
+
+    //-------------------------------------------------------------------------
+
+    /// Sets the ID registered for the plugin, which is needed to create
+    /// return codes
+    void set_plugin_id(const char* plugin_id);
+
+    /// Handles the result of a request sent with a return code. An error of
+    /// ERROR_ok means the request succeeded
+    void handle_request_result(uint64 server_connection_id, const char* return_code, unsigned int error, const char* error_message);
+
 private:
 	// Constrcutor and destructor are private to ensure only a single
 	// instance is created
@@ -95,9 +352,29 @@ public:
     bool execution_complete();
 
 private:
-    /// Process external events
+    /// Processes the events queued by other threads
     void _process_events();
 
+    /// Handles a queued event. Returns true if a notification was written
+    /// to sessions
+    bool _dispatch_event(const Interface_event& event);
+
+    /// Queues an event for the interface thread. May be called from any
+    /// thread, never blocks, and drops the event if the queue is full
+    bool _post_event(const Interface_event& event);
+
+    /// Queues a plugin ID, request result or listen, close or shutdown
+    /// request on the control queue, so floods of updates and
+    /// notifications can't crowd them out. May be called from any thread
+    /// and never blocks. Lost control events are counted
+    void _post_control_event(const Interface_event& event);
+
+    /// Fails all tracked requests, after request results were lost
+    void _fail_all_requests(const char* reason);
+
+    /// Queues a listen, close or shutdown request
+    void _post_external_event(External_plugin_events external_event);
+
     /// Handles a listen event
     void _handle_event_listen();
 
@@ -136,6 +413,9 @@ private:
     /// Runs the SHUTDOWN state
     void _run_TELNET_INTERFACE_STATE_SHUTDOWN();
 
+    /// Waits for socket readiness and serves the server and all sessions
+    void _run_reactor();
+
 
     /// Exits the IDLE state
     void _on_exit_TELNET_INTERFACE_STATE_IDLE();
@@ -150,45 +430,364 @@ private:
     void _on_exit_TELNET_INTERFACE_STATE_SHUTDOWN();
 
 
+    /// Accepts all pending connections on the server socket
+    void _accept_sessions();
+
+    /// Closes and removes a session
+    void _close_session(size_t index);
+
+    /// Closes and removes all sessions
+    void _close_all_sessions();
+
+
     /// Sends a list of supported command to the client
-    void _send_usage_to_client();
+    void _send_usage_to_client(Telnet_session& session);
+
+
+    /// Parses all complete commands in the received buffer, stopping at a
+    /// list which is written in chunks. Returns false if the session has to
+    /// be closed
+    bool _parse_buffer(Telnet_session& session);
+
+    /// Parses and executes a single command line
+    void _parse_line(Telnet_session& session, char* line, size_t length);
+
+    /// Reports a command that is not in the command table
+    void _handle_unknown_command(Telnet_session& session, const std::string& command);
+
+    /// Builds the lookup table for the supported commands
+    void _build_command_table();
+
+    /// Queues a notification for the sessions subscribed to it. May be
+    /// called from any thread
+    void _notify(Notification_type type, uint64 server_connection_id, uint64 channel_id, uint64 from_id, const char* from_name, const char* text);
+
+    /// Queues a received message. May be called from any thread
+    void _notify_message(Notification_type type, uint64 server_connection_id, uint64 fromID, const char* from_name, const char* message);
+
+    /// Returns the event name of a message notification
+    static const char* _message_event_name(Notification_type type);
+
+    /// Returns a monotonic time in microseconds. May be called from any
+    /// thread
+    uint64 _monotonic_microseconds() const;
+
+    /// Sends the output queued for all sessions, so notifications don't
+    /// wait for the next round of select. Sessions whose connection failed
+    /// are closed
+    void _flush_sessions();
+
+    /// Logs a notification and writes it to the sessions subscribed to it
+    void _deliver_notification(const Interface_event& event);
+
+    /// Writes a logged event to the sessions subscribed to it
+    void _deliver_logged_event(Logged_event& event);
+
+    /// Marks a client or channel as changed, so its state is read once the
+    /// interface thread needs it. May be called from any thread
+    void _post_entity_change(uint64 server_connection_id, Mirror_entity entity, uint64 id, bool removed);
+
+    /// Reads the state of the clients and channels marked as changed since
+    /// it was last read, and applies it to the mirrors
+    void _read_changed_entities();
+
+    /// Marks the clients and channels which differ between the replaced and
+    /// the new mirror of a server as changed
+    void _coalesce_differences(uint64 server_connection_id, const Server_mirror& before, const Server_mirror& after);
+
+    /// Sends an update notification for each client and channel changed
+    /// during the coalescing window
+    void _deliver_updates();
+
+    /// Describes a logged event to the subscription filters
+    static void _describe_event(const Logged_event& event, Notification& notification);
+
+    /// Returns a logged event encoded in a format, encoding it on first use
+    Shared_buffer* _encode_event(Logged_event& event, Session_format format);
+
+    /// Returns the filter matching all notifications
+    static Event_filter _default_filter();
+
+    /// Parses the type and filters of a subscribe or unsubscribe command
+    Argument_result _parse_event_filter(Command_arguments& arguments, Event_filter& filter);
+
+    /// Parses the options of a list command
+    Argument_result _parse_list_query(Command_arguments& arguments, List_target target, List_query& query);
+
+    /// Resolves the name of a field to the property it reads. Returns false
+    /// if there is no such property
+    bool _resolve_list_field(List_target target, const char* name, size_t name_length, List_field& field);
+
+    /// Compiles a where clause. Returns false if it is malformed or its
+    /// field does not exist
+    bool _compile_list_predicate(List_target target, const Token& clause, List_predicate& predicate);
+
+    /// Reads a field of a list entry. Returns false if the property cannot
+    /// be read
+    bool _read_list_field(uint64 server_connection_id, List_target target, const List_field& field, const List_entry& entry, List_value& value);
+
+    /// Determines if a list entry matches all where clauses of a query
+    bool _matches_list_query(uint64 server_connection_id, List_target target, const List_query& query, const List_entry& entry, List_value& value);
+
+    /// Starts writing a list, continuing it later if the session's output
+    /// gets congested
+    void _start_list_stream(Telnet_session& session, List_target target, const List_query& query);
+
+    /// Writes chunks of the list of a session until it is complete or the
+    /// output is congested. Returns true if no list is pending any more
+    bool _continue_list_stream(Telnet_session& session);
+
+    /// Flushes the session and continues its list while the output isn't
+    /// congested. Returns false if the connection failed
+    bool _serve_list_stream(Telnet_session& session);
+
+    /// Determines if a list of the session waits for its output to drain.
+    /// No commands are read from the session meanwhile
+    bool _has_list_stream(Telnet_session* session) const;
+
+    /// Writes the next chunk of a list. Returns true once the list is
+    /// complete and ended
+    bool _write_list_chunk(Telnet_session& session, List_stream& stream);
+
+    /// Drops the pending list of a session
+    void _drop_list_stream(Telnet_session* session);
+
+    /// Queues the requested fields of a channel or client as a list record,
+    /// starting with its server if the list spans all servers, and with the
+    /// kind of change if one is given
+    void _queue_list_record(Telnet_session& session, uint64 server_connection_id, List_target target, const List_query& query, List_mark mark, const char* change, const List_entry& entry, List_value& value);
+
+    /// Requests the name and parent of each entry if a list of records was
+    /// asked for without fields
+    void _add_default_list_fields(List_target target, List_query& query);
+
+    /// Writes the entries of all servers as one list in a single pass, so
+    /// the servers are seen at the same moment
+    void _write_list_all_servers(Telnet_session& session, List_target target, List_query& query);
+
+    /// Answers a list command asking for the changes since a state version,
+    /// failing it if the change logs no longer reach back that far
+    void _write_list_changes(Telnet_session& session, const Token& command, const char* header, List_target target, List_query& query);
+
+
 
+    /// Reads the channels and clients of a server, producing the updates
+    /// which replace its mirror
+    void _snapshot_server(uint64 server_connection_id, std::vector<Mirror_update>& updates);
 
-    /// Parses the content of the received buffer
-    void _parse_buffer();
+    /// Reads a channel, producing the update which sets it in the mirror.
+    /// Returns false if the channel can't be read
+    bool _read_channel(uint64 server_connection_id, uint64 channel_id, std::vector<Mirror_update>& updates);
 
-    /// Queues data for the client
-    void _queue_write(std::string response);
+    /// Reads a client, producing the updates which set it and its identity
+    /// in the mirror. Returns false if the client can't be read
+    bool _read_client(uint64 server_connection_id, anyID client_id, std::vector<Mirror_update>& updates);
+
+    /// Snapshots all servers which are connected already, and applies the
+    /// snapshots right away. Must be called on the interface thread
+    void _snapshot_connected_servers(bool report_changes);
+
+    /// Replaces the mirror of a server with a snapshot of its channels and
+    /// clients. When reporting changes, the clients and channels which
+    /// differ from the replaced mirror get update notifications
+    void _load_server(uint64 server_connection_id, bool report_changes);
+
+    /// Queues a mirror update. May be called from any thread
+    void _post_mirror_update(Mirror_update_type type, uint64 server_connection_id, uint64 id, uint64 parent_id, uint64 order, const char* name);
+
+    /// Applies a mirror update
+    void _apply_mirror_update(const Mirror_update& update);
+
+    /// Returns the mirror of a server connection, or nullptr if the server
+    /// is not mirrored
+    const Server_mirror* _find_mirror(uint64 server_connection_id) const;
+
+    /// Extracts the next argument as a client of the active server, given
+    /// by its ID or as "uid:<unique identifier>". Identifiers are resolved
+    /// from the mirror, unknown ones are invalid
+    Argument_result _next_client(Telnet_session& session, Command_arguments& arguments, anyID& client_id);
+
+
+    /// Creates a return code for a request, or returns nullptr if no plugin
+    /// ID is registered and the request cannot be tracked
+    const char* _create_return_code(char* return_code, size_t size);
+
+    /// Replies to a command whose request was sent. Requests sent with a
+    /// return code are tracked, and their number is added to the reply
+    void _reply_request_sent(Telnet_session& session, const Token& command, const char* return_code);
+
+    /// Reports the result of a tracked request to the session which sent it
+    void _resolve_request(const Interface_event& event);
+
+    /// Writes the result line of a tracked request, tagged like the command
+    /// which sent it. Nothing is written if the session is closed
+    void _reply_request_result(const Pending_request& request, const char* status, const char* reason);
+
+    /// Fails all tracked requests of a server connection which is gone
+    void _fail_server_requests(uint64 server_connection_id);
+
+    /// Returns the session with the given ID, or nullptr if it is closed
+    Telnet_session* _find_session(uint64 session_id);
+
+
+    /// Creates the socket used to wake up the interface thread
+    void _create_wakeup_socket();
+
+    /// Wakes up the interface thread. May be called from any thread
+    void _signal_wakeup();
+
+    /// Consumes pending wakeup signals
+    void _drain_wakeup();
 
     /// Checks the result code and logs appropriately
     bool _evaluate_result(unsigned int result);
 
 
+    // Command handlers, called with the command token and the arguments
+    // following it
+    void _command_identifier_unsupported(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_servers_connect(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_servers_disconnect(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_servers_list(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_servers_select(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_channels_list(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_channels_select(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_channels_tree(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_users_list(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_users_find(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_users_resolve(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_users_move(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_users_kick(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_events_subscribe(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_events_unsubscribe(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_events_resume(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_events_coalesce(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_session_format(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_session_binary(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_messaging_send_channel(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_messaging_send_private(Telnet_session& session, const Token& command, Command_arguments& arguments);
+    void _command_messaging_send_poke(Telnet_session& session, const Token& command, Command_arguments& arguments);
+
+    /// Signature of a command handler
+    typedef void (Telnet_interface::*Command_handler)(Telnet_session& session, const Token& command, Command_arguments& arguments);
+
+    /// Entry of the command list
+    struct Command_entry {
+        /// Full command token, e.g. ts3.servers.list
+        const char* name;
+
+        /// Function executing the command
+        Command_handler handler;
+
+        /// Parameters shown in the usage, nullptr hides the command
+        const char* usage;
+    };
+
+    /// Supported commands
+    static const Command_entry _commands[];
+
+    /// Number of supported commands
+    static const size_t _command_count;
+
+
 private: // Private members
 
 	/// State of the interface
 	Telnet_interface_state _state;
 
-    /// Holds a list of externally generated events
-    std::list<External_plugin_events> _pending_external_events;
+    /// Events queued by other threads. Never blocks TeamSpeak's threads
+    Mpsc_ring<Interface_event> _events;
+
+    /// Number of events dropped because the queue was full
+    std::atomic<unsigned int> _dropped_events;
+
+    /// Rarely used events which must not compete with _events for room
+    Mpsc_ring<Interface_event> _control_events;
+
+    /// Number of control events dropped because their queue was full
+    std::atomic<unsigned int> _lost_control_events;
+
+    /// Ticks per second of the performance counter
+    uint64 _counter_frequency;
 
 	/// Handle of the server socket
 	SOCKET _server_socket;
 
-	/// Handle of the client socket
-	SOCKET _client_socket;
+    /// Loopback socket signalled by other threads to interrupt select
+    SOCKET _wakeup_socket;
+
+    /// Set if the constructor started Winsock, which the destructor then
+    /// cleans up, whether or not the wakeup socket could be created
+    bool _wsa_started;
+
+    /// Set while a wakeup signal is in flight, to coalesce signals
+    std::atomic<bool> _wakeup_pending;
+
+    /// Recycles output slabs between sessions
+    Slab_pool _slab_pool;
+
+    /// Connected client sessions
+    std::vector<Telnet_session*> _sessions;
+
+    /// ID assigned to the next accepted session
+    uint64 _next_session_id;
+
+    /// Maps command tokens to their entry in _commands
+    Command_table _command_table;
+
+    /// Mirrored state of each connected server. Only used by the interface
+    /// thread
+    std::unordered_map<uint64, Server_mirror*> _mirrors;
+
+    /// State version at which a mirror was last dropped. Changes across all
+    /// servers can only be followed from this version on
+    uint64 _mirror_dropped_version;
+
+    /// Event filters of all sessions
+    Subscription_table _subscriptions;
+
+    /// Lists waiting for their session's output to drain, by session
+    std::unordered_map<Telnet_session*, List_stream*> _list_streams;
+
+    /// Entries of the chunk being collected, a heap ordered by ID. Kept to
+    /// reuse its storage
+    std::vector<List_entry> _list_chunk;
+
+    /// Channels visited by a tree walk in pre-order, and the channels still
+    /// to visit. Kept to reuse their storage
+    std::vector<Tree_node> _tree_nodes;
+    std::vector<Tree_node> _tree_stack;
+
+    /// Sessions matched by the current notification, kept to reuse its
+    /// storage
+    std::vector<Telnet_session*> _matched_sessions;
+
+    /// Most recent notifications, replayed by ts3.events.resume
+    Event_log _event_log;
+
+    /// Update or talk notification being delivered. These are kept out of
+    /// the log, so bursts of them can't push out the messages clients
+    /// resume from; clients list the state instead
+    Logged_event _unlogged_event;
+
+    /// Encoder for each Session_format, used to encode logged events
+    Response_encoder* _event_encoders[SESSION_FORMAT_COUNT];
+
+    /// Handed to the encoders for a logged event, redirected to the shared
+    /// buffer the event is encoded into
+    Output_buffer _event_scratch;
 
-    /// Stream holding received data
-    std::stringstream _read_stream;
+    /// Merges changes to clients and channels into update notifications
+    Update_coalescer _coalescer;
 
-    /// Stream holding data to write
-    std::stringstream _write_stream;
+    /// ID registered for the plugin, empty until TeamSpeak registers it
+    std::string _plugin_id;
 
-    /// Currently selected server ID
-    uint64 _active_server_connection;
+    /// Requests awaiting their result, by return code
+    std::unordered_map<std::string, Pending_request> _pending_requests;
 
-    /// Currently selected channel
-    uint64 _active_server_channel;
+    /// Number assigned to the next tracked request
+    uint64 _next_request_id;
 };
 
 #endif // _TELNET_IF_H
@@ -0,0 +1,269 @@
+/*
+* Filenme: telnet_session.cpp
+* Purpose: Implements the Telnet_session class functions and members
+*/
+#include "telnet_session.h"
+
+/// Minimum free space offered to a single recv call
+const size_t SESSION_RECEIVE_SIZE = 4096;
+
+/// Maximum length of a command line
+const size_t SESSION_MAX_LINE_LENGTH = 8192;
+
+/// Pending output above which the session counts as congested
+const size_t SESSION_OUTPUT_HIGH_WATER = 16 * OUTPUT_SLAB_SIZE;
+
+/// Held output above which notifications are dropped rather than held, so a
+/// client which stops reading during a list can't grow it without bound
+const size_t SESSION_HELD_OUTPUT_LIMIT = 64 * OUTPUT_SLAB_SIZE;
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Telnet_session::Telnet_session(SOCKET socket, uint64 session_id, Slab_pool& slab_pool) : _input(SESSION_MAX_LINE_LENGTH), _output(slab_pool), _held_output(slab_pool) {
+    _socket = socket;
+    _sink = &_output;
+    _held_dropped = 0;
+    _id = session_id;
+    _active_server_connection = 0;
+    _active_server_channel = 0;
+    _default_filter = false;
+    _format = SESSION_FORMAT_TEXT;
+    _encoder = Response_encoder::create(_format);
+
+    // The reactor serves many sessions from a single thread, so a slow
+    // client must never block it
+    u_long non_blocking = 1;
+    ioctlsocket(_socket, FIONBIO, &non_blocking);
+
+    // Notifications are small and latency sensitive, don't let Nagle's
+    // algorithm hold them back waiting for the client's delayed ACK
+    int no_delay = 1;
+    setsockopt(_socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+}
+
+//-----------------------------------------------------------------------------
+/// Destructor
+Telnet_session::~Telnet_session() {
+    if (_socket != INVALID_SOCKET) {
+        closesocket(_socket);
+    }
+    delete _encoder;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the socket of the session
+SOCKET Telnet_session::get_socket() const {
+    return _socket;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the unique ID of the session
+uint64 Telnet_session::get_id() const {
+    return _id;
+}
+
+//-----------------------------------------------------------------------------
+/// Reads the data available on the socket
+bool Telnet_session::receive() {
+    // Receive straight into the framer, as much as fits
+    char* buffer = _input.prepare(SESSION_RECEIVE_SIZE);
+    int bytes_received = recv(_socket, buffer, (int)_input.available(), 0);
+    if (bytes_received > 0) {
+        _input.commit(bytes_received);
+        return true;
+    } else if (bytes_received == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) {
+        // Spurious wakeup, nothing to read
+        return true;
+    }
+    // Client has disconnected
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+/// Extracts the next complete command from the received data
+Line_framer_result Telnet_session::next_command(char*& command, size_t& length) {
+    if (_format == SESSION_FORMAT_BINARY) {
+        return _input.next_frame(command, length);
+    }
+    return _input.next_line(command, length);
+}
+
+//-----------------------------------------------------------------------------
+/// Writes as much pending data as the socket accepts
+bool Telnet_session::flush() {
+    return _output.send_to(_socket);
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if data is waiting to be written to the client
+bool Telnet_session::has_pending_output() const {
+    return !_output.empty();
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if so much data is waiting that producers should pause
+bool Telnet_session::is_output_congested() const {
+    return _output.size() >= SESSION_OUTPUT_HIGH_WATER;
+}
+
+//-----------------------------------------------------------------------------
+/// Sets aside the output queued from now on, except lists
+void Telnet_session::hold_output() {
+    _sink = &_held_output;
+}
+
+//-----------------------------------------------------------------------------
+/// Queues the output set aside behind the data already queued
+void Telnet_session::release_held_output() {
+    _output.splice(_held_output);
+    _sink = &_output;
+
+    if (_held_dropped > 0) {
+        // Not tagged, the error answers no command. The client can fetch
+        // the dropped notifications with ts3.events.resume
+        std::string error_msg = "ts3.error: " + std::to_string(_held_dropped) + " notifications dropped while a list was written";
+        _encoder->text(_output, std::string(), error_msg.c_str(), error_msg.length());
+        _held_dropped = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the format the session exchanges data in
+Session_format Telnet_session::get_format() const {
+    return _format;
+}
+
+//-----------------------------------------------------------------------------
+/// Switches the format of the data exchanged from now on. Data already
+/// queued keeps its format
+void Telnet_session::set_format(Session_format format) {
+    if (format != _format) {
+        delete _encoder;
+        _format = format;
+        _encoder = Response_encoder::create(_format);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a line of informational or error text for the client
+void Telnet_session::queue_write(const std::string& response) {
+    _encoder->text(*_sink, _reply_tag, response.c_str(), response.length());
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a "<command> <status>" response for the client
+void Telnet_session::queue_reply(const char* command, size_t command_length, const char* status) {
+    _encoder->reply(*_sink, _reply_tag, command, command_length, status);
+}
+
+//-----------------------------------------------------------------------------
+/// Queues the state of a tracked request
+void Telnet_session::queue_request_status(const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason) {
+    _encoder->request_status(*_sink, _reply_tag, command, command_length, status, request_id, reason);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts a list answering a command
+void Telnet_session::begin_list(const char* command, size_t command_length, const char* header) {
+    _encoder->begin_list(_output, _reply_tag, command, command_length, header);
+}
+
+//-----------------------------------------------------------------------------
+/// Queues an entry of the current list
+void Telnet_session::queue_list_entry(List_mark mark, uint64 id, const char* name, size_t name_length) {
+    _encoder->list_entry(_output, mark, id, name, name_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Starts an entry of the current list made of named fields
+void Telnet_session::begin_list_record(List_mark mark, uint64 id) {
+    _encoder->begin_record(_output, mark, id);
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a text field of the current record
+void Telnet_session::queue_record_string(const char* key, size_t key_length, const char* value, size_t value_length) {
+    _encoder->record_string(_output, key, key_length, value, value_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a numeric field of the current record
+void Telnet_session::queue_record_number(const char* key, size_t key_length, uint64 value) {
+    _encoder->record_number(_output, key, key_length, value);
+}
+
+//-----------------------------------------------------------------------------
+/// Ends the current record
+void Telnet_session::end_list_record() {
+    _encoder->end_record(_output);
+}
+
+//-----------------------------------------------------------------------------
+/// Ends the current list
+void Telnet_session::end_list(uint64 cursor, uint64 version) {
+    _encoder->end_list(_output, cursor, version);
+}
+
+//-----------------------------------------------------------------------------
+/// Queues a notification already encoded in the session's format
+void Telnet_session::queue_shared(Shared_buffer* buffer) {
+    if (_sink == &_held_output && _held_output.size() >= SESSION_HELD_OUTPUT_LIMIT) {
+        _held_dropped++;
+        return;
+    }
+    _sink->append_shared(buffer);
+}
+
+//-----------------------------------------------------------------------------
+/// Sets the tag written in front of the response lines
+void Telnet_session::set_reply_tag(const char* tag, size_t tag_length) {
+    _reply_tag.assign(tag, tag_length);
+}
+
+//-----------------------------------------------------------------------------
+/// Stops tagging response lines
+void Telnet_session::clear_reply_tag() {
+    _reply_tag.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the current reply tag
+const std::string& Telnet_session::get_reply_tag() const {
+    return _reply_tag;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the server connection selected by this session
+uint64 Telnet_session::get_active_server_connection() const {
+    return _active_server_connection;
+}
+
+//-----------------------------------------------------------------------------
+/// Selects a server connection for this session
+void Telnet_session::set_active_server_connection(uint64 server_connection_id) {
+    _active_server_connection = server_connection_id;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the channel selected by this session
+uint64 Telnet_session::get_active_server_channel() const {
+    return _active_server_channel;
+}
+
+//-----------------------------------------------------------------------------
+/// Selects a channel for this session
+void Telnet_session::set_active_server_channel(uint64 channel_id) {
+    _active_server_channel = channel_id;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if the session still has the filter it connected with
+bool Telnet_session::has_default_filter() const {
+    return _default_filter;
+}
+
+//-----------------------------------------------------------------------------
+/// Sets whether the session still has its initial filter
+void Telnet_session::set_default_filter(bool has_default_filter) {
+    _default_filter = has_default_filter;
+}
@@ -0,0 +1,188 @@
+/*
+* Filenme: telnet_session.h
+* Purpose: Defines the Telnet_session class, holding the state of a single
+*          client connected to the telnet interface
+*/
+#ifndef _TELNET_SESSION_H_
+#define _TELNET_SESSION_H_
+
+#include <WinSock2.h>
+#include <string>
+
+#include "ts3_functions.h"
+#include "output_buffer.h"
+#include "line_framer.h"
+#include "response_encoder.h"
+
+class Telnet_session {
+public:
+    /// Constructor, takes ownership of the connected socket. Output slabs
+    /// are taken from the given pool
+    Telnet_session(SOCKET socket, uint64 session_id, Slab_pool& slab_pool);
+
+    /// Destructor, closes the socket
+    ~Telnet_session();
+
+    /// Returns the socket of the session
+    SOCKET get_socket() const;
+
+    /// Returns the unique ID of the session
+    uint64 get_id() const;
+
+    /// Reads the data available on the socket. Returns false if the client
+    /// has disconnected or the connection failed
+    bool receive();
+
+    /// Extracts the next complete command from the received data: a line
+    /// for text sessions, a frame for binary ones. Lines are NUL terminated.
+    /// The command is valid until the next call to receive
+    Line_framer_result next_command(char*& command, size_t& length);
+
+    /// Writes as much pending data as the socket accepts. Returns false if
+    /// the connection failed
+    bool flush();
+
+    /// Determines if data is waiting to be written to the client
+    bool has_pending_output() const;
+
+    /// Determines if so much data is waiting that producers should pause
+    /// until the client has caught up
+    bool is_output_congested() const;
+
+    /// Sets aside the output queued from now on, except lists, until
+    /// release_held_output is called. Used while a list is written in
+    /// chunks, so other output does not end up inside the list. Once the
+    /// held output reaches its limit, further notifications are dropped
+    void hold_output();
+
+    /// Queues the output set aside by hold_output behind the data already
+    /// queued, followed by an error if notifications were dropped, and
+    /// queues output normally again
+    void release_held_output();
+
+    /// Returns the format the session exchanges data in
+    Session_format get_format() const;
+
+    /// Switches the format of the data exchanged from now on
+    void set_format(Session_format format);
+
+    /// Queues a line of informational or error text for the client
+    void queue_write(const std::string& response);
+
+    /// Queues a "<command> <status>" response for the client, without
+    /// building the response in a temporary string
+    void queue_reply(const char* command, size_t command_length, const char* status);
+
+    /// Queues the state of a tracked request, see Response_encoder
+    void queue_request_status(const char* command, size_t command_length, const char* status, uint64 request_id, const char* reason);
+
+    /// Starts a list answering a command. Lists are always queued right
+    /// away, even while other output is held
+    void begin_list(const char* command, size_t command_length, const char* header);
+
+    /// Queues an entry of the current list
+    void queue_list_entry(List_mark mark, uint64 id, const char* name, size_t name_length);
+
+    /// Starts an entry of the current list made of named fields
+    void begin_list_record(List_mark mark, uint64 id);
+
+    /// Queues a text field of the current record
+    void queue_record_string(const char* key, size_t key_length, const char* value, size_t value_length);
+
+    /// Queues a numeric field of the current record
+    void queue_record_number(const char* key, size_t key_length, uint64 value);
+
+    /// Ends the current record
+    void end_list_record();
+
+    /// Ends the current list. A cursor other than 0 tells the client the
+    /// list was cut short and where to continue, a version other than 0 the
+    /// state version to ask for changes since
+    void end_list(uint64 cursor, uint64 version);
+
+    /// Queues a notification already encoded in the session's format. The
+    /// session references the buffer instead of copying it, so a
+    /// notification sent to many sessions is encoded once per format and
+    /// never copied
+    void queue_shared(Shared_buffer* buffer);
+
+    /// Sets the tag written in front of the response lines queued from now
+    /// on, so the client can tell which command they answer
+    void set_reply_tag(const char* tag, size_t tag_length);
+
+    /// Stops tagging response lines
+    void clear_reply_tag();
+
+    /// Returns the current reply tag, empty if lines are not tagged
+    const std::string& get_reply_tag() const;
+
+    //-------------------------------------------------------------------------
+
+    /// Returns the server connection selected by this session
+    uint64 get_active_server_connection() const;
+
+    /// Selects a server connection for this session
+    void set_active_server_connection(uint64 server_connection_id);
+
+    /// Returns the channel selected by this session
+    uint64 get_active_server_channel() const;
+
+    /// Selects a channel for this session
+    void set_active_server_channel(uint64 channel_id);
+
+    /// Determines if the session still has the filter for all
+    /// notifications it was given when it connected
+    bool has_default_filter() const;
+
+    /// Sets whether the session still has its initial filter
+    void set_default_filter(bool has_default_filter);
+
+private:
+    // Sessions own a socket and are not copied
+    Telnet_session(const Telnet_session&);
+    Telnet_session& operator=(const Telnet_session&);
+
+private: // Private members
+
+    /// Handle of the client socket
+    SOCKET _socket;
+
+    /// Unique ID of the session
+    uint64 _id;
+
+    /// Received data, split into lines
+    Line_framer _input;
+
+    /// Data waiting to be written
+    Output_buffer _output;
+
+    /// Output set aside while output is held
+    Output_buffer _held_output;
+
+    /// Buffer receiving all output except lists, _output or _held_output
+    Output_buffer* _sink;
+
+    /// Number of notifications dropped while output was held
+    uint64 _held_dropped;
+
+    /// Format of the exchanged data
+    Session_format _format;
+
+    /// Writes responses in the format of the session
+    Response_encoder* _encoder;
+
+    /// Currently selected server ID
+    uint64 _active_server_connection;
+
+    /// Currently selected channel
+    uint64 _active_server_channel;
+
+    /// Whether the only filter of the session is the one for all
+    /// notifications it connected with
+    bool _default_filter;
+
+    /// Tag of the command being answered, including the leading #
+    std::string _reply_tag;
+};
+
+#endif // _TELNET_SESSION_H_
@@ -0,0 +1,158 @@
+/*
+* Filenme: update_coalescer.cpp
+* Purpose: Implements the Update_coalescer class functions and members
+*/
+#include "update_coalescer.h"
+
+//-----------------------------------------------------------------------------
+/// Constructor
+Update_coalescer::Update_coalescer(uint64 window) {
+    _window = window;
+    _deadline = 0;
+    _received_count = 0;
+    _absorbed_count = 0;
+}
+
+//-----------------------------------------------------------------------------
+/// Sets the window in milliseconds. A window already open keeps its
+/// deadline
+void Update_coalescer::set_window(uint64 window) {
+    _window = window;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the window in milliseconds
+uint64 Update_coalescer::get_window() const {
+    return _window;
+}
+
+//-----------------------------------------------------------------------------
+/// Records a change to an entity
+void Update_coalescer::add(uint64 server_connection_id, Mirror_entity entity, uint64 id, bool removed, uint64 now) {
+    _received_count++;
+
+    Key key;
+    key.server_connection_id = server_connection_id;
+    key.id = id;
+    key.entity = entity;
+
+    std::pair<std::unordered_map<Key, size_t, Key_hash>::iterator, bool> inserted = _positions.insert(std::make_pair(key, _updates.size()));
+    if (!inserted.second) {
+        Coalesced_update& update = _updates[inserted.first->second];
+        update.absorbed++;
+        update.removed = removed;
+        if (!update.unread) {
+            update.unread = true;
+            _unread.push_back(inserted.first->second);
+        }
+        _absorbed_count++;
+        return;
+    }
+
+    if (_updates.empty()) {
+        _deadline = now + _window;
+    }
+    Coalesced_update update;
+    update.server_connection_id = server_connection_id;
+    update.entity = entity;
+    update.id = id;
+    update.absorbed = 0;
+    update.removed = removed;
+    update.unread = true;
+    _unread.push_back(_updates.size());
+    _updates.push_back(update);
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if no change is waiting
+bool Update_coalescer::empty() const {
+    return _updates.empty();
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the time at which the window closes
+uint64 Update_coalescer::get_deadline() const {
+    return _deadline;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the entities changed during the window
+const std::vector<Coalesced_update>& Update_coalescer::get_updates() const {
+    return _updates;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the positions of the entities whose state is unread
+const std::vector<size_t>& Update_coalescer::get_unread() const {
+    return _unread;
+}
+
+//-----------------------------------------------------------------------------
+/// Determines if an entity changed since its state was last read
+bool Update_coalescer::is_unread(uint64 server_connection_id, Mirror_entity entity, uint64 id) const {
+    Key key;
+    key.server_connection_id = server_connection_id;
+    key.id = id;
+    key.entity = entity;
+
+    std::unordered_map<Key, size_t, Key_hash>::const_iterator it = _positions.find(key);
+    return it != _positions.end() && _updates[it->second].unread;
+}
+
+//-----------------------------------------------------------------------------
+/// Marks the state of all entities as read
+void Update_coalescer::mark_read() {
+    for (size_t i = 0; i < _unread.size(); i++) {
+        _updates[_unread[i]].unread = false;
+    }
+    _unread.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Marks the state of the entities of a server as read
+void Update_coalescer::mark_read(uint64 server_connection_id) {
+    size_t kept = 0;
+    for (size_t i = 0; i < _unread.size(); i++) {
+        Coalesced_update& update = _updates[_unread[i]];
+        if (update.server_connection_id == server_connection_id) {
+            update.unread = false;
+        } else {
+            _unread[kept++] = _unread[i];
+        }
+    }
+    _unread.resize(kept);
+}
+
+//-----------------------------------------------------------------------------
+/// Forgets the entities of the window
+void Update_coalescer::clear() {
+    _updates.clear();
+    _positions.clear();
+    _unread.clear();
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the number of changes recorded so far
+uint64 Update_coalescer::get_received_count() const {
+    return _received_count;
+}
+
+//-----------------------------------------------------------------------------
+/// Returns the number of changes merged into others so far
+uint64 Update_coalescer::get_absorbed_count() const {
+    return _absorbed_count;
+}
+
+//-----------------------------------------------------------------------------
+/// Compares entity keys
+bool Update_coalescer::Key::operator==(const Key& other) const {
+    return server_connection_id == other.server_connection_id && id == other.id && entity == other.entity;
+}
+
+//-----------------------------------------------------------------------------
+/// Hashes entity keys
+size_t Update_coalescer::Key_hash::operator()(const Key& key) const {
+    uint64 hash = key.id * 2 + (key.entity == MIRROR_ENTITY_CLIENT ? 1 : 0);
+    hash ^= key.server_connection_id * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
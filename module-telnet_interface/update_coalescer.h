@@ -0,0 +1,130 @@
+/*
+* Filenme: update_coalescer.h
+* Purpose: Defines the Update_coalescer class, which merges the changes to
+*          mirrored clients and channels within a time window
+*/
+#ifndef _UPDATE_COALESCER_H_
+#define _UPDATE_COALESCER_H_
+
+#include <vector>
+#include <unordered_map>
+
+#include "teamspeak/public_definitions.h"
+#include "server_mirror.h"
+
+/// An entity changed during the current window
+struct Coalesced_update {
+    /// Server connection of the entity
+    uint64 server_connection_id;
+
+    /// Kind of entity
+    Mirror_entity entity;
+
+    /// ID of the client or channel
+    uint64 id;
+
+    /// Number of changes merged into this one, besides the first
+    unsigned int absorbed;
+
+    /// Whether the latest change removed the entity
+    bool removed;
+
+    /// Whether the entity changed since its state was last read
+    bool unread;
+};
+
+/// Collects the clients and channels changed during a window, each once
+/// however often it changed. Changes are mere marks, the state of an entity
+/// is read when it is needed and once however often it changed. The first
+/// change opens the window, and once it has passed the entities are
+/// reported with their state at that time, so the last change of an entity
+/// wins. A burst costs a lookup per change, and a read and a report per
+/// distinct entity
+class Update_coalescer {
+public:
+    /// Constructor, the window is given in milliseconds
+    explicit Update_coalescer(uint64 window);
+
+    /// Sets the window in milliseconds. 0 reports every change as soon as
+    /// the events queued with it have been processed
+    void set_window(uint64 window);
+
+    /// Returns the window in milliseconds
+    uint64 get_window() const;
+
+    /// Records a change to an entity at a time in milliseconds, marking its
+    /// state unread
+    void add(uint64 server_connection_id, Mirror_entity entity, uint64 id, bool removed, uint64 now);
+
+    /// Determines if no change is waiting
+    bool empty() const;
+
+    /// Returns the time in milliseconds at which the window closes. Only
+    /// meaningful while changes are waiting
+    uint64 get_deadline() const;
+
+    /// Returns the entities changed during the window, in order of their
+    /// first change
+    const std::vector<Coalesced_update>& get_updates() const;
+
+    /// Returns the positions in get_updates of the entities whose state is
+    /// unread, in order of their marking
+    const std::vector<size_t>& get_unread() const;
+
+    /// Determines if an entity changed since its state was last read
+    bool is_unread(uint64 server_connection_id, Mirror_entity entity, uint64 id) const;
+
+    /// Marks the state of all entities as read
+    void mark_read();
+
+    /// Marks the state of the entities of a server as read, after the
+    /// whole server was read
+    void mark_read(uint64 server_connection_id);
+
+    /// Forgets the entities of the window, after they have been reported
+    void clear();
+
+    /// Returns the number of changes recorded so far
+    uint64 get_received_count() const;
+
+    /// Returns the number of changes merged into others so far
+    uint64 get_absorbed_count() const;
+
+private:
+    /// Identifies an entity
+    struct Key {
+        uint64 server_connection_id;
+        uint64 id;
+        Mirror_entity entity;
+
+        bool operator==(const Key& other) const;
+    };
+
+    /// Hashes entity keys
+    struct Key_hash {
+        size_t operator()(const Key& key) const;
+    };
+
+private: // Private members
+
+    /// Length of the window in milliseconds
+    uint64 _window;
+
+    /// Time at which the current window closes
+    uint64 _deadline;
+
+    /// Entities changed during the window
+    std::vector<Coalesced_update> _updates;
+
+    /// Index of each entity in _updates
+    std::unordered_map<Key, size_t, Key_hash> _positions;
+
+    /// Positions in _updates of the entities whose state is unread
+    std::vector<size_t> _unread;
+
+    /// Changes recorded and merged since the coalescer was created
+    uint64 _received_count;
+    uint64 _absorbed_count;
+};
+
+#endif // _UPDATE_COALESCER_H_
@@ -0,0 +1,57 @@
+/*
+* Filenme: varint.h
+* Purpose: Defines the functions encoding and decoding the variable length
+*          integers used by the binary protocol
+*/
+#ifndef _VARINT_H_
+#define _VARINT_H_
+
+#include <cstddef>
+
+#include "teamspeak/public_definitions.h"
+
+/// Largest number of bytes used by an encoded 64 bit value
+const size_t VARINT_MAX_LENGTH = 10;
+
+/// Results of decoding a variable length integer
+enum Varint_result {
+    VARINT_OK,          // The value was decoded
+    VARINT_INCOMPLETE,  // More data is needed to decode the value
+    VARINT_INVALID      // The encoding is longer than any 64 bit value
+};
+
+//-----------------------------------------------------------------------------
+/// Encodes a value, seven bits per byte starting with the lowest ones. The
+/// high bit of a byte is set if more bytes follow. Returns the number of
+/// bytes written to the buffer, which must hold VARINT_MAX_LENGTH bytes
+inline size_t encode_varint(uint64 value, char* buffer) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        buffer[length++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (char)value;
+    return length;
+}
+
+//-----------------------------------------------------------------------------
+/// Decodes a value from at most length bytes. On success, consumed is set
+/// to the number of bytes the encoding takes
+inline Varint_result decode_varint(const char* data, size_t length, uint64& value, size_t& consumed) {
+    uint64 result = 0;
+    for (size_t i = 0; i < VARINT_MAX_LENGTH; i++) {
+        if (i == length) {
+            return VARINT_INCOMPLETE;
+        }
+        unsigned char byte = (unsigned char)data[i];
+        result |= (uint64)(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            value = result;
+            consumed = i + 1;
+            return VARINT_OK;
+        }
+    }
+    return VARINT_INVALID;
+}
+
+#endif // _VARINT_H_
@@ -63,8 +63,8 @@ static int wcharToUtf8(const wchar_t* str, char** result) {
 DWORD dw_thread_id;
 HANDLE h_thread_handle;
 DWORD WINAPI telnet_interface_run_thread(LPVOID lpParam) {
-    // 1. Create instance of the Telnet Interface
-    Telnet_interface* telnet_if = Telnet_interface::create_instance(ts3Functions);
+    // 1. The instance is created by ts3plugin_init, before any callback
+    Telnet_interface* telnet_if = Telnet_interface::get_instance();
 
     // Queue listen event
     telnet_if->event_listen();
@@ -74,10 +74,9 @@ DWORD WINAPI telnet_interface_run_thread(LPVOID lpParam) {
         if (Telnet_interface::get_instance() == nullptr) {
             break;
         } else {
+            // Blocks until socket activity or an event wakes the interface up
             Telnet_interface::get_instance()->execute();
-            if (!Telnet_interface::get_instance()->execution_complete()) {
-                Sleep(100); // Execute every 100ms
-            } else {
+            if (Telnet_interface::get_instance()->execution_complete()) {
                 break;
             }
         }
@@ -165,6 +164,10 @@ int ts3plugin_init() {
 
     bool success = true;
 
+    // Create the interface before spawning its thread, so callbacks and
+    // ts3plugin_registerPluginID always find it
+    Telnet_interface::create_instance(ts3Functions);
+
     // Spawn thread for running the telnet interface
     h_thread_handle = CreateThread(NULL, 0, &telnet_interface_run_thread, NULL, 0, &dw_thread_id);
 
@@ -232,6 +235,9 @@ void ts3plugin_registerPluginID(const char* id) {
 	pluginID = (char*)malloc(sz * sizeof(char));
 	_strcpy(pluginID, sz, id);  /* The id buffer will invalidate after exiting this function */
 	printf("PLUGIN: registerPluginID: %s\n", pluginID);
+
+    // Needed to create return codes for the requests sent by the interface
+    Telnet_interface::get_instance()->set_plugin_id(pluginID);
 }
 
 /* Plugin command keyword. Return NULL or "" if not used. */
@@ -789,46 +795,65 @@ void ts3plugin_onConnectStatusChangeEvent(uint64 serverConnectionHandlerID, int
 }
 
 void ts3plugin_onNewChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 channelParentID) {
+    Telnet_interface::get_instance()->handle_channel_changed(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onNewChannelCreatedEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 channelParentID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+    Telnet_interface::get_instance()->handle_channel_changed(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onDelChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+    Telnet_interface::get_instance()->handle_channel_deleted(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onChannelMoveEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 newChannelParentID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+    Telnet_interface::get_instance()->handle_channel_changed(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onUpdateChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID) {
+    Telnet_interface::get_instance()->handle_channel_changed(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onUpdateChannelEditedEvent(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+    Telnet_interface::get_instance()->handle_channel_changed(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onUpdateClientEvent(uint64 serverConnectionHandlerID, anyID clientID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+    Telnet_interface::get_instance()->handle_client_changed(serverConnectionHandlerID, clientID);
 }
 
 void ts3plugin_onClientMoveEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* moveMessage) {
+    Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
 }
 
 void ts3plugin_onClientMoveSubscriptionEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility) {
+    Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
 }
 
 void ts3plugin_onClientMoveTimeoutEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* timeoutMessage) {
+    Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
 }
 
 void ts3plugin_onClientMoveMovedEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID moverID, const char* moverName, const char* moverUniqueIdentifier, const char* moveMessage) {
+    Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
 }
 
 void ts3plugin_onClientKickFromChannelEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
+    Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
 }
 
 void ts3plugin_onClientKickFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
-    Telnet_interface::get_instance()->handle_server_disconnected(serverConnectionHandlerID);
+    // The event is raised for every client kicked, only our own kick ends the connection
+    anyID myID;
+    if (ts3Functions.getClientID(serverConnectionHandlerID, &myID) == ERROR_ok && myID == clientID) {
+        Telnet_interface::get_instance()->handle_server_disconnected(serverConnectionHandlerID);
+    } else {
+        Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
+    }
 }
 
 void ts3plugin_onClientIDsEvent(uint64 serverConnectionHandlerID, const char* uniqueClientIdentifier, anyID clientID, const char* clientName) {
+    Telnet_interface::get_instance()->handle_client_identified(serverConnectionHandlerID, clientID, uniqueClientIdentifier);
 }
 
 void ts3plugin_onClientIDsFinishedEvent(uint64 serverConnectionHandlerID) {
@@ -843,7 +868,9 @@ void ts3plugin_onServerUpdatedEvent(uint64 serverConnectionHandlerID) {
 int ts3plugin_onServerErrorEvent(uint64 serverConnectionHandlerID, const char* errorMessage, unsigned int error, const char* returnCode, const char* extraMessage) {
 	printf("PLUGIN: onServerErrorEvent %llu %s %d %s\n", (long long unsigned int)serverConnectionHandlerID, errorMessage, error, (returnCode ? returnCode : ""));
 	if(returnCode) {
-		/* A plugin could now check the returnCode with previously (when calling a function) remembered returnCodes and react accordingly */
+        // Return codes are only passed to the plugin which created them, the
+        // interface matches them against its pending requests
+        Telnet_interface::get_instance()->handle_request_result(serverConnectionHandlerID, returnCode, error, errorMessage);
 		/* In case of using a a plugin return code, the plugin can return:
 		 * 0: Client will continue handling this error (print to chat tab)
 		 * 1: Client will ignore this error, the plugin announces it has handled it */
@@ -866,22 +893,14 @@ int ts3plugin_onTextMessageEvent(uint64 serverConnectionHandlerID, anyID targetM
     if (targetMode == TextMessageTarget_CLIENT) {
         Telnet_interface::get_instance()->handle_private_text_message(serverConnectionHandlerID, fromID, fromName, message);
     } else if (targetMode == TextMessageTarget_CHANNEL) {
-        Telnet_interface::get_instance()->handle_private_text_message(serverConnectionHandlerID, fromID, fromName, message);
+        Telnet_interface::get_instance()->handle_channel_text_message(serverConnectionHandlerID, fromID, fromName, message);
     }
 
     return 0;  /* 0 = handle normally, 1 = client will ignore the text message */
 }
 
 void ts3plugin_onTalkStatusChangeEvent(uint64 serverConnectionHandlerID, int status, int isReceivedWhisper, anyID clientID) {
-	/* Demonstrate usage of getClientDisplayName */
-	char name[512];
-	if(ts3Functions.getClientDisplayName(serverConnectionHandlerID, clientID, name, 512) == ERROR_ok) {
-		if(status == STATUS_TALKING) {
-			printf("--> %s starts talking\n", name);
-		} else {
-			printf("--> %s stops talking\n", name);
-		}
-	}
+    Telnet_interface::get_instance()->handle_talk_status(serverConnectionHandlerID, clientID, status == STATUS_TALKING, isReceivedWhisper != 0);
 }
 
 void ts3plugin_onConnectionInfoEvent(uint64 serverConnectionHandlerID, anyID clientID) {
@@ -891,6 +910,7 @@ void ts3plugin_onServerConnectionInfoEvent(uint64 serverConnectionHandlerID) {
 }
 
 void ts3plugin_onChannelSubscribeEvent(uint64 serverConnectionHandlerID, uint64 channelID) {
+    Telnet_interface::get_instance()->handle_channel_changed(serverConnectionHandlerID, channelID);
 }
 
 void ts3plugin_onChannelSubscribeFinishedEvent(uint64 serverConnectionHandlerID) {
@@ -938,6 +958,7 @@ void ts3plugin_onUserLoggingMessageEvent(const char* logMessage, int logLevel, c
 /* Clientlib rare */
 
 void ts3plugin_onClientBanFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, uint64 time, const char* kickMessage) {
+    Telnet_interface::get_instance()->handle_client_moved(serverConnectionHandlerID, clientID, newChannelID);
 }
 
 int ts3plugin_onClientPokeEvent(uint64 serverConnectionHandlerID, anyID fromClientID, const char* pokerName, const char* pokerUniqueIdentity, const char* message, int ffIgnored) {
@@ -1017,6 +1038,10 @@ void ts3plugin_onClientChannelGroupChangedEvent(uint64 serverConnectionHandlerID
 }
 
 int ts3plugin_onServerPermissionErrorEvent(uint64 serverConnectionHandlerID, const char* errorMessage, unsigned int error, const char* returnCode, unsigned int failedPermissionID) {
+	if(returnCode) {
+        Telnet_interface::get_instance()->handle_request_result(serverConnectionHandlerID, returnCode, error, errorMessage);
+		return 1;
+	}
 	return 0;  /* See onServerErrorEvent for return code description */
 }
 
@@ -1069,6 +1094,7 @@ void ts3plugin_onMessageGetEvent(uint64 serverConnectionHandlerID, uint64 messag
 }
 
 void ts3plugin_onClientDBIDfromUIDEvent(uint64 serverConnectionHandlerID, const char* uniqueClientIdentifier, uint64 clientDatabaseID) {
+    Telnet_interface::get_instance()->handle_database_id(serverConnectionHandlerID, uniqueClientIdentifier, clientDatabaseID);
 }
 
 void ts3plugin_onClientNamefromUIDEvent(uint64 serverConnectionHandlerID, const char* uniqueClientIdentifier, uint64 clientDatabaseID, const char* clientNickName) {